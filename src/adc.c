@@ -27,9 +27,12 @@
 #include "criterr.h"
 #include "hwerr.h"
 #include "pmc.h"
+#include "msgconf.h"
+#include "tc.h"
 #include "adc.h"
 
-#if ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1
+#if ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1 || ADC_HW_TRG_STRM == 1 ||\
+    ADC_CMP_MON == 1
 
 #define WAIT_ADC_EOC (1000 / portTICK_PERIOD_MS)
 
@@ -41,10 +44,50 @@
  #error "SAM_SERIES definition error"
 #endif
 
+#if ADC_HW_TRG_STRM == 1 && (ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1)
+ #error "ADC_HW_TRG_STRM excludes software triggered modes"
+#endif
+#if ADC_CMP_MON == 1 && (ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1 ||\
+                         ADC_HW_TRG_STRM == 1)
+ #error "ADC_CMP_MON excludes other ADC modes"
+#endif
+
+#if ADC_HW_TRG_STRM == 1 && ADC_STRM_TC_TRG == 1
+ #define TRG_TID ADC_STRM_TID
+#elif ADC_CMP_MON == 1 && ADC_CMP_TC_TRG == 1
+ #define TRG_TID ADC_CMP_TID
+#endif
+
+#if defined(TRG_TID) && (TRG_TID < ID_TC0 || TRG_TID > ID_TC2)
+ #error "ADC trigger must be TC channel ID_TC0..ID_TC2"
+#endif
+
 static adc ac;
 #if ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1
 static SemaphoreHandle_t sig;
 #endif
+#if ADC_HW_TRG_STRM == 1
+static QueueHandle_t strm_que;
+static int strm_cur, strm_nxt, strm_held;
+static boolean_t strm_run;
+static struct adc_strm_stats strm_stats;
+
+static int strm_arm_buf(int idx);
+static inline void split_tag(unsigned int s, struct adc_soa *soa);
+#endif
+#if ADC_CMP_MON == 1
+static QueueHandle_t cmp_que;
+static boolean_t cmp_run;
+static boolean_t cmp_alarm;
+static unsigned int cmp_lo, cmp_hi, cmp_hyst;
+static unsigned int cmp_lost;
+static int cmp_ch;
+
+static void cmp_set_win(void);
+#endif
+#ifdef TRG_TID
+static void trg_init(adc dev);
+#endif
 
 /**
  * init_adc
@@ -116,6 +159,65 @@ void init_adc(adc dev)
 #if ADC_SW_TRG_1CH_N == 1
 	ADC->ADC_EMR |= ADC_EMR_TAG;
 #endif
+#if ADC_HW_TRG_STRM == 1
+	if (!dev->chnls_bmp || (dev->chnls_bmp >> ADC_SOA_CHN) || dev->buf[0] == NULL || dev->buf[1] == NULL ||
+	    dev->buf_size < 1 || dev->buf_size > 0xFFFF ||
+	    (!(dev->emr & ADC_EMR_TAG) && dev->chnls_bmp & (dev->chnls_bmp - 1))) {
+		// After a PDC starvation the stream restarts at any sequence
+		// position, only tagged samples can be assigned then.
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (strm_que == NULL) {
+		if (NULL == (strm_que = xQueueCreate(2, sizeof(uint16_t *)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	} else {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	strm_cur = strm_nxt = strm_held = -1;
+	ADC->ADC_PTCR = ADC_PTCR_RXTDIS | ADC_PTCR_TXTDIS;
+#if ADC_STRM_TC_TRG == 1
+	trg_init(dev);
+#else
+	ADC->ADC_MR = (dev->mr & ~(ADC_MR_TRGSEL_Msk | ADC_MR_FREERUN)) | ADC_MR_TRGEN | ADC_MR_TRGSEL_ADC_TRIG0;
+#endif
+	ADC->ADC_CHER = dev->chnls_bmp;
+	NVIC_ClearPendingIRQ(ID_ADC);
+	NVIC_SetPriority(ID_ADC, configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(ID_ADC);
+#endif
+#if ADC_CMP_MON == 1
+	if (!dev->chnls_bmp || dev->cmp_chn < -1 || dev->cmp_chn >= ADC_CHNL_NUM) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	// One window state is kept, so exactly one channel may be compared;
+	// -1 (CMPALL) is accepted only with a single enabled channel.
+	if (dev->cmp_chn == -1) {
+		if (dev->chnls_bmp & (dev->chnls_bmp - 1)) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		cmp_ch = 31 - __CLZ(dev->chnls_bmp);
+	} else {
+		cmp_ch = dev->cmp_chn;
+	}
+	if (!(dev->chnls_bmp & (1 << cmp_ch))) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (cmp_que == NULL) {
+		if (NULL == (cmp_que = xQueueCreate(ADC_CMP_QUE_SIZE, sizeof(struct adc_cmp_evt)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	} else {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	ADC->ADC_EMR = dev->emr;
+#if ADC_CMP_TC_TRG == 1
+	trg_init(dev);
+#endif
+	NVIC_ClearPendingIRQ(ID_ADC);
+	NVIC_SetPriority(ID_ADC, configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(ID_ADC);
+#endif
 }
 
 /**
@@ -267,7 +369,380 @@ void ADC_Handler(void)
 }
 #endif
 
-#if SAM4N_SERIES && (ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1)
+#if ADC_HW_TRG_STRM == 1
+/**
+ * adc_strm_start
+ */
+void adc_strm_start(void)
+{
+	if (strm_run) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	xQueueReset(strm_que);
+	taskENTER_CRITICAL();
+	ADC->ADC_RPR = (unsigned int) ac->buf[0];
+	ADC->ADC_RCR = ac->buf_size;
+	ADC->ADC_RNPR = (unsigned int) ac->buf[1];
+	ADC->ADC_RNCR = ac->buf_size;
+	strm_cur = 0;
+	strm_nxt = 1;
+	strm_held = -1;
+	ADC->ADC_LCDR;
+	ADC->ADC_ISR;
+	ADC->ADC_IER = ADC_IER_ENDRX;
+	ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+#if ADC_STRM_TC_TRG == 1
+	TC0->TC_CHANNEL[tc_chnl(TRG_TID)].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+#endif
+	strm_run = TRUE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * adc_strm_stop
+ */
+void adc_strm_stop(void)
+{
+	taskENTER_CRITICAL();
+#if ADC_STRM_TC_TRG == 1
+	TC0->TC_CHANNEL[tc_chnl(TRG_TID)].TC_CCR = TC_CCR_CLKDIS;
+#endif
+	ADC->ADC_IDR = ~0;
+	ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+	strm_cur = strm_nxt = strm_held = -1;
+	strm_run = FALSE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * adc_strm_read
+ */
+int adc_strm_read(uint16_t **buf, TickType_t tmo)
+{
+	int idx;
+
+	if (strm_held != -1) {
+		taskENTER_CRITICAL();
+		idx = (strm_run) ? strm_arm_buf(strm_held) : -1;
+		strm_held = idx;
+		if (idx != -1) {
+			// Current buffer completed while the released one was armed.
+			strm_stats.blk++;
+		}
+		taskEXIT_CRITICAL();
+		if (idx != -1) {
+			*buf = ac->buf[idx];
+			return (0);
+		}
+	}
+	if (pdFALSE == xQueueReceive(strm_que, buf, tmo)) {
+		return (-ETMO);
+	}
+	strm_held = (*buf == ac->buf[0]) ? 0 : 1;
+	return (0);
+}
+
+/**
+ * adc_strm_split
+ */
+void adc_strm_split(const uint16_t *buf, int cnt, struct adc_soa *soa)
+{
+	const uint32_t *p;
+	uint32_t w;
+	uint16_t *d;
+	int i, k, s;
+
+	if (ac->emr & ADC_EMR_TAG) {
+		if ((unsigned int) buf & 2 && cnt) {
+			split_tag(*buf++, soa);
+			cnt--;
+		}
+		// Two tagged samples per word load.
+		p = (const uint32_t *) buf;
+		for (i = 0; i < cnt / 2; i++) {
+			w = *p++;
+			split_tag(w & 0xFFFF, soa);
+			split_tag(w >> 16, soa);
+		}
+		if (cnt & 1) {
+			split_tag(*(const uint16_t *) p, soa);
+		}
+		return;
+	}
+	// Untagged stream has exactly one channel (see init_adc()).
+	k = 31 - __CLZ(ac->chnls_bmp);
+	if (soa->chn[k] == NULL) {
+		soa->drop += cnt;
+		return;
+	}
+	s = (cnt < soa->size - soa->cnt[k]) ? cnt : soa->size - soa->cnt[k];
+	soa->drop += cnt - s;
+	d = soa->chn[k] + soa->cnt[k];
+	soa->cnt[k] += s;
+	while (s--) {
+		*d++ = *buf++ & ADC_LCDR_LDATA_Msk;
+	}
+}
+
+/**
+ * split_tag
+ */
+static inline void split_tag(unsigned int s, struct adc_soa *soa)
+{
+	int k = s >> ADC_LCDR_CHNB_Pos;
+
+	if (soa->chn[k] != NULL && soa->cnt[k] < soa->size) {
+		soa->chn[k][soa->cnt[k]++] = s & ADC_LCDR_LDATA_Msk;
+	} else {
+		soa->drop++;
+	}
+}
+
+#if ADC_STRM_TC_TRG == 1
+/**
+ * adc_strm_set_rate
+ */
+unsigned int adc_strm_set_rate(unsigned int hz)
+{
+	return (tc_set_wave_rate(TRG_TID, hz, strm_run));
+}
+#endif
+
+/**
+ * get_adc_strm_stats
+ */
+void get_adc_strm_stats(struct adc_strm_stats *st)
+{
+	taskENTER_CRITICAL();
+	*st = strm_stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * strm_arm_buf
+ *
+ * Hand buffer idx back to the PDC (caller masks the ADC interrupt). Returns
+ * index of the buffer completed meanwhile by the PDC, or -1.
+ */
+static int strm_arm_buf(int idx)
+{
+	int done;
+
+	if (strm_cur == -1) {
+		ADC->ADC_RPR = (unsigned int) ac->buf[idx];
+		ADC->ADC_RCR = ac->buf_size;
+		strm_cur = idx;
+		ADC->ADC_IER = ADC_IER_RXBUFF;
+		ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+		return (-1);
+	}
+	ADC->ADC_RNPR = (unsigned int) ac->buf[idx];
+	ADC->ADC_RNCR = ac->buf_size;
+	if (ADC->ADC_RNCR == 0) {
+		// Current buffer completed and next one was loaded immediately.
+		done = strm_cur;
+		strm_cur = idx;
+		return (done);
+	}
+	strm_nxt = idx;
+	ADC->ADC_IDR = ADC_IDR_RXBUFF;
+	ADC->ADC_IER = ADC_IER_ENDRX;
+	return (-1);
+}
+
+/**
+ * ADC_Handler
+ */
+void ADC_Handler(void)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	unsigned int isr;
+	int idx;
+
+	isr = ADC->ADC_ISR;
+	strm_stats.intr++;
+	if (isr & ADC_ISR_GOVRE) {
+		strm_stats.ovre++;
+	}
+	isr &= ADC->ADC_IMR;
+	if (isr & (ADC_ISR_ENDRX | ADC_ISR_RXBUFF)) {
+		idx = strm_cur;
+		if (isr & ADC_ISR_ENDRX) {
+			// PDC continues with the next buffer.
+			strm_cur = strm_nxt;
+			strm_nxt = -1;
+			ADC->ADC_IDR = ADC_IDR_ENDRX;
+			ADC->ADC_IER = ADC_IER_RXBUFF;
+		} else {
+			strm_cur = -1;
+			strm_stats.starv++;
+			ADC->ADC_IDR = ADC_IDR_RXBUFF;
+			ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+		}
+		while (idx != -1) {
+			if (errQUEUE_FULL != xQueueSendFromISR(strm_que, &ac->buf[idx], &tsk_wkn)) {
+				strm_stats.blk++;
+				break;
+			}
+			strm_stats.que_full++;
+			idx = strm_arm_buf(idx);
+		}
+	}
+	portEND_SWITCHING_ISR(tsk_wkn);
+}
+
+#if TERMOUT == 1
+/**
+ * log_adc_strm_stats
+ */
+void log_adc_strm_stats(void)
+{
+	struct adc_strm_stats st;
+	UBaseType_t pr;
+
+	get_adc_strm_stats(&st);
+	pr = uxTaskPriorityGet(NULL);
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	msg(INF, "adc.c: blk=%u ovre=%u starv=%u que_full=%u intr=%u\n", st.blk, st.ovre, st.starv,
+	    st.que_full, st.intr);
+	vTaskPrioritySet(NULL, pr);
+}
+#endif
+#endif
+
+#if ADC_CMP_MON == 1
+/**
+ * adc_cmp_start
+ */
+void adc_cmp_start(unsigned int lo, unsigned int hi, unsigned int hyst)
+{
+	if (cmp_run) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (lo > hi || hi > ADC_LCDR_LDATA_Msk || 2 * hyst > hi - lo) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	xQueueReset(cmp_que);
+	taskENTER_CRITICAL();
+	cmp_lo = lo;
+	cmp_hi = hi;
+	cmp_hyst = hyst;
+	cmp_alarm = FALSE;
+	cmp_lost = 0;
+	cmp_set_win();
+	ADC->ADC_CHER = ac->chnls_bmp;
+#ifdef TRG_TID
+	TC0->TC_CHANNEL[tc_chnl(TRG_TID)].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+#else
+	ADC->ADC_CR = ADC_CR_START;
+#endif
+	cmp_run = TRUE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * adc_cmp_stop
+ */
+void adc_cmp_stop(void)
+{
+	taskENTER_CRITICAL();
+#ifdef TRG_TID
+	TC0->TC_CHANNEL[tc_chnl(TRG_TID)].TC_CCR = TC_CCR_CLKDIS;
+#endif
+	ADC->ADC_IDR = ~0;
+	ADC->ADC_CHDR = ac->chnls_bmp;
+	cmp_run = FALSE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * adc_cmp_wait
+ */
+int adc_cmp_wait(struct adc_cmp_evt *evt, TickType_t tmo)
+{
+	if (pdFALSE == xQueueReceive(cmp_que, evt, tmo)) {
+		return (-ETMO);
+	}
+	return (0);
+}
+
+#if ADC_CMP_TC_TRG == 1
+/**
+ * adc_cmp_set_rate
+ */
+unsigned int adc_cmp_set_rate(unsigned int hz)
+{
+	return (tc_set_wave_rate(TRG_TID, hz, cmp_run));
+}
+#endif
+
+/**
+ * cmp_set_win
+ *
+ * Normal state waits for a value out of [lo, hi], alarm state for a value
+ * back in [lo + hyst, hi - hyst]. Stale COMPE of the previous setting is
+ * cleared by reading ADC_ISR.
+ */
+static void cmp_set_win(void)
+{
+	unsigned int emr;
+
+	emr = ADC->ADC_EMR & ~(ADC_EMR_CMPMODE_Msk | ADC_EMR_CMPSEL_Msk | ADC_EMR_CMPALL);
+	emr |= ADC_EMR_CMPSEL(cmp_ch);
+	if (cmp_alarm) {
+		ADC->ADC_CWR = ADC_CWR_LOWTHRES(cmp_lo + cmp_hyst) | ADC_CWR_HIGHTHRES(cmp_hi - cmp_hyst);
+		ADC->ADC_EMR = emr | ADC_EMR_CMPMODE_IN;
+	} else {
+		ADC->ADC_CWR = ADC_CWR_LOWTHRES(cmp_lo) | ADC_CWR_HIGHTHRES(cmp_hi);
+		ADC->ADC_EMR = emr | ADC_EMR_CMPMODE_OUT;
+	}
+	ADC->ADC_ISR;
+	ADC->ADC_IER = ADC_IER_COMPE;
+}
+
+/**
+ * ADC_Handler
+ */
+void ADC_Handler(void)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	struct adc_cmp_evt evt;
+
+	if (ADC->ADC_ISR & ADC_ISR_COMPE) {
+		evt.chn = cmp_ch;
+		evt.val = ADC->ADC_CDR[cmp_ch] & ADC_CDR_DATA_Msk;
+		cmp_alarm = !cmp_alarm;
+		evt.alarm = cmp_alarm;
+		evt.lost = cmp_lost;
+		if (errQUEUE_FULL == xQueueSendFromISR(cmp_que, &evt, &tsk_wkn)) {
+			cmp_lost++;
+		} else {
+			cmp_lost = 0;
+		}
+		cmp_set_win();
+	}
+	portEND_SWITCHING_ISR(tsk_wkn);
+}
+#endif
+
+#ifdef TRG_TID
+/**
+ * trg_init
+ */
+static void trg_init(adc dev)
+{
+	// Only TIOA0..TIOA2 of the first TC block can trigger the ADC.
+	ADC->ADC_MR = (dev->mr & ~(ADC_MR_TRGSEL_Msk | ADC_MR_FREERUN)) | ADC_MR_TRGEN |
+		      (tc_chnl(TRG_TID) + 1) << ADC_MR_TRGSEL_Pos;
+	enable_periph_clk(TRG_TID);
+	TC0->TC_CHANNEL[tc_chnl(TRG_TID)].TC_CCR = TC_CCR_CLKDIS;
+	TC0->TC_CHANNEL[tc_chnl(TRG_TID)].TC_IDR = ~0;
+	tc_set_wave_rate(TRG_TID, dev->rate, FALSE);
+}
+#endif
+
+#if SAM4N_SERIES && (ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1 || ADC_HW_TRG_STRM == 1 ||\
+    ADC_CMP_MON == 1)
 /**
  * read_adc_chtemp
  */
@@ -28,8 +28,28 @@
 #ifndef ADC_SW_TRG_XCH
  #define ADC_SW_TRG_XCH 0
 #endif
+#ifndef ADC_HW_TRG_STRM
+ #define ADC_HW_TRG_STRM 0
+#endif
+// ADC_HW_TRG_STRM trigger: 1 -> TIOA of TC channel ADC_STRM_TID (ID_TC0..ID_TC2),
+// 0 -> ADTRG pin (TRGSEL from adc_dev.mr).
+#ifndef ADC_STRM_TC_TRG
+ #define ADC_STRM_TC_TRG 1
+#endif
+#ifndef ADC_CMP_MON
+ #define ADC_CMP_MON 0
+#endif
+// ADC_CMP_MON trigger: 1 -> TIOA of TC channel ADC_CMP_TID (ID_TC0..ID_TC2),
+// 0 -> as set in adc_dev.mr (ADC_MR_FREERUN or ADTRG pin).
+#ifndef ADC_CMP_TC_TRG
+ #define ADC_CMP_TC_TRG 0
+#endif
+#ifndef ADC_CMP_QUE_SIZE
+ #define ADC_CMP_QUE_SIZE 4
+#endif
 
-#if ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1
+#if ADC_SW_TRG_1CH == 1 || ADC_SW_TRG_1CH_N == 1 || ADC_SW_TRG_XCH == 1 || ADC_HW_TRG_STRM == 1 ||\
+    ADC_CMP_MON == 1
 
 enum adc_chn {
 	ADC_CH0,
@@ -93,6 +113,36 @@ struct adc_chtemp_cfg {
 };
 #endif
 
+#if ADC_HW_TRG_STRM == 1
+struct adc_strm_stats {
+	unsigned int blk; // Full buffers delivered.
+	unsigned int ovre; // Buffers with ADC overrun (GOVRE).
+	unsigned int starv; // PDC ran out of buffers (reader too slow).
+	unsigned int que_full; // Buffers dropped because the queue was full.
+	unsigned int intr; // Interrupts.
+};
+
+// Structure-of-arrays destination of adc_strm_split() (index = channel or
+// sequence slot, see adc_strm_split()).
+#define ADC_SOA_CHN 16
+
+struct adc_soa {
+	uint16_t *chn[ADC_SOA_CHN]; // <SetIt> Per-channel sample buffer, or NULL.
+	int size; // <SetIt> Capacity of each buffer in samples.
+	int cnt[ADC_SOA_CHN]; // Samples stored (caller clears before refill).
+	unsigned int drop; // Samples of channels without buffer or with full buffer.
+};
+#endif
+
+#if ADC_CMP_MON == 1
+struct adc_cmp_evt {
+	int chn; // Channel (sequence slot with ADC_MR_USEQ).
+	int val; // Conversion result which caused the event.
+	boolean_t alarm; // TRUE -> left the window, FALSE -> returned into it.
+	unsigned int lost; // Events lost before this one (queue full).
+};
+#endif
+
 typedef struct adc_dev *adc;
 
 struct adc_dev {
@@ -114,9 +164,19 @@ struct adc_dev {
 #if ADC_SW_TRG_1CH == 1
 	int chn; // <SetIt>
 #endif
-#if ADC_SW_TRG_XCH == 1
+#if ADC_SW_TRG_XCH == 1 || ADC_HW_TRG_STRM == 1 || ADC_CMP_MON == 1
 	unsigned int chnls_bmp; // <SetIt>
 #endif
+#if ADC_HW_TRG_STRM == 1
+	uint16_t *buf[2]; // <SetIt> Two sample buffers.
+	int buf_size; // <SetIt> Samples per buffer (1..65535).
+#endif
+#if (ADC_HW_TRG_STRM == 1 && ADC_STRM_TC_TRG == 1) || (ADC_CMP_MON == 1 && ADC_CMP_TC_TRG == 1)
+	unsigned int rate; // <SetIt> Trigger rate in Hz.
+#endif
+#if ADC_CMP_MON == 1
+	int cmp_chn; // <SetIt> Compared channel (in chnls_bmp), -1 -> the only enabled channel.
+#endif
 #if ADC_SW_TRG_1CH_N == 1
 	SemaphoreHandle_t mtx; // <SetIt>
 #endif
@@ -185,6 +245,136 @@ int start_adc_conv(void);
 int read_adc_chnl(enum adc_chn chn);
 #endif
 
+#if ADC_HW_TRG_STRM == 1
+/**
+ * adc_strm_start
+ *
+ * Start continuous conversion. Every trigger converts all enabled channels
+ * (chnls_bmp, in ascending order or in ADC_SEQR order with ADC_MR_USEQ) and
+ * the PDC stores the results into the two buffers alternately. Pending
+ * buffers from a previous run are discarded.
+ */
+void adc_strm_start(void);
+
+/**
+ * adc_strm_stop
+ *
+ * Stop trigger and conversion storing.
+ */
+void adc_strm_stop(void);
+
+/**
+ * adc_strm_read
+ *
+ * Wait for the next full buffer. The buffer returned by the previous call is
+ * handed back to the PDC first, so it must be processed before the other one
+ * is filled, otherwise samples are lost (counted as starv in stats).
+ *
+ * @buf: Full buffer of buf_size samples (return).
+ * @tmo: Timeout in OS ticks (portMAX_DELAY waits forever).
+ *
+ * Returns: 0 - success; -ETMO - no buffer within tmo.
+ */
+int adc_strm_read(uint16_t **buf, TickType_t tmo);
+
+/**
+ * adc_strm_split
+ *
+ * De-interleave a stream buffer into per-channel buffers (conversion results
+ * without tag bits). With ADC_EMR_TAG in adc_dev.emr every sample carries its
+ * channel number, so lost samples cannot misplace others; with ADC_MR_USEQ
+ * the tag is the sequence slot (CHx bit of chnls_bmp), not the physical
+ * channel. Without tag all samples belong to the only enabled channel;
+ * init_adc() requires ADC_EMR_TAG for more channels, because after a PDC
+ * starvation the stream resumes at any position of the sequence.
+ *
+ * @buf: Stream buffer.
+ * @cnt: Number of samples in buf.
+ * @soa: Destination.
+ */
+void adc_strm_split(const uint16_t *buf, int cnt, struct adc_soa *soa);
+
+#if ADC_STRM_TC_TRG == 1
+/**
+ * adc_strm_set_rate
+ *
+ * Set trigger rate. May be called while streaming; the trigger period
+ * restarts.
+ *
+ * @hz: Trigger rate in Hz.
+ *
+ * Returns: Rate set (quantized by the TC clock).
+ */
+unsigned int adc_strm_set_rate(unsigned int hz);
+#endif
+
+/**
+ * get_adc_strm_stats
+ *
+ * @st: Stream counters (return).
+ */
+void get_adc_strm_stats(struct adc_strm_stats *st);
+
+#if TERMOUT == 1
+/**
+ * log_adc_strm_stats
+ */
+void log_adc_strm_stats(void);
+#endif
+#endif
+
+#if ADC_CMP_MON == 1
+/**
+ * adc_cmp_start
+ *
+ * Start conversions of enabled channels (chnls_bmp), the channel cmp_chn
+ * compared by the ADC against the window [lo, hi]. The CPU is involved only when a compared
+ * value leaves the window (alarm) and when it returns into the window
+ * narrowed by hyst on both sides ([lo + hyst, hi - hyst]); the driver
+ * reprograms ADC_CWR and ADC_EMR.CMPMODE between both states. Other
+ * ADC_EMR bits (e.g. CMPFILTER on SAM4N) are taken from adc_dev.emr.
+ *
+ * @lo: Low threshold.
+ * @hi: High threshold.
+ * @hyst: Hysteresis (2 * hyst <= hi - lo).
+ */
+void adc_cmp_start(unsigned int lo, unsigned int hi, unsigned int hyst);
+
+/**
+ * adc_cmp_stop
+ *
+ * Stop conversions.
+ */
+void adc_cmp_stop(void);
+
+/**
+ * adc_cmp_wait
+ *
+ * Wait for a window event. The reported value is the last conversion of the
+ * compared channel at interrupt time (ADC_CDR), which may follow the compared
+ * one by a few conversions at high rates.
+ *
+ * @evt: Event (return).
+ * @tmo: Timeout in OS ticks (portMAX_DELAY waits forever).
+ *
+ * Returns: 0 - success; -ETMO - no event within tmo.
+ */
+int adc_cmp_wait(struct adc_cmp_evt *evt, TickType_t tmo);
+
+#if ADC_CMP_TC_TRG == 1
+/**
+ * adc_cmp_set_rate
+ *
+ * Set trigger rate. May be called while monitoring.
+ *
+ * @hz: Trigger rate in Hz.
+ *
+ * Returns: Rate set (quantized by the TC clock).
+ */
+unsigned int adc_cmp_set_rate(unsigned int hz);
+#endif
+#endif
+
 #if SAM4N_SERIES
 /**
  * read_adc_chtemp
@@ -0,0 +1,289 @@
+/*
+ * adc_cal.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "hwerr.h"
+#include "msgconf.h"
+#include "adc.h"
+#include "adc_cal.h"
+
+#if ADC_CAL == 1
+
+#if SAM4S_SERIES || SAM4N_SERIES
+ #define CAL_SIMD 1
+#else
+ #define CAL_SIMD 0
+#endif
+
+#define CODE_MAX 4095
+#define CHTEMP_CHN 16
+#define BENCH_CNT 256
+
+struct cal {
+	int32_t gain;
+	int32_t offs;
+	int16_t m;
+	int sh;
+	int32_t o;
+};
+
+static struct cal cal[ADC_CAL_CHN];
+
+/**
+ * adc_cal_set
+ */
+int adc_cal_set(int chn, int32_t gain, int32_t offs)
+{
+	int64_t y0, y1, m, o;
+	int sh;
+
+	if (chn < 0 || chn >= ADC_CAL_CHN) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	y0 = offs;
+	y1 = (int64_t) gain * CODE_MAX + offs;
+	if (y1 > INT32_MAX || y1 < INT32_MIN) {
+		return (-EDATA);
+	}
+	// int16 kernel: y = (code * m + o) >> sh with |m| <= 32767 and no
+	// int32 overflow; largest shift gives the best precision.
+	for (sh = 31; sh > 0; sh--) {
+		m = (gain * ((int64_t) 1 << sh)) >> 16;
+		o = ((offs * ((int64_t) 1 << sh)) >> 16) + ((int64_t) 1 << (sh - 1));
+		if (m <= INT16_MAX && m >= -INT16_MAX && o + m * CODE_MAX <= INT32_MAX &&
+		    o + m * CODE_MAX >= INT32_MIN && o <= INT32_MAX && o >= INT32_MIN) {
+			break;
+		}
+	}
+	if (sh == 0) {
+		// Units per code >= 32768: int16 output saturates anyway.
+		m = (gain >= 0) ? INT16_MAX : -INT16_MAX;
+		o = (y0 >> 16 > INT32_MAX / 2) ? INT32_MAX / 2 : (y0 >> 16 < INT32_MIN / 2) ? INT32_MIN / 2 : y0 >> 16;
+	}
+	taskENTER_CRITICAL();
+	cal[chn].gain = gain;
+	cal[chn].offs = offs;
+	cal[chn].m = m;
+	cal[chn].sh = sh;
+	cal[chn].o = o;
+	taskEXIT_CRITICAL();
+	return (0);
+}
+
+/**
+ * adc_cal_get
+ */
+void adc_cal_get(int chn, int32_t *gain, int32_t *offs)
+{
+	if (chn < 0 || chn >= ADC_CAL_CHN) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	taskENTER_CRITICAL();
+	*gain = cal[chn].gain;
+	*offs = cal[chn].offs;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * adc_cal_ideal
+ */
+int adc_cal_ideal(int chn, int fs)
+{
+	// fs / 4096 in Q16.16.
+	return (adc_cal_set(chn, (int32_t) fs << 4, 0));
+}
+
+/**
+ * adc_cal_two_point
+ */
+int adc_cal_two_point(int chn, unsigned int code1, int val1, unsigned int code2, int val2)
+{
+	int64_t gain, offs;
+
+	if (code1 == code2 || code1 > CODE_MAX || code2 > CODE_MAX) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	gain = (((int64_t) val2 - val1) << 16) / ((int) code2 - (int) code1);
+	offs = ((int64_t) val1 << 16) - gain * code1;
+	if (gain > INT32_MAX || gain < INT32_MIN || offs > INT32_MAX || offs < INT32_MIN) {
+		return (-EDATA);
+	}
+	return (adc_cal_set(chn, gain, offs));
+}
+
+/**
+ * adc_cal_run32
+ */
+void adc_cal_run32(int chn, const uint16_t *in, int cnt, int32_t *out)
+{
+	int32_t g = cal[chn].gain, o = cal[chn].offs;
+
+	for (; cnt >= 4; cnt -= 4, in += 4, out += 4) {
+		out[0] = in[0] * g + o;
+		out[1] = in[1] * g + o;
+		out[2] = in[2] * g + o;
+		out[3] = in[3] * g + o;
+	}
+	while (cnt--) {
+		*out++ = *in++ * g + o;
+	}
+}
+
+/**
+ * adc_cal_run16
+ */
+void adc_cal_run16(int chn, const uint16_t *in, int cnt, int16_t *out)
+{
+	int32_t m = cal[chn].m, o = cal[chn].o;
+	int sh = cal[chn].sh;
+
+#if CAL_SIMD == 1
+	const uint32_t *src;
+	uint32_t *dst, w, ml = m & 0xFFFF, mh = (uint32_t) m << 16;
+	int32_t lo, hi;
+
+	if (!(((unsigned int) in | (unsigned int) out) & 3)) {
+		// Codes are below 32768, so both halfword lanes are positive.
+		src = (const uint32_t *) in;
+		dst = (uint32_t *) out;
+		for (; cnt >= 2; cnt -= 2) {
+			w = *src++;
+			lo = __SSAT((int32_t) __SMLAD(w, ml, o) >> sh, 16);
+			hi = __SSAT((int32_t) __SMLAD(w, mh, o) >> sh, 16);
+			*dst++ = __PKHBT(lo, hi, 16);
+		}
+		in = (const uint16_t *) src;
+		out = (int16_t *) dst;
+	}
+#endif
+	while (cnt--) {
+		*out++ = __SSAT((*in++ * m + o) >> sh, 16);
+	}
+}
+
+#if SAM4N_SERIES
+/**
+ * adc_cal_chtemp_init
+ */
+void adc_cal_chtemp_init(unsigned int vref_mv)
+{
+	int64_t gain, offs;
+
+	// ddeg = (mV - TS_MV) * 10000 / TS_UV_C + 270, mV = code * vref / 4096.
+	gain = ((int64_t) vref_mv * 10000 << 16) / ((int64_t) 4096 * ADC_CAL_TS_UV_C);
+	offs = ((int64_t) 270 << 16) - ((int64_t) ADC_CAL_TS_MV * 10000 << 16) / ADC_CAL_TS_UV_C;
+	if (adc_cal_set(CHTEMP_CHN, gain, offs)) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+}
+
+/**
+ * adc_cal_chtemp_trim
+ */
+void adc_cal_chtemp_trim(unsigned int code, int ddeg)
+{
+	int32_t gain, offs;
+
+	adc_cal_get(CHTEMP_CHN, &gain, &offs);
+	if (adc_cal_set(CHTEMP_CHN, gain, ((int32_t) ddeg << 16) - gain * (int32_t) code)) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+}
+
+/**
+ * adc_cal_chtemp
+ */
+int adc_cal_chtemp(unsigned int code)
+{
+	uint16_t x = code;
+	int32_t y;
+
+	adc_cal_run32(CHTEMP_CHN, &x, 1, &y);
+	return ((y + 0x8000) >> 16);
+}
+#endif
+
+#if TERMOUT == 1
+/**
+ * log_adc_cal_bench
+ */
+void log_adc_cal_bench(void)
+{
+	static const int32_t set[][2] = {
+		{(3300 << 16) / 4096, 0},
+		{0x12000, -(100 << 16)},
+		{-(5 << 16), 20000 << 16},
+		{7 << 16, -(1000 << 16)},
+		{3, 0x8000}
+	};
+	static uint32_t in[BENCH_CNT / 2];
+	static uint32_t out16[BENCH_CNT / 2];
+	static int32_t out32[BENCH_CNT];
+	int32_t gain, offs, ref;
+	uint32_t cyc[2], t;
+	int err, err_max;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	adc_cal_get(0, &gain, &offs);
+	for (unsigned int s = 0; s < sizeof(set) / sizeof(set[0]); s++) {
+		if (adc_cal_set(0, set[s][0], set[s][1])) {
+			crit_err_exit(UNEXP_PROG_STATE);
+		}
+		err_max = 0;
+		cyc[0] = cyc[1] = 0;
+		for (int c = 0; c <= CODE_MAX; c += BENCH_CNT) {
+			for (int i = 0; i < BENCH_CNT; i++) {
+				((uint16_t *) in)[i] = c + i;
+			}
+			taskENTER_CRITICAL();
+			t = DWT->CYCCNT;
+			adc_cal_run32(0, (uint16_t *) in, BENCH_CNT, out32);
+			cyc[0] += DWT->CYCCNT - t;
+			t = DWT->CYCCNT;
+			adc_cal_run16(0, (uint16_t *) in, BENCH_CNT, (int16_t *) out16);
+			cyc[1] += DWT->CYCCNT - t;
+			taskEXIT_CRITICAL();
+			// Reference: run32 rounded to nearest and saturated.
+			for (int i = 0; i < BENCH_CNT; i++) {
+				ref = __SSAT((out32[i] + 0x8000) >> 16, 16);
+				err = ((int16_t *) out16)[i] - ref;
+				if (err < 0) {
+					err = -err;
+				}
+				if (err > err_max) {
+					err_max = err;
+				}
+			}
+		}
+		// Cycles per sample in 1/100.
+		msg(INF, "adc_cal.c: simd=%d gain=%d offs=%d err_max=%d cyc/smp*100: run32=%u run16=%u\n", CAL_SIMD,
+		    set[s][0], set[s][1], err_max, cyc[0] * 100 / (CODE_MAX + 1), cyc[1] * 100 / (CODE_MAX + 1));
+	}
+	adc_cal_set(0, gain, offs);
+}
+#endif
+
+#endif
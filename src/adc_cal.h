@@ -0,0 +1,171 @@
+/*
+ * adc_cal.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file adc_cal.h
+ *
+ * @brief Per-channel fixed-point calibration of ADC sample buffers.
+ *
+ * Every channel has a linear transfer function to caller-defined engineering
+ * units (e.g. mV, mA, 0.1 degC): units = gain * code + offs, with gain and
+ * offs stored in Q16.16. Conversion runs over whole buffers of 12-bit codes
+ * (untagged, e.g. from adc_strm_split()) without floating point:
+ * - adc_cal_run32(): Q16.16 output, full precision (one MLA per sample),
+ * - adc_cal_run16(): rounded int16 units, saturated. The gain is kept as a
+ *   normalized Q15 mantissa with a channel shift; on Cortex-M4 parts two
+ *   samples are converted per word load with SMLAD, SAM3 parts use portable
+ *   code with identical results.
+ *
+ * Calibration sources: adc_cal_ideal() for a converter calibrated by
+ * calibrate_adc() (nominal transfer function from the full scale value),
+ * adc_cal_two_point() from two reference inputs, adc_cal_set() with values
+ * restored from non-volatile memory (adc_cal_get()).
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when ADC_CAL == 1.
+ * - SAM4N: ADC_CAL_TS_MV (sensor voltage at 27 degC) and ADC_CAL_TS_UV_C
+ *   (sensor slope) set the nominal ADC_CHTEMP conversion; defaults are
+ *   typical values, so trim the sensor by adc_cal_chtemp_trim() at a known
+ *   temperature for accuracy.
+ */
+
+#ifndef ADC_CAL_H
+#define ADC_CAL_H
+
+#ifndef ADC_CAL
+ #define ADC_CAL 0
+#endif
+
+#ifndef ADC_CAL_TS_MV
+ #define ADC_CAL_TS_MV 1440
+#endif
+
+#ifndef ADC_CAL_TS_UV_C
+ #define ADC_CAL_TS_UV_C 4700
+#endif
+
+#if ADC_CAL == 1
+
+#define ADC_CAL_CHN 17
+
+/**
+ * @brief Set channel calibration.
+ *
+ * @param chn  Channel (0..ADC_CAL_CHN - 1).
+ * @param gain Units per code, Q16.16.
+ * @param offs Units at code 0, Q16.16.
+ *
+ * @return 0 - success; -EDATA if units of code 0..4095 do not fit Q16.16.
+ */
+int adc_cal_set(int chn, int32_t gain, int32_t offs);
+
+/**
+ * @brief Get channel calibration (e.g. to store it).
+ *
+ * @param chn  Channel (0..ADC_CAL_CHN - 1).
+ * @param gain Units per code, Q16.16 (return).
+ * @param offs Units at code 0, Q16.16 (return).
+ */
+void adc_cal_get(int chn, int32_t *gain, int32_t *offs);
+
+/**
+ * @brief Set nominal calibration: code 0 -> 0, code 4096 -> fs units.
+ *
+ * @param chn Channel (0..ADC_CAL_CHN - 1).
+ * @param fs  Full scale in units (e.g. reference voltage in mV).
+ *
+ * @return As adc_cal_set().
+ */
+int adc_cal_ideal(int chn, int fs);
+
+/**
+ * @brief Compute calibration from two reference points.
+ *
+ * @param chn   Channel (0..ADC_CAL_CHN - 1).
+ * @param code1 Code measured at the first reference.
+ * @param val1  First reference in units.
+ * @param code2 Code measured at the second reference (!= code1).
+ * @param val2  Second reference in units.
+ *
+ * @return As adc_cal_set().
+ */
+int adc_cal_two_point(int chn, unsigned int code1, int val1, unsigned int code2, int val2);
+
+/**
+ * @brief Convert a buffer to Q16.16 units.
+ *
+ * @param chn Channel (0..ADC_CAL_CHN - 1).
+ * @param in  Codes (12-bit).
+ * @param cnt Number of samples.
+ * @param out Units in Q16.16.
+ */
+void adc_cal_run32(int chn, const uint16_t *in, int cnt, int32_t *out);
+
+/**
+ * @brief Convert a buffer to rounded int16 units (saturated).
+ *
+ * May run in place (out == (int16_t *) in).
+ *
+ * @param chn Channel (0..ADC_CAL_CHN - 1).
+ * @param in  Codes (12-bit).
+ * @param cnt Number of samples.
+ * @param out Units.
+ */
+void adc_cal_run16(int chn, const uint16_t *in, int cnt, int16_t *out);
+
+#if SAM4N_SERIES
+/**
+ * @brief Set nominal ADC_CHTEMP calibration (units 0.1 degC).
+ *
+ * @param vref_mv ADC reference voltage in mV.
+ */
+void adc_cal_chtemp_init(unsigned int vref_mv);
+
+/**
+ * @brief One-point trim of ADC_CHTEMP offset.
+ *
+ * @param code Code measured at temperature ddeg.
+ * @param ddeg Temperature in 0.1 degC.
+ */
+void adc_cal_chtemp_trim(unsigned int code, int ddeg);
+
+/**
+ * @brief Convert an ADC_CHTEMP code (read_adc_chtemp()) to temperature.
+ *
+ * @param code ADC_CHTEMP conversion result.
+ *
+ * @return Temperature in 0.1 degC.
+ */
+int adc_cal_chtemp(unsigned int code);
+#endif
+
+#if TERMOUT == 1
+/**
+ * @brief Check adc_cal_run16() against adc_cal_run32() (terminal output).
+ *
+ * For several gain/offset sets, converts all 4096 codes on channel 0 with
+ * both functions. Logs the worst difference of run16 from the rounded and
+ * saturated run32 result, and the cycles per sample of each function (DWT
+ * cycle counter). The calibration of channel 0 is restored afterwards.
+ */
+void log_adc_cal_bench(void);
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,324 @@
+/*
+ * adc_fft.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "adc_fft.h"
+
+#if ADC_FFT == 1
+
+#if SAM4S_SERIES || SAM4N_SERIES
+ #define FFT_SIMD 1
+#else
+ #define FFT_SIMD 0
+#endif
+
+#define TAB_N 1024
+#define MID_CODE 2048
+#define LOAD_SHIFT 3
+
+// sin(2 * pi * i / TAB_N) in Q15, i = 0..TAB_N / 4.
+static const int16_t sin_tab[TAB_N / 4 + 1] = {
+	0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809,
+	2009, 2210, 2411, 2611, 2811, 3012, 3212, 3412, 3612, 3812,
+	4011, 4211, 4410, 4609, 4808, 5007, 5205, 5404, 5602, 5800,
+	5998, 6195, 6393, 6590, 6787, 6983, 7180, 7376, 7571, 7767,
+	7962, 8157, 8351, 8546, 8740, 8933, 9127, 9319, 9512, 9704,
+	9896, 10088, 10279, 10469, 10660, 10850, 11039, 11228, 11417, 11605,
+	11793, 11980, 12167, 12354, 12540, 12725, 12910, 13095, 13279, 13463,
+	13646, 13828, 14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269,
+	15447, 15624, 15800, 15976, 16151, 16326, 16500, 16673, 16846, 17018,
+	17190, 17361, 17531, 17700, 17869, 18037, 18205, 18372, 18538, 18703,
+	18868, 19032, 19195, 19358, 19520, 19681, 19841, 20001, 20160, 20318,
+	20475, 20632, 20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+	22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028, 23170, 23312,
+	23453, 23593, 23732, 23870, 24008, 24144, 24279, 24414, 24548, 24680,
+	24812, 24943, 25073, 25202, 25330, 25457, 25583, 25708, 25833, 25956,
+	26078, 26199, 26320, 26439, 26557, 26674, 26791, 26906, 27020, 27133,
+	27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002, 28106, 28209,
+	28311, 28411, 28511, 28610, 28707, 28803, 28899, 28993, 29086, 29178,
+	29269, 29359, 29448, 29535, 29622, 29707, 29792, 29875, 29957, 30038,
+	30118, 30196, 30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784,
+	30853, 30920, 30986, 31050, 31114, 31177, 31238, 31298, 31357, 31415,
+	31471, 31527, 31581, 31634, 31686, 31737, 31786, 31834, 31881, 31927,
+	31972, 32015, 32058, 32099, 32138, 32177, 32214, 32251, 32286, 32319,
+	32352, 32383, 32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+	32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718, 32729, 32738,
+	32746, 32753, 32758, 32762, 32766, 32767, 32767
+};
+
+static int sin_q15(unsigned int i);
+static uint32_t twiddle(unsigned int i);
+static uint32_t isqrt(uint64_t v);
+
+#if FFT_SIMD == 1
+ #define HADD(a, b) __SHADD16(a, b)
+ #define HSUB(a, b) __SHSUB16(a, b)
+ #define HADD_JX(a, b) __SHASX(a, b)
+ #define HSUB_JX(a, b) __SHSAX(a, b)
+#else
+ #define PACK(re, im) (((uint32_t) (re) & 0xFFFF) | (uint32_t) (im) << 16)
+ #define RE(a) ((int16_t) (a))
+ #define IM(a) ((int16_t) ((a) >> 16))
+ #define HADD(a, b) PACK((RE(a) + RE(b)) >> 1, (IM(a) + IM(b)) >> 1)
+ #define HSUB(a, b) PACK((RE(a) - RE(b)) >> 1, (IM(a) - IM(b)) >> 1)
+ #define HADD_JX(a, b) PACK((RE(a) - IM(b)) >> 1, (IM(a) + RE(b)) >> 1)
+ #define HSUB_JX(a, b) PACK((RE(a) + IM(b)) >> 1, (IM(a) - RE(b)) >> 1)
+#endif
+
+/**
+ * adc_goertzel_coef
+ */
+int32_t adc_goertzel_coef(unsigned int f, unsigned int fs)
+{
+	uint32_t ph;
+	int idx, frac, c0, c1;
+
+	if (fs == 0 || f >= fs) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	// Phase 2^32 == 2 * pi, table lookup with linear interpolation.
+	ph = ((uint64_t) f << 32) / fs;
+	idx = ph >> 22;
+	frac = (ph >> 6) & 0xFFFF;
+	c0 = sin_q15(idx + TAB_N / 4);
+	c1 = sin_q15(idx + 1 + TAB_N / 4);
+	// 2 * cos in Q14 equals cos in Q15.
+	return (c0 + (((c1 - c0) * frac) >> 16));
+}
+
+/**
+ * adc_goertzel
+ */
+void adc_goertzel(const uint16_t *in, int cnt, const int32_t *coef, int nf, uint32_t *amp)
+{
+	int32_t s0, s1, s2, c;
+	int64_t p;
+
+	if (cnt < 1 || cnt > 0xFFFF) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (int k = 0; k < nf; k++) {
+		c = coef[k];
+		s1 = s2 = 0;
+		for (int i = 0; i < cnt; i++) {
+			s0 = ((int) in[i] - MID_CODE) + (int32_t) (((int64_t) c * s1) >> 14) - s2;
+			s2 = s1;
+			s1 = s0;
+		}
+		// |X|^2 = s1^2 + s2^2 - coef * s1 * s2, amplitude = 2 * |X| / cnt.
+		p = (int64_t) s1 * s1 + (int64_t) s2 * s2 - (((int64_t) c * s1) >> 14) * s2;
+		amp[k] = (isqrt((p > 0) ? p : 0) * 2 + cnt / 2) / cnt;
+	}
+}
+
+/**
+ * adc_fft_load
+ */
+void adc_fft_load(int16_t *buf, int n)
+{
+	const uint16_t *in = (const uint16_t *) buf;
+	uint32_t *out = (uint32_t *) buf;
+
+	if (n < 1 || n > ADC_FFT_MAX_N || ((unsigned int) buf & 3)) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	// Backward, output word i never overlaps an unread sample.
+	for (int i = n - 1; i >= 0; i--) {
+		out[i] = (uint16_t) (((int) in[i] - MID_CODE) << LOAD_SHIFT);
+	}
+}
+
+/**
+ * adc_fft
+ */
+void adc_fft(int16_t *buf, int n)
+{
+	uint32_t *x = (uint32_t *) buf, *p, x0, x1, x2, x3, a, b, c, d, w1, w2, w3, t;
+	int q, step, bits, r;
+
+	if ((n != 16 && n != 64 && n != 256 && n != 1024) || ((unsigned int) buf & 3)) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (int l = n; l >= 4; l >>= 2) {
+		q = l >> 2;
+		step = TAB_N / l;
+		for (int j = 0; j < q; j++) {
+			w1 = twiddle(j * step);
+			w2 = twiddle(2 * j * step);
+			w3 = twiddle(3 * j * step);
+			for (p = x + j; p < x + n; p += l) {
+				x0 = p[0];
+				x1 = p[q];
+				x2 = p[2 * q];
+				x3 = p[3 * q];
+				a = HADD(x0, x2);
+				b = HSUB(x0, x2);
+				c = HADD(x1, x3);
+				d = HSUB(x1, x3);
+				p[0] = HADD(a, c);
+				if (j == 0) {
+					p[q] = HSUB_JX(b, d);
+					p[2 * q] = HSUB(a, c);
+					p[3 * q] = HADD_JX(b, d);
+					continue;
+				}
+				t = HSUB_JX(b, d);
+#if FFT_SIMD == 1
+				// t * conj(w): re = tr * c + ti * s, im = ti * c - tr * s.
+				p[q] = __PKHBT((int32_t) __SMUAD(t, w1) >> 15, (int32_t) __SMUSDX(w1, t) >> 15, 16);
+				t = HSUB(a, c);
+				p[2 * q] = __PKHBT((int32_t) __SMUAD(t, w2) >> 15, (int32_t) __SMUSDX(w2, t) >> 15, 16);
+				t = HADD_JX(b, d);
+				p[3 * q] = __PKHBT((int32_t) __SMUAD(t, w3) >> 15, (int32_t) __SMUSDX(w3, t) >> 15, 16);
+#else
+				p[q] = PACK((RE(t) * RE(w1) + IM(t) * IM(w1)) >> 15, (IM(t) * RE(w1) - RE(t) * IM(w1)) >> 15);
+				t = HSUB(a, c);
+				p[2 * q] = PACK((RE(t) * RE(w2) + IM(t) * IM(w2)) >> 15, (IM(t) * RE(w2) - RE(t) * IM(w2)) >> 15);
+				t = HADD_JX(b, d);
+				p[3 * q] = PACK((RE(t) * RE(w3) + IM(t) * IM(w3)) >> 15, (IM(t) * RE(w3) - RE(t) * IM(w3)) >> 15);
+#endif
+			}
+		}
+	}
+	// Base-4 digit reversal.
+	for (bits = 0; (1 << bits) < n; bits += 2)
+		;
+	for (int i = 1; i < n; i++) {
+		r = 0;
+		for (int k = 0; k < bits; k += 2) {
+			r |= ((i >> k) & 3) << (bits - 2 - k);
+		}
+		if (r > i) {
+			t = x[i];
+			x[i] = x[r];
+			x[r] = t;
+		}
+	}
+}
+
+/**
+ * adc_fft_mag
+ */
+void adc_fft_mag(int16_t *buf, int n)
+{
+	const int16_t *in = buf;
+	uint16_t *out = (uint16_t *) buf;
+	int re, im;
+
+	// Forward, halfword k never overlaps an unread value (2k, 2k + 1).
+	for (int k = 0; k <= n / 2; k++) {
+		re = in[2 * k];
+		im = in[2 * k + 1];
+		out[k] = isqrt((uint32_t) (re * re + im * im));
+	}
+}
+
+/**
+ * sin_q15
+ */
+static int sin_q15(unsigned int i)
+{
+	i &= TAB_N - 1;
+	if (i <= TAB_N / 4) {
+		return (sin_tab[i]);
+	} else if (i <= TAB_N / 2) {
+		return (sin_tab[TAB_N / 2 - i]);
+	} else if (i <= 3 * TAB_N / 4) {
+		return (-sin_tab[i - TAB_N / 2]);
+	} else {
+		return (-sin_tab[TAB_N - i]);
+	}
+}
+
+/**
+ * twiddle
+ *
+ * Packed cos (low halfword) and sin (high halfword) of 2 * pi * i / TAB_N.
+ */
+static uint32_t twiddle(unsigned int i)
+{
+	return (((uint32_t) sin_q15(i + TAB_N / 4) & 0xFFFF) | (uint32_t) sin_q15(i) << 16);
+}
+
+/**
+ * isqrt
+ */
+static uint32_t isqrt(uint64_t v)
+{
+	uint64_t r = 0, b = (uint64_t) 1 << 62;
+
+	while (b > v) {
+		b >>= 2;
+	}
+	while (b) {
+		if (v >= r + b) {
+			v -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+	return (r);
+}
+
+#if TERMOUT == 1
+/**
+ * log_adc_fft_bench
+ */
+void log_adc_fft_bench(int16_t *buf)
+{
+	uint16_t *smp = (uint16_t *) buf;
+	int32_t coef = adc_goertzel_coef(1, 16);
+	uint32_t cyc[3], amp;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	for (int n = 256, i = 0; i < 2; n = ADC_FFT_MAX_N, i++) {
+		for (int k = 0; k < n; k++) {
+			smp[k] = MID_CODE + ((sin_q15(k * (TAB_N / 16)) * 2000) >> 15);
+		}
+		adc_fft_load(buf, n);
+		taskENTER_CRITICAL();
+		cyc[i] = DWT->CYCCNT;
+		adc_fft(buf, n);
+		cyc[i] = DWT->CYCCNT - cyc[i];
+		taskEXIT_CRITICAL();
+	}
+	for (int k = 0; k < 256; k++) {
+		smp[k] = MID_CODE + ((sin_q15(k * (TAB_N / 16)) * 2000) >> 15);
+	}
+	taskENTER_CRITICAL();
+	cyc[2] = DWT->CYCCNT;
+	adc_goertzel(smp, 256, &coef, 1, &amp);
+	cyc[2] = DWT->CYCCNT - cyc[2];
+	taskEXIT_CRITICAL();
+	msg(INF, "adc_fft.c: simd=%d cyc: fft256=%u fft1024=%u goertzel256=%u (amp=%u)\n", FFT_SIMD, cyc[0],
+	    cyc[1], cyc[2], amp);
+}
+#endif
+
+#endif
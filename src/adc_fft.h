@@ -0,0 +1,123 @@
+/*
+ * adc_fft.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file adc_fft.h
+ *
+ * @brief Spectral analysis of ADC sample buffers (Goertzel, radix-4 FFT).
+ *
+ * Two fixed-point kernels for frequency-domain results from buffers of 12-bit
+ * samples (e.g. from adc_strm_read() or adc_strm_split()):
+ * - Goertzel: amplitudes of a few selected frequencies (mains harmonics, tone
+ *   detection) in O(cnt) per frequency, any buffer length, no extra RAM,
+ * - radix-4 decimation-in-frequency FFT, n = 16, 64, 256 or 1024 points,
+ *   in place on a buffer of n complex Q15 values (re, im halfword pairs).
+ *   adc_fft_load() expands n samples to complex values inside the same
+ *   buffer, so a capture buffer of 2 * n halfwords is the only RAM needed.
+ *   Every stage scales by 1/4 (no overflow), the result is X[k] / n.
+ *
+ * On Cortex-M4 parts (SAM4S, SAM4N) the FFT butterflies use the DSP
+ * instructions SHADD16/SHSUB16/SHASX/SHSAX (halving complex adds) and
+ * SMUAD/SMUSDX (twiddle multiply); SAM3 parts use portable code with
+ * identical results.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when ADC_FFT == 1.
+ */
+
+#ifndef ADC_FFT_H
+#define ADC_FFT_H
+
+#ifndef ADC_FFT
+ #define ADC_FFT 0
+#endif
+
+#if ADC_FFT == 1
+
+#define ADC_FFT_MAX_N 1024
+
+/**
+ * @brief Compute Goertzel coefficient for frequency f.
+ *
+ * @param f  Frequency (any unit, 0 <= f < fs / 2).
+ * @param fs Sample rate (same unit as f).
+ *
+ * @return 2 * cos(2 * pi * f / fs) in Q14.
+ */
+int32_t adc_goertzel_coef(unsigned int f, unsigned int fs);
+
+/**
+ * @brief Compute amplitudes of selected frequencies.
+ *
+ * Samples are taken relative to the mid-scale code 2048. For a sine of
+ * amplitude A (codes) at a frequency completing a whole number of periods
+ * in the buffer, the result is A.
+ *
+ * @param in   Samples (12-bit).
+ * @param cnt  Number of samples (1..65535).
+ * @param coef Coefficients from adc_goertzel_coef().
+ * @param nf   Number of frequencies.
+ * @param amp  Amplitudes in codes (return, nf values).
+ */
+void adc_goertzel(const uint16_t *in, int cnt, const int32_t *coef, int nf, uint32_t *amp);
+
+/**
+ * @brief Expand samples to complex FFT input in place.
+ *
+ * The first n halfwords of buf are 12-bit samples, they are converted to
+ * n complex values (code - 2048) * 8 + j0 filling the whole buffer.
+ *
+ * @param buf Buffer of 2 * n halfwords (32-bit aligned).
+ * @param n   Number of samples.
+ */
+void adc_fft_load(int16_t *buf, int n);
+
+/**
+ * @brief In-place forward FFT.
+ *
+ * @param buf n complex Q15 values (re, im), 32-bit aligned. Replaced by
+ *            X[k] / n in natural order.
+ * @param n   Transform length (16, 64, 256 or 1024).
+ */
+void adc_fft(int16_t *buf, int n);
+
+/**
+ * @brief Replace FFT result by magnitudes in place.
+ *
+ * Halfword k of buf receives |X[k]| for k = 0..n / 2.
+ *
+ * @param buf FFT result.
+ * @param n   Transform length.
+ */
+void adc_fft_mag(int16_t *buf, int n);
+
+#if TERMOUT == 1
+/**
+ * @brief Measure transform speed with the DWT cycle counter (terminal output).
+ *
+ * Logs cycles of 256 and 1024-point FFT and of a 256-sample Goertzel per
+ * frequency. The content of buf is overwritten.
+ *
+ * @param buf Buffer of 2 * ADC_FFT_MAX_N halfwords (32-bit aligned).
+ */
+void log_adc_fft_bench(int16_t *buf);
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * adc_flt.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "adc_flt.h"
+
+#if ADC_FLT == 1
+
+#if SAM4S_SERIES || SAM4N_SERIES
+ #define FLT_SIMD 1
+#else
+ #define FLT_SIMD 0
+#endif
+
+#define IIR_FRAC 3
+
+static uint32_t sum_grp(const uint16_t *p, int r);
+
+/**
+ * adc_flt_boxcar
+ */
+int adc_flt_boxcar(const uint16_t *in, int cnt, int r, int shift, uint16_t *out)
+{
+	int n;
+
+	if (r < 1 || r > 4096 || cnt < 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (n = 0; cnt >= r; n++, cnt -= r, in += r) {
+		out[n] = sum_grp(in, r) >> shift;
+	}
+	return (n);
+}
+
+/**
+ * sum_grp
+ */
+static uint32_t sum_grp(const uint16_t *p, int r)
+{
+	uint32_t acc = 0;
+
+#if FLT_SIMD == 1
+	const uint32_t *w;
+
+	if (!((unsigned int) p & 3)) {
+		// SADD16 adds sample pairs of two words (12-bit lanes cannot
+		// overflow), SMLAD with 1:1 sums both lanes into acc.
+		for (w = (const uint32_t *) p; r >= 4; r -= 4, w += 2) {
+			acc = __SMLAD(__SADD16(w[0], w[1]), 0x00010001, acc);
+		}
+		p = (const uint16_t *) w;
+	}
+#endif
+	for (; r >= 4; r -= 4, p += 4) {
+		acc += p[0] + p[1] + p[2] + p[3];
+	}
+	while (r--) {
+		acc += *p++;
+	}
+	return (acc);
+}
+
+/**
+ * adc_cic_init
+ */
+void adc_cic_init(struct adc_cic *f)
+{
+	uint64_t g = 4096;
+
+	if (f->r < 2 || f->r > 4096 || f->order < 1 || f->order > ADC_CIC_MAX_ORDER || f->shift < 0 ||
+	    f->shift > 31) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (int i = 0; i < f->order; i++) {
+		g *= f->r;
+	}
+	if (g > 0x100000000ULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (int i = 0; i < ADC_CIC_MAX_ORDER; i++) {
+		f->integ[i] = f->comb[i] = 0;
+	}
+	f->phase = 0;
+}
+
+/**
+ * adc_cic_run
+ */
+int adc_cic_run(struct adc_cic *f, const uint16_t *in, int cnt, uint16_t *out)
+{
+	uint32_t i0 = f->integ[0], i1 = f->integ[1], i2 = f->integ[2], v, t;
+	int n = 0, k;
+
+	// Modulo 2^32 arithmetic: integrator wrap is cancelled by the combs.
+	for (; cnt; cnt--) {
+		i0 += *in++;
+		i1 += i0;
+		i2 += i1;
+		if (++f->phase < f->r) {
+			continue;
+		}
+		f->phase = 0;
+		v = (f->order == 1) ? i0 : (f->order == 2) ? i1 : i2;
+		for (k = 0; k < f->order; k++) {
+			t = v;
+			v -= f->comb[k];
+			f->comb[k] = t;
+		}
+		out[n++] = v >> f->shift;
+	}
+	f->integ[0] = i0;
+	f->integ[1] = i1;
+	f->integ[2] = i2;
+	return (n);
+}
+
+/**
+ * adc_mavg_init
+ */
+void adc_mavg_init(struct adc_mavg *f, unsigned int x0)
+{
+	if (f->hist == NULL || f->w < 1 || f->w > 0xFFFF) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (int i = 0; i < f->w; i++) {
+		f->hist[i] = x0;
+	}
+	f->pos = 0;
+	f->sum = x0 * f->w;
+}
+
+/**
+ * adc_mavg_run
+ */
+void adc_mavg_run(struct adc_mavg *f, const uint16_t *in, int cnt, uint16_t *out)
+{
+	uint32_t sum = f->sum;
+	unsigned int x;
+	int pos = f->pos;
+
+	while (cnt--) {
+		x = *in++;
+		sum += x - f->hist[pos];
+		f->hist[pos] = x;
+		if (++pos == f->w) {
+			pos = 0;
+		}
+		*out++ = sum / f->w;
+	}
+	f->sum = sum;
+	f->pos = pos;
+}
+
+/**
+ * adc_iir_init
+ */
+void adc_iir_init(struct adc_iir *f, unsigned int y0)
+{
+	if (f->a < 1 || f->a > 32767) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	f->y = y0 << IIR_FRAC;
+}
+
+/**
+ * adc_iir_run
+ */
+void adc_iir_run(struct adc_iir *f, const uint16_t *in, int cnt, uint16_t *out)
+{
+	uint32_t y = f->y;
+
+	// y = (a * x + (1 - a) * y) in Q15, samples scaled to 15 bits.
+#if FLT_SIMD == 1
+	uint32_t c = (32768 - f->a) << 16 | f->a;
+
+	while (cnt--) {
+		y = __SMLAD(__PKHBT(*in++ << IIR_FRAC, y, 16), c, 1 << 14) >> 15;
+		*out++ = (y + (1 << (IIR_FRAC - 1))) >> IIR_FRAC;
+	}
+#else
+	uint32_t a = f->a, b = 32768 - f->a;
+
+	while (cnt--) {
+		y = (a * (*in++ << IIR_FRAC) + b * y + (1 << 14)) >> 15;
+		*out++ = (y + (1 << (IIR_FRAC - 1))) >> IIR_FRAC;
+	}
+#endif
+	f->y = y;
+}
+
+#if TERMOUT == 1
+/**
+ * log_adc_flt_bench
+ */
+void log_adc_flt_bench(uint16_t *buf, int cnt)
+{
+	static uint16_t hist[16];
+	struct adc_cic cic = {.r = 16, .order = 3, .shift = 12};
+	struct adc_mavg mavg = {.hist = hist, .w = 16};
+	struct adc_iir iir = {.a = 2048};
+	uint32_t cyc[4];
+
+	if (cnt < 16 || cnt % 16) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	for (int i = 0; i < cnt; i++) {
+		buf[i] = (i * 37) & 0xFFF;
+	}
+	adc_cic_init(&cic);
+	adc_mavg_init(&mavg, 0);
+	adc_iir_init(&iir, 0);
+	taskENTER_CRITICAL();
+	cyc[0] = DWT->CYCCNT;
+	adc_iir_run(&iir, buf, cnt, buf);
+	cyc[0] = DWT->CYCCNT - cyc[0];
+	cyc[1] = DWT->CYCCNT;
+	adc_mavg_run(&mavg, buf, cnt, buf);
+	cyc[1] = DWT->CYCCNT - cyc[1];
+	cyc[2] = DWT->CYCCNT;
+	adc_cic_run(&cic, buf, cnt, buf);
+	cyc[2] = DWT->CYCCNT - cyc[2];
+	cyc[3] = DWT->CYCCNT;
+	adc_flt_boxcar(buf, cnt, 16, 2, buf);
+	cyc[3] = DWT->CYCCNT - cyc[3];
+	taskEXIT_CRITICAL();
+	// Cycles per sample in 1/100.
+	msg(INF, "adc_flt.c: simd=%d cnt=%d cyc/smp*100: iir=%u mavg=%u cic3=%u boxcar16=%u\n", FLT_SIMD, cnt,
+	    cyc[0] * 100 / cnt, cyc[1] * 100 / cnt, cyc[2] * 100 / cnt, cyc[3] * 100 / cnt);
+}
+#endif
+
+#endif
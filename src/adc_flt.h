@@ -0,0 +1,177 @@
+/*
+ * adc_flt.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file adc_flt.h
+ *
+ * @brief Block filters for ADC sample buffers.
+ *
+ * Filters process whole buffers of 12-bit samples (e.g. from adc_strm_read()
+ * or adc_strm_split()) instead of single conversions:
+ * - boxcar decimation (sum of r samples, shifted): oversampling by 4^k with
+ *   shift k adds k bits of resolution,
+ * - CIC decimation of order 1..3 for streams split into several buffers,
+ * - moving average,
+ * - first-order IIR smoothing with a Q15 coefficient.
+ *
+ * All filters may run in place (out == in). On Cortex-M4 parts (SAM4S,
+ * SAM4N) the boxcar and IIR kernels use the DSP instructions SADD16/SMLAD
+ * and PKHBT; SAM3 parts use equivalent portable code with identical results.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when ADC_FLT == 1.
+ */
+
+#ifndef ADC_FLT_H
+#define ADC_FLT_H
+
+#ifndef ADC_FLT
+ #define ADC_FLT 0
+#endif
+
+#if ADC_FLT == 1
+
+#define ADC_CIC_MAX_ORDER 3
+
+/**
+ * @struct adc_cic
+ *
+ * @brief CIC decimator state.
+ */
+struct adc_cic {
+	int r;			/**< Set by caller: Decimation ratio (2..4096). */
+	int order;		/**< Set by caller: Filter order (1..ADC_CIC_MAX_ORDER). */
+	int shift;		/**< Set by caller: Output right shift (gain is r^order). */
+	uint32_t integ[ADC_CIC_MAX_ORDER];
+	uint32_t comb[ADC_CIC_MAX_ORDER];
+	int phase;
+};
+
+/**
+ * @struct adc_mavg
+ *
+ * @brief Moving average state.
+ */
+struct adc_mavg {
+	uint16_t *hist;		/**< Set by caller: History buffer of w samples. */
+	int w;			/**< Set by caller: Window length (1..65535). */
+	int pos;
+	uint32_t sum;
+};
+
+/**
+ * @struct adc_iir
+ *
+ * @brief First-order IIR state: y += a * (x - y).
+ */
+struct adc_iir {
+	int a;			/**< Set by caller: Coefficient in Q15 (1..32767). */
+	uint32_t y;
+};
+
+/**
+ * @brief Boxcar decimation.
+ *
+ * out[j] = (in[j * r] + ... + in[j * r + r - 1]) >> shift. Trailing samples
+ * of an incomplete group are ignored.
+ *
+ * @param in    Input samples (12-bit).
+ * @param cnt   Number of input samples.
+ * @param r     Decimation ratio (1..4096).
+ * @param shift Output right shift.
+ * @param out   Output samples, cnt / r items.
+ *
+ * @return Number of output samples.
+ */
+int adc_flt_boxcar(const uint16_t *in, int cnt, int r, int shift, uint16_t *out);
+
+/**
+ * @brief Reset CIC decimator state.
+ *
+ * @param f Decimator (r, order, shift set; r^order * 4096 must fit 32 bits).
+ */
+void adc_cic_init(struct adc_cic *f);
+
+/**
+ * @brief Run CIC decimator.
+ *
+ * The state carries over between calls, so cnt need not be a multiple of r.
+ *
+ * @param f   Decimator.
+ * @param in  Input samples (12-bit).
+ * @param cnt Number of input samples.
+ * @param out Output samples, up to cnt / r + 1 items.
+ *
+ * @return Number of output samples.
+ */
+int adc_cic_run(struct adc_cic *f, const uint16_t *in, int cnt, uint16_t *out);
+
+/**
+ * @brief Reset moving average state (history filled with x0).
+ *
+ * @param f  Moving average (hist, w set).
+ * @param x0 Initial sample value.
+ */
+void adc_mavg_init(struct adc_mavg *f, unsigned int x0);
+
+/**
+ * @brief Run moving average.
+ *
+ * @param f   Moving average.
+ * @param in  Input samples (12-bit).
+ * @param cnt Number of samples.
+ * @param out Output samples, cnt items.
+ */
+void adc_mavg_run(struct adc_mavg *f, const uint16_t *in, int cnt, uint16_t *out);
+
+/**
+ * @brief Reset IIR state.
+ *
+ * @param f  IIR filter (a set).
+ * @param y0 Initial output value.
+ */
+void adc_iir_init(struct adc_iir *f, unsigned int y0);
+
+/**
+ * @brief Run IIR smoothing.
+ *
+ * The state keeps 3 fractional bits, so small coefficients still converge.
+ *
+ * @param f   IIR filter.
+ * @param in  Input samples (12-bit).
+ * @param cnt Number of samples.
+ * @param out Output samples, cnt items.
+ */
+void adc_iir_run(struct adc_iir *f, const uint16_t *in, int cnt, uint16_t *out);
+
+#if TERMOUT == 1
+/**
+ * @brief Measure filter speed with the DWT cycle counter (terminal output).
+ *
+ * Logs cycles per input sample of each filter run over buf (the content is
+ * overwritten by the in-place runs).
+ *
+ * @param buf Sample buffer (32-bit aligned).
+ * @param cnt Number of samples (multiple of 16).
+ */
+void log_adc_flt_bench(uint16_t *buf, int cnt);
+#endif
+
+#endif
+
+#endif
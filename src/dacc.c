@@ -25,10 +25,33 @@
 #include "board.h"
 #include <mmio.h>
 #include "criterr.h"
+#include "hwerr.h"
 #include "pmc.h"
+#include "msgconf.h"
+#include "tc.h"
 #include "dacc.h"
 
-#if DACC_FREE_RUN == 1
+#if DACC_FREE_RUN == 1 || DACC_TRG_STRM == 1
+
+#if DACC_FREE_RUN == 1 && DACC_TRG_STRM == 1
+ #error "DACC_FREE_RUN and DACC_TRG_STRM are mutually exclusive"
+#endif
+
+#if DACC_TRG_STRM == 1 && DACC_STRM_TC_TRG == 1
+#if DACC_STRM_TID < ID_TC0 || DACC_STRM_TID > ID_TC2
+ #error "DACC trigger must be TC channel ID_TC0..ID_TC2"
+#endif
+#endif
+
+#if DACC_TRG_STRM == 1
+static dacc dc;
+static QueueHandle_t strm_que;
+static int strm_cur, strm_nxt, strm_held, strm_tcr;
+static boolean_t strm_run;
+static struct dacc_strm_stats strm_stats;
+
+static int strm_arm_buf(int idx);
+#endif
 
 /**
  * init_dacc
@@ -52,7 +75,68 @@ void init_dacc(dacc dev)
 	DACC->DACC_MR = dev->mr & ~(DACC_MR_WORD | DACC_MR_TRGEN);
 #endif
 #endif
+#if DACC_TRG_STRM == 1
+	if (dev->buf[0] == NULL || dev->buf[1] == NULL || dev->buf_size < 1 || dev->buf_size > 0xFFFF) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+#if SAM3S_SERIES || SAM4S_SERIES
+	if (!dev->chnls_bmp || (dev->chnls_bmp & ~(DACC_CHER_CH0 | DACC_CHER_CH1))) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	// Channel pairs are transferred as one tagged word.
+	if (dev->chnls_bmp == (DACC_CHER_CH0 | DACC_CHER_CH1)) {
+		if ((dev->buf_size & 1) || ((unsigned int) dev->buf[0] & 3) || ((unsigned int) dev->buf[1] & 3)) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		strm_tcr = dev->buf_size / 2;
+	} else {
+		strm_tcr = dev->buf_size;
+	}
+#else
+	strm_tcr = dev->buf_size;
+#endif
+	if (strm_que == NULL) {
+		if (NULL == (strm_que = xQueueCreate(2, sizeof(uint16_t *)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	} else {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dc = dev;
+	strm_cur = strm_nxt = strm_held = -1;
+	DACC->DACC_PTCR = DACC_PTCR_RXTDIS | DACC_PTCR_TXTDIS;
+	// Only TIOA0..TIOA2 of the first TC block can trigger the DACC.
+#if SAM3S_SERIES
+	DACC->DACC_MR = (dev->mr & ~(DACC_MR_MAXS | DACC_MR_SLEEP | DACC_MR_WORD | DACC_MR_TRGSEL_Msk)) |
+#elif SAM4S_SERIES
+	DACC->DACC_MR = (dev->mr & ~(DACC_MR_MAXS | DACC_MR_WORD | DACC_MR_TRGSEL_Msk)) | DACC_MR_ONE |
+#else
+	DACC->DACC_MR = (dev->mr & ~(DACC_MR_WORD | DACC_MR_TRGSEL_Msk)) | DACC_MR_DACEN |
+#endif
+#if SAM3S_SERIES || SAM4S_SERIES
+			((strm_tcr != dev->buf_size) ? DACC_MR_WORD : 0) | DACC_MR_TAG |
+#endif
+#if DACC_STRM_TC_TRG == 1
+			DACC_MR_TRGEN | (tc_chnl(DACC_STRM_TID) + 1) << DACC_MR_TRGSEL_Pos;
+	enable_periph_clk(DACC_STRM_TID);
+	TC0->TC_CHANNEL[tc_chnl(DACC_STRM_TID)].TC_CCR = TC_CCR_CLKDIS;
+	TC0->TC_CHANNEL[tc_chnl(DACC_STRM_TID)].TC_IDR = ~0;
+	tc_set_wave_rate(DACC_STRM_TID, dev->rate, FALSE);
+#else
+			DACC_MR_TRGEN;
+#endif
+#if SAM3S_SERIES || SAM4S_SERIES
+	DACC->DACC_ACR = dev->acr;
+	DACC->DACC_CHER = dev->chnls_bmp;
+#endif
+	NVIC_ClearPendingIRQ(ID_DACC);
+	NVIC_SetPriority(ID_DACC, configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(ID_DACC);
+#endif
 }
+#endif
+
+#if DACC_FREE_RUN == 1
 
 /**
  * enable_dacc_chnl
@@ -98,3 +182,183 @@ void write_dacc_fifo(unsigned int cd)
 #endif
 }
 #endif
+
+#if DACC_TRG_STRM == 1
+/**
+ * dacc_strm_start
+ */
+void dacc_strm_start(void)
+{
+	if (strm_run) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	xQueueReset(strm_que);
+	taskENTER_CRITICAL();
+	DACC->DACC_TPR = (unsigned int) dc->buf[0];
+	DACC->DACC_TCR = strm_tcr;
+	DACC->DACC_TNPR = (unsigned int) dc->buf[1];
+	DACC->DACC_TNCR = strm_tcr;
+	strm_cur = 0;
+	strm_nxt = 1;
+	strm_held = -1;
+	DACC->DACC_ISR;
+	DACC->DACC_IER = DACC_IER_ENDTX;
+	DACC->DACC_PTCR = DACC_PTCR_TXTEN;
+#if DACC_STRM_TC_TRG == 1
+	TC0->TC_CHANNEL[tc_chnl(DACC_STRM_TID)].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+#endif
+	strm_run = TRUE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * dacc_strm_stop
+ */
+void dacc_strm_stop(void)
+{
+	taskENTER_CRITICAL();
+#if DACC_STRM_TC_TRG == 1
+	TC0->TC_CHANNEL[tc_chnl(DACC_STRM_TID)].TC_CCR = TC_CCR_CLKDIS;
+#endif
+	DACC->DACC_IDR = ~0;
+	DACC->DACC_PTCR = DACC_PTCR_TXTDIS;
+	strm_cur = strm_nxt = strm_held = -1;
+	strm_run = FALSE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * dacc_strm_next
+ */
+int dacc_strm_next(uint16_t **buf, TickType_t tmo)
+{
+	int idx;
+
+	if (strm_held != -1) {
+		taskENTER_CRITICAL();
+		idx = (strm_run) ? strm_arm_buf(strm_held) : -1;
+		strm_held = idx;
+		if (idx != -1) {
+			// Current buffer completed while the refilled one was armed.
+			strm_stats.blk++;
+		}
+		taskEXIT_CRITICAL();
+		if (idx != -1) {
+			*buf = dc->buf[idx];
+			return (0);
+		}
+	}
+	if (pdFALSE == xQueueReceive(strm_que, buf, tmo)) {
+		return (-ETMO);
+	}
+	strm_held = (*buf == dc->buf[0]) ? 0 : 1;
+	return (0);
+}
+
+#if DACC_STRM_TC_TRG == 1
+/**
+ * dacc_strm_set_rate
+ */
+unsigned int dacc_strm_set_rate(unsigned int hz)
+{
+	return (tc_set_wave_rate(DACC_STRM_TID, hz, strm_run));
+}
+#endif
+
+/**
+ * get_dacc_strm_stats
+ */
+void get_dacc_strm_stats(struct dacc_strm_stats *st)
+{
+	taskENTER_CRITICAL();
+	*st = strm_stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * strm_arm_buf
+ *
+ * Hand buffer idx back to the PDC (caller masks the DACC interrupt). Returns
+ * index of the buffer completed meanwhile by the PDC, or -1.
+ */
+static int strm_arm_buf(int idx)
+{
+	int done;
+
+	if (strm_cur == -1) {
+		DACC->DACC_TPR = (unsigned int) dc->buf[idx];
+		DACC->DACC_TCR = strm_tcr;
+		strm_cur = idx;
+		DACC->DACC_IER = DACC_IER_TXBUFE;
+		DACC->DACC_PTCR = DACC_PTCR_TXTEN;
+		return (-1);
+	}
+	DACC->DACC_TNPR = (unsigned int) dc->buf[idx];
+	DACC->DACC_TNCR = strm_tcr;
+	if (DACC->DACC_TNCR == 0) {
+		// Current buffer completed and next one was loaded immediately.
+		done = strm_cur;
+		strm_cur = idx;
+		return (done);
+	}
+	strm_nxt = idx;
+	DACC->DACC_IDR = DACC_IDR_TXBUFE;
+	DACC->DACC_IER = DACC_IER_ENDTX;
+	return (-1);
+}
+
+/**
+ * DACC_Handler
+ */
+void DACC_Handler(void)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	unsigned int isr;
+	int idx;
+
+	isr = DACC->DACC_ISR;
+	strm_stats.intr++;
+	isr &= DACC->DACC_IMR;
+	if (isr & (DACC_ISR_ENDTX | DACC_ISR_TXBUFE)) {
+		idx = strm_cur;
+		if (isr & DACC_ISR_ENDTX) {
+			// PDC continues with the next buffer.
+			strm_cur = strm_nxt;
+			strm_nxt = -1;
+			DACC->DACC_IDR = DACC_IDR_ENDTX;
+			DACC->DACC_IER = DACC_IER_TXBUFE;
+		} else {
+			strm_cur = -1;
+			strm_stats.starv++;
+			DACC->DACC_IDR = DACC_IDR_TXBUFE;
+			DACC->DACC_PTCR = DACC_PTCR_TXTDIS;
+		}
+		while (idx != -1) {
+			if (errQUEUE_FULL != xQueueSendFromISR(strm_que, &dc->buf[idx], &tsk_wkn)) {
+				strm_stats.blk++;
+				break;
+			}
+			strm_stats.que_full++;
+			idx = strm_arm_buf(idx);
+		}
+	}
+	portEND_SWITCHING_ISR(tsk_wkn);
+}
+
+#if TERMOUT == 1
+/**
+ * log_dacc_strm_stats
+ */
+void log_dacc_strm_stats(void)
+{
+	struct dacc_strm_stats st;
+	UBaseType_t pr;
+
+	get_dacc_strm_stats(&st);
+	pr = uxTaskPriorityGet(NULL);
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	msg(INF, "dacc.c: blk=%u starv=%u que_full=%u intr=%u\n", st.blk, st.starv, st.que_full, st.intr);
+	vTaskPrioritySet(NULL, pr);
+}
+#endif
+#endif
@@ -22,8 +22,16 @@
 #ifndef DACC_FREE_RUN
  #define DACC_FREE_RUN 0
 #endif
+#ifndef DACC_TRG_STRM
+ #define DACC_TRG_STRM 0
+#endif
+// DACC_TRG_STRM trigger: 1 -> TIOA of TC channel DACC_STRM_TID (ID_TC0..ID_TC2),
+// 0 -> DATRG pin.
+#ifndef DACC_STRM_TC_TRG
+ #define DACC_STRM_TC_TRG 1
+#endif
 
-#if DACC_FREE_RUN == 1
+#if DACC_FREE_RUN == 1 || DACC_TRG_STRM == 1
 
 typedef struct dacc_dev *dacc;
 
@@ -36,11 +44,37 @@ typedef struct dacc_dev *dacc;
  #error "SAM_SERIES definition error"
 #endif
 
+#if DACC_TRG_STRM == 1
+#if SAM3S_SERIES || SAM4S_SERIES
+// Stream sample: data bits[11:0], channel (tag) bits[13:12].
+ #define DACC_STRM_SMP(chn, val) (((val) & 0xFFF) | (chn) << 12)
+#else
+ #define DACC_STRM_SMP(chn, val) ((val) & 0x3FF)
+#endif
+
+struct dacc_strm_stats {
+	unsigned int blk; // Buffers converted and returned for refill.
+	unsigned int starv; // PDC ran out of buffers (writer too slow).
+	unsigned int que_full; // Free buffers not reported because the queue was full.
+	unsigned int intr; // Interrupts.
+};
+#endif
+
 struct dacc_dev {
 	unsigned int mr; // <SetIt>
 #if SAM3S_SERIES || SAM4S_SERIES
 	unsigned int acr; // <SetIt>
 #endif
+#if DACC_TRG_STRM == 1
+#if SAM3S_SERIES || SAM4S_SERIES
+	unsigned int chnls_bmp; // <SetIt> DACC_CHER_CH0 and/or DACC_CHER_CH1.
+#endif
+	uint16_t *buf[2]; // <SetIt> Two sample buffers (DACC_STRM_SMP() values).
+	int buf_size; // <SetIt> Samples per buffer (1..65535, even for two channels).
+#if DACC_STRM_TC_TRG == 1
+	unsigned int rate; // <SetIt> Trigger rate in Hz.
+#endif
+#endif
 };
 
 /**
@@ -51,6 +85,9 @@ struct dacc_dev {
  * @dev: DACC device.
  */
 void init_dacc(dacc dev);
+#endif
+
+#if DACC_FREE_RUN == 1
 
 /**
  * enable_dacc_chnl
@@ -73,4 +110,68 @@ void enable_dacc_chnl(unsigned int cd);
 void write_dacc_fifo(unsigned int cd);
 #endif
 
+#if DACC_TRG_STRM == 1
+/**
+ * dacc_strm_start
+ *
+ * Start continuous conversion. Every trigger converts one sample; the PDC
+ * feeds the two buffers alternately, so the caller fills both of them before
+ * the start. With both channels enabled (SAM3S/SAM4S) the buffers hold
+ * channel 0/1 sample pairs, each pair is one tagged word transfer and the
+ * rate per channel is half of the trigger rate. Pending buffers from a
+ * previous run are discarded.
+ */
+void dacc_strm_start(void);
+
+/**
+ * dacc_strm_stop
+ *
+ * Stop trigger and conversion. Outputs hold the last converted values.
+ */
+void dacc_strm_stop(void);
+
+/**
+ * dacc_strm_next
+ *
+ * Wait for a converted buffer to refill. The buffer returned by the previous
+ * call is handed back to the PDC first, so it must be refilled before the
+ * other one is converted, otherwise the output stalls at the last value
+ * (counted as starv in stats) until the next call.
+ *
+ * @buf: Free buffer of buf_size samples (return).
+ * @tmo: Timeout in OS ticks (portMAX_DELAY waits forever).
+ *
+ * Returns: 0 - success; -ETMO - no buffer within tmo.
+ */
+int dacc_strm_next(uint16_t **buf, TickType_t tmo);
+
+#if DACC_STRM_TC_TRG == 1
+/**
+ * dacc_strm_set_rate
+ *
+ * Set trigger rate. May be called while streaming; the trigger period
+ * restarts.
+ *
+ * @hz: Trigger rate in Hz.
+ *
+ * Returns: Rate set (quantized by the TC clock).
+ */
+unsigned int dacc_strm_set_rate(unsigned int hz);
+#endif
+
+/**
+ * get_dacc_strm_stats
+ *
+ * @st: Stream counters (return).
+ */
+void get_dacc_strm_stats(struct dacc_strm_stats *st);
+
+#if TERMOUT == 1
+/**
+ * log_dacc_strm_stats
+ */
+void log_dacc_strm_stats(void);
+#endif
+#endif
+
 #endif
@@ -0,0 +1,273 @@
+/*
+ * dds.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "dacc.h"
+#include "dds.h"
+
+#if DDS == 1
+
+#if DACC_TRG_STRM != 1
+ #error "DDS requires DACC_TRG_STRM"
+#endif
+
+#if SAM4S_SERIES || SAM4N_SERIES
+ #define DDS_SIMD 1
+#else
+ #define DDS_SIMD 0
+#endif
+
+#define UPD_FREQ (1 << 0)
+#define UPD_AMP (1 << 1)
+#define UPD_PH (1 << 2)
+
+#if SAM3S_SERIES || SAM4S_SERIES
+ #define CODE_BITS 12
+#else
+ #define CODE_BITS 10
+#endif
+
+// sin(pi / 2 * i / 64) in Q15, i = 0..64.
+static const int16_t qsin[65] = {
+	0, 804, 1608, 2411, 3212, 4011, 4808, 5602, 6393, 7180,
+	7962, 8740, 9512, 10279, 11039, 11793, 12540, 13279, 14010, 14733,
+	15447, 16151, 16846, 17531, 18205, 18868, 19520, 20160, 20788, 21403,
+	22006, 22595, 23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+	27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957, 30274, 30572,
+	30853, 31114, 31357, 31581, 31786, 31972, 32138, 32286, 32413, 32522,
+	32610, 32679, 32729, 32758, 32767
+};
+
+static uint32_t freq_step(struct dds *d, unsigned int f_mhz);
+static inline int smp(uint32_t ph, int amp, int offs);
+
+/**
+ * dds_init
+ */
+void dds_init(struct dds *d)
+{
+	if (d->fs == 0 || d->chn < 0 || d->chn > ((CODE_BITS == 12) ? 1 : 0)) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	d->ph = d->ph_add = 0;
+	d->cur.step = 0;
+	d->cur.inc = 0;
+	d->cur.left = 0;
+	d->cur.amp = 0;
+	d->cur.offs = 1 << (CODE_BITS - 1);
+	d->nxt = d->cur;
+	d->upd = 0;
+}
+
+/**
+ * dds_set_freq
+ */
+void dds_set_freq(struct dds *d, unsigned int f_mhz)
+{
+	uint32_t step = freq_step(d, f_mhz);
+
+	taskENTER_CRITICAL();
+	d->nxt.step = step;
+	d->nxt.inc = 0;
+	d->nxt.left = 0;
+	d->upd |= UPD_FREQ;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * dds_set_sweep
+ */
+void dds_set_sweep(struct dds *d, unsigned int f0_mhz, unsigned int f1_mhz, int n)
+{
+	uint32_t s0 = freq_step(d, f0_mhz), s1 = freq_step(d, f1_mhz);
+
+	if (n < 1) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	taskENTER_CRITICAL();
+	d->nxt.step = s0;
+	d->nxt.inc = ((int64_t) s1 - s0) / n;
+	d->nxt.left = n;
+	d->upd |= UPD_FREQ;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * dds_set_amp
+ */
+void dds_set_amp(struct dds *d, int amp, int offs)
+{
+	if (amp < 0 || amp >= 1 << CODE_BITS || offs < 0 || offs >= 1 << CODE_BITS) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	taskENTER_CRITICAL();
+	d->nxt.amp = amp;
+	d->nxt.offs = offs;
+	d->upd |= UPD_AMP;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * dds_set_phase
+ */
+void dds_set_phase(struct dds *d, uint32_t ph)
+{
+	taskENTER_CRITICAL();
+	d->ph_add += ph;
+	d->upd |= UPD_PH;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * dds_run
+ */
+void dds_run(struct dds *d, uint16_t *out, int cnt, int stride)
+{
+	uint32_t ph, step, tag = DACC_STRM_SMP(d->chn, 0);
+	int amp, offs;
+
+	if (d->upd) {
+		taskENTER_CRITICAL();
+		// Accumulator continues: phase stays continuous across blocks.
+		if (d->upd & UPD_FREQ) {
+			d->cur.step = d->nxt.step;
+			d->cur.inc = d->nxt.inc;
+			d->cur.left = d->nxt.left;
+		}
+		if (d->upd & UPD_AMP) {
+			d->cur.amp = d->nxt.amp;
+			d->cur.offs = d->nxt.offs;
+		}
+		d->ph += d->ph_add;
+		d->ph_add = 0;
+		d->upd = 0;
+		taskEXIT_CRITICAL();
+	}
+	ph = d->ph;
+	step = d->cur.step;
+	amp = d->cur.amp;
+	offs = d->cur.offs;
+	for (; d->cur.left && cnt; d->cur.left--, cnt--, out += stride) {
+		*out = smp(ph, amp, offs) | tag;
+		ph += step;
+		step += d->cur.inc;
+	}
+	d->cur.step = step;
+#if DDS_SIMD == 1
+	if (stride == 1 && !((unsigned int) out & 3)) {
+		uint32_t *w = (uint32_t *) out;
+
+		for (; cnt >= 2; cnt -= 2) {
+			*w++ = __PKHBT(smp(ph, amp, offs) | tag, (smp(ph + step, amp, offs) | tag), 16);
+			ph += 2 * step;
+		}
+		out = (uint16_t *) w;
+	}
+#endif
+	for (; cnt >= 2; cnt -= 2, out += 2 * stride) {
+		out[0] = smp(ph, amp, offs) | tag;
+		out[stride] = smp(ph + step, amp, offs) | tag;
+		ph += 2 * step;
+	}
+	if (cnt) {
+		*out = smp(ph, amp, offs) | tag;
+		ph += step;
+	}
+	d->ph = ph;
+}
+
+/**
+ * freq_step
+ */
+static uint32_t freq_step(struct dds *d, unsigned int f_mhz)
+{
+	if ((uint64_t) f_mhz * 2 >= (uint64_t) d->fs * 1000) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	return (((uint64_t) f_mhz << 32) / ((uint64_t) d->fs * 1000));
+}
+
+/**
+ * smp
+ */
+static inline int smp(uint32_t ph, int amp, int offs)
+{
+	uint32_t x;
+	int i, f, s;
+
+	// Quarter-wave symmetry, 64 segments with linear interpolation.
+	x = ph & 0x3FFFFFFF;
+	if (ph & 0x40000000) {
+		x = 0x3FFFFFFF - x;
+	}
+	i = x >> 24;
+	f = (x >> 8) & 0xFFFF;
+	s = qsin[i] + (((qsin[i + 1] - qsin[i]) * f) >> 16);
+	if (ph & 0x80000000) {
+		s = -s;
+	}
+	return (__USAT(offs + ((s * amp) >> 15), CODE_BITS));
+}
+
+#if TERMOUT == 1
+/**
+ * log_dds_bench
+ */
+void log_dds_bench(uint16_t *buf, int cnt)
+{
+	struct dds d = {.fs = 100000, .chn = 0};
+	uint32_t cyc[2];
+
+	if (cnt < 2 || cnt & 1) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	dds_init(&d);
+	dds_set_amp(&d, (1 << (CODE_BITS - 1)) - 1, 1 << (CODE_BITS - 1));
+	dds_set_freq(&d, 1000000);
+	dds_run(&d, buf, cnt, 1);
+	taskENTER_CRITICAL();
+	cyc[0] = DWT->CYCCNT;
+	dds_run(&d, buf, cnt, 1);
+	cyc[0] = DWT->CYCCNT - cyc[0];
+	taskEXIT_CRITICAL();
+	dds_set_sweep(&d, 100000, 40000000, cnt);
+	taskENTER_CRITICAL();
+	cyc[1] = DWT->CYCCNT;
+	dds_run(&d, buf, cnt, 1);
+	cyc[1] = DWT->CYCCNT - cyc[1];
+	taskEXIT_CRITICAL();
+	// Cycles per sample in 1/100.
+	cyc[0] = cyc[0] * 100 / cnt;
+	cyc[1] = cyc[1] * 100 / cnt;
+	msg(INF, "dds.c: simd=%d cyc/smp*100: tone=%u sweep=%u max_fs: tone=%u sweep=%u Hz\n", DDS_SIMD,
+	    cyc[0], cyc[1], (unsigned int) ((uint64_t) F_MCK * 100 / cyc[0]),
+	    (unsigned int) ((uint64_t) F_MCK * 100 / cyc[1]));
+}
+#endif
+
+#endif
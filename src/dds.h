@@ -0,0 +1,157 @@
+/*
+ * dds.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file dds.h
+ *
+ * @brief Direct digital synthesis of sine and chirp signals for the DACC.
+ *
+ * A 32-bit phase accumulator advances by a frequency dependent step every
+ * sample; the sine is taken from a 65-entry quarter-wave table in flash with
+ * linear interpolation (spurious level below the 12-bit DACC resolution), so
+ * no per-frequency table is precomputed in RAM. Blocks are generated on
+ * demand straight into DACC stream buffers (dacc_strm_next()).
+ *
+ * Key characteristics:
+ * - Parameter changes (frequency, sweep, amplitude, phase) are latched at the
+ *   start of the next dds_run() block. The accumulator is never reset, so a
+ *   frequency change continues from the current phase without a glitch.
+ * - Linear frequency sweep (chirp) with a per-sample step increment.
+ * - On Cortex-M4 parts (SAM4S, SAM4N) two samples are stored per word with
+ *   PKHBT; saturation uses USAT on all parts.
+ * - log_dds_bench() reports cycles per sample and the highest sample rate the
+ *   CPU can sustain on the running chip.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when DDS == 1.
+ * - Requires DACC_TRG_STRM == 1 (sample format DACC_STRM_SMP()).
+ */
+
+#ifndef DDS_H
+#define DDS_H
+
+#ifndef DDS
+ #define DDS 0
+#endif
+
+#if DDS == 1
+
+/**
+ * @struct dds_par
+ *
+ * @brief Generator parameters.
+ */
+struct dds_par {
+	uint32_t step;		/**< Phase step per sample (2^32 == one period). */
+	int32_t inc;		/**< Step increment per sample (sweep). */
+	int left;		/**< Remaining sweep samples. */
+	int amp;		/**< Amplitude in DACC codes. */
+	int offs;		/**< Offset (mid level) in DACC codes. */
+};
+
+/**
+ * @struct dds
+ *
+ * @brief DDS generator state.
+ */
+struct dds {
+	unsigned int fs;	/**< Set by caller: Sample rate in Hz (DACC trigger rate per channel). */
+	int chn;		/**< Set by caller: DACC channel (0, 1 on SAM3S/SAM4S). */
+	uint32_t ph;
+	uint32_t ph_add;
+	struct dds_par cur;
+	struct dds_par nxt;
+	unsigned int upd;
+};
+
+/**
+ * @brief Initialize generator: zero frequency, zero amplitude at mid level.
+ *
+ * @param d Generator.
+ */
+void dds_init(struct dds *d);
+
+/**
+ * @brief Set frequency (stops a running sweep).
+ *
+ * @param d     Generator.
+ * @param f_mhz Frequency in mHz (< fs / 2).
+ */
+void dds_set_freq(struct dds *d, unsigned int f_mhz);
+
+/**
+ * @brief Start a linear frequency sweep.
+ *
+ * The frequency moves from f0_mhz to f1_mhz in n samples and then stays at
+ * f1_mhz.
+ *
+ * @param d      Generator.
+ * @param f0_mhz Start frequency in mHz.
+ * @param f1_mhz End frequency in mHz.
+ * @param n      Sweep length in samples (>= 1).
+ */
+void dds_set_sweep(struct dds *d, unsigned int f0_mhz, unsigned int f1_mhz, int n);
+
+/**
+ * @brief Set amplitude and offset.
+ *
+ * Output codes are clamped to the DACC range.
+ *
+ * @param d    Generator.
+ * @param amp  Amplitude in DACC codes.
+ * @param offs Mid level in DACC codes.
+ */
+void dds_set_amp(struct dds *d, int amp, int offs);
+
+/**
+ * @brief Shift phase.
+ *
+ * @param d  Generator.
+ * @param ph Phase shift (2^32 == one period).
+ */
+void dds_set_phase(struct dds *d, uint32_t ph);
+
+/**
+ * @brief Generate a block of samples.
+ *
+ * Pending parameters are latched first. With stride 2 every second sample of
+ * an interleaved two channel buffer is written.
+ *
+ * @param d      Generator.
+ * @param out    Samples in DACC_STRM_SMP() format.
+ * @param cnt    Number of samples to generate.
+ * @param stride Distance of samples in out (1 or 2).
+ */
+void dds_run(struct dds *d, uint16_t *out, int cnt, int stride);
+
+#if TERMOUT == 1
+/**
+ * @brief Measure generator speed with the DWT cycle counter (terminal output).
+ *
+ * Logs cycles per sample of a constant frequency and of a sweep block and the
+ * sample rate sustainable at 100 % CPU load (F_MCK / cycles per sample).
+ *
+ * @param buf Sample buffer (32-bit aligned), content is overwritten.
+ * @param cnt Number of samples (even).
+ */
+void log_dds_bench(uint16_t *buf, int cnt);
+#endif
+
+#endif
+
+#endif
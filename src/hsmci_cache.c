@@ -0,0 +1,510 @@
+/*
+ * hsmci_cache.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "hsmci_sd.h"
+#include "hsmci_que.h"
+#include "hsmci_cache.h"
+#include <string.h>
+
+#if HSMCI_CACHE == 1
+
+#if HSMCI_SD != 1
+ #error "HSMCI_CACHE requires HSMCI_SD"
+#endif
+
+#if HSMCI_CACHE_SLEEP == 1
+#include "sleep.h"
+#endif
+
+_Static_assert(HSMCI_CACHE_RA_BLK >= 0 && HSMCI_CACHE_RA_BLK < HSMCI_CACHE_SLOTS,
+               "HSMCI_CACHE_RA_BLK must be less than HSMCI_CACHE_SLOTS");
+
+#define BLOCK_SIZE 512
+#define MAX_DIRECT_BLK 511
+#define REQ_PEND 1
+
+struct slot {
+	size_t lba;
+	unsigned int tm;
+	boolean_t vld;
+	boolean_t dirty;
+};
+
+static SemaphoreHandle_t mtx;
+static struct slot slots[HSMCI_CACHE_SLOTS];
+static uint32_t data[HSMCI_CACHE_SLOTS][BLOCK_SIZE / 4];
+static unsigned int tick;
+static size_t seq_lba;
+static struct hsmci_cache_stats stats;
+#if HSMCI_QUE == 1
+static struct hsmci_req rq[HSMCI_CACHE_SLOTS];
+#endif
+
+static int find(size_t lba);
+static int uncached_run(size_t lba, int max);
+static int alloc(int *idx);
+static int fill(size_t lba, int n, int *first);
+static int flush(void);
+static int rd_slots(const int *idx, int n);
+static int wr_slots(const int *idx, int n);
+static int rd_direct(size_t lba, int n, void *buf);
+static int wr_direct(size_t lba, int n, const void *buf);
+#if HSMCI_QUE == 1
+static int que_slots(boolean_t wr, const int *idx, int n);
+#endif
+#if HSMCI_CACHE_SLEEP == 1
+static void sleep_clbk(enum sleep_cmd cmd, ...);
+#endif
+
+/**
+ * init_hsmci_cache
+ */
+void init_hsmci_cache(void)
+{
+	if (mtx != NULL) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (NULL == (mtx = xSemaphoreCreateMutex())) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	memset(slots, 0, sizeof(slots));
+#if HSMCI_CACHE_SLEEP == 1
+	reg_sleep_clbk(sleep_clbk, SLEEP_PRIO_SUSP_FIRST);
+#endif
+}
+
+/**
+ * hsmci_cache_read
+ */
+int hsmci_cache_read(size_t lba, int block_cnt, void *buf)
+{
+	uint8_t *p = buf;
+	int i, n, idx, ret = 0;
+
+	if (block_cnt < 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	xSemaphoreTake(mtx, portMAX_DELAY);
+	for (i = 0; i < block_cnt; i += n) {
+		if ((idx = find(lba + i)) != -1) {
+			slots[idx].tm = ++tick;
+			memcpy(p + i * BLOCK_SIZE, data[idx], BLOCK_SIZE);
+			stats.hit++;
+			n = 1;
+			continue;
+		}
+		n = uncached_run(lba + i, block_cnt - i);
+		stats.miss += n;
+		if (n > 1) {
+			stats.bypass += n;
+			if ((ret = rd_direct(lba + i, n, p + i * BLOCK_SIZE))) {
+				break;
+			}
+		} else {
+			if ((ret = fill(lba + i, (lba + i == seq_lba) ? 1 + HSMCI_CACHE_RA_BLK : 1, &idx))) {
+				break;
+			}
+			memcpy(p + i * BLOCK_SIZE, data[idx], BLOCK_SIZE);
+		}
+	}
+	seq_lba = (ret) ? 0 : lba + block_cnt;
+	xSemaphoreGive(mtx);
+	return (ret);
+}
+
+/**
+ * hsmci_cache_write
+ */
+int hsmci_cache_write(size_t lba, int block_cnt, const void *buf)
+{
+	const uint8_t *p = buf;
+	int i, n, idx, ret = 0;
+
+	if (block_cnt < 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	xSemaphoreTake(mtx, portMAX_DELAY);
+	for (i = 0; i < block_cnt; i += n) {
+		n = 1;
+		if ((idx = find(lba + i)) != -1) {
+			stats.hit++;
+		} else {
+			n = uncached_run(lba + i, block_cnt - i);
+			stats.miss += n;
+			if (n > 1) {
+				stats.bypass += n;
+				if ((ret = wr_direct(lba + i, n, p + i * BLOCK_SIZE))) {
+					break;
+				}
+				continue;
+			}
+			// Whole block is overwritten, no need to read it first.
+			if ((ret = alloc(&idx))) {
+				break;
+			}
+			slots[idx].lba = lba + i;
+			slots[idx].vld = TRUE;
+		}
+		slots[idx].tm = ++tick;
+		memcpy(data[idx], p + i * BLOCK_SIZE, BLOCK_SIZE);
+		slots[idx].dirty = TRUE;
+	}
+	xSemaphoreGive(mtx);
+	return (ret);
+}
+
+/**
+ * hsmci_cache_flush
+ */
+int hsmci_cache_flush(void)
+{
+	int ret;
+
+	xSemaphoreTake(mtx, portMAX_DELAY);
+	ret = flush();
+	xSemaphoreGive(mtx);
+	return (ret);
+}
+
+/**
+ * hsmci_cache_inval
+ */
+void hsmci_cache_inval(void)
+{
+	xSemaphoreTake(mtx, portMAX_DELAY);
+	for (int i = 0; i < HSMCI_CACHE_SLOTS; i++) {
+		slots[i].vld = slots[i].dirty = FALSE;
+	}
+	seq_lba = 0;
+	xSemaphoreGive(mtx);
+}
+
+/**
+ * get_hsmci_cache_stats
+ */
+void get_hsmci_cache_stats(struct hsmci_cache_stats *st)
+{
+	xSemaphoreTake(mtx, portMAX_DELAY);
+	*st = stats;
+	xSemaphoreGive(mtx);
+}
+
+/**
+ * find
+ */
+static int find(size_t lba)
+{
+	for (int i = 0; i < HSMCI_CACHE_SLOTS; i++) {
+		if (slots[i].vld && slots[i].lba == lba) {
+			return (i);
+		}
+	}
+	return (-1);
+}
+
+/**
+ * uncached_run
+ *
+ * Number of consecutive uncached blocks starting at lba (1..max).
+ */
+static int uncached_run(size_t lba, int max)
+{
+	int n;
+
+	if (max > MAX_DIRECT_BLK) {
+		max = MAX_DIRECT_BLK;
+	}
+	for (n = 1; n < max && find(lba + n) == -1; n++) {
+		;
+	}
+	return (n);
+}
+
+/**
+ * alloc
+ *
+ * Take an invalid or the least recently used slot; a dirty victim is
+ * written to the card first.
+ */
+static int alloc(int *idx)
+{
+	int i, v = -1;
+	int ret;
+
+	for (i = 0; i < HSMCI_CACHE_SLOTS; i++) {
+		if (!slots[i].vld) {
+			v = i;
+			break;
+		}
+		if (v == -1 || (int) (slots[i].tm - slots[v].tm) < 0) {
+			v = i;
+		}
+	}
+	if (slots[v].vld) {
+		if (slots[v].dirty) {
+			if ((ret = wr_slots(&v, 1))) {
+				return (ret);
+			}
+			slots[v].dirty = FALSE;
+			stats.wb++;
+		}
+		slots[v].vld = FALSE;
+		stats.evict++;
+	}
+	slots[v].tm = ++tick;
+	*idx = v;
+	return (0);
+}
+
+/**
+ * fill
+ *
+ * Load block lba and up to n - 1 following uncached blocks (read-ahead) into
+ * slots with one read command. Returns slot of lba in first.
+ */
+static int fill(size_t lba, int n, int *first)
+{
+	int idx[1 + HSMCI_CACHE_RA_BLK];
+	int i, ret;
+
+	for (i = 1; i < n && find(lba + i) == -1; i++) {
+		;
+	}
+	n = i;
+	for (i = 0; i < n; i++) {
+		if ((ret = alloc(&idx[i]))) {
+			while (--i >= 0) {
+				slots[idx[i]].vld = FALSE;
+			}
+			return (ret);
+		}
+		// Mark valid so that following alloc() calls do not take it again.
+		slots[idx[i]].lba = lba + i;
+		slots[idx[i]].vld = TRUE;
+	}
+	if ((ret = rd_slots(idx, n))) {
+		for (i = 0; i < n; i++) {
+			slots[idx[i]].vld = FALSE;
+		}
+		return (ret);
+	}
+	stats.ra += n - 1;
+	*first = idx[0];
+	return (0);
+}
+
+/**
+ * flush
+ *
+ * Write dirty slots in LBA order, adjacent ones with one command.
+ */
+static int flush(void)
+{
+	int idx[HSMCI_CACHE_SLOTS];
+	int i, j, n, ret;
+
+	for (;;) {
+		idx[0] = -1;
+		for (i = 0; i < HSMCI_CACHE_SLOTS; i++) {
+			if (slots[i].vld && slots[i].dirty && (idx[0] == -1 || slots[i].lba < slots[idx[0]].lba)) {
+				idx[0] = i;
+			}
+		}
+		if (idx[0] == -1) {
+			return (0);
+		}
+		for (n = 1; n < HSMCI_CACHE_SLOTS; n++) {
+			if ((j = find(slots[idx[0]].lba + n)) == -1 || !slots[j].dirty) {
+				break;
+			}
+			idx[n] = j;
+		}
+		if ((ret = wr_slots(idx, n))) {
+			return (ret);
+		}
+		for (i = 0; i < n; i++) {
+			slots[idx[i]].dirty = FALSE;
+		}
+		stats.wb += n;
+	}
+}
+
+/**
+ * rd_slots
+ */
+static int rd_slots(const int *idx, int n)
+{
+#if HSMCI_QUE == 1
+	return (que_slots(FALSE, idx, n));
+#else
+	void *done;
+	int ret;
+
+	hsmci_lock();
+	if (n == 1) {
+		ret = hsmci_read_blocks(slots[idx[0]].lba, 1, data[idx[0]]);
+	} else if (!(ret = hsmci_stream_read_begin(slots[idx[0]].lba, data[idx[0]], 1))) {
+		for (int i = 1; i < n && !ret; i++) {
+			ret = hsmci_stream_read_next(data[idx[i]], 1, &done);
+		}
+		if (!ret) {
+			ret = hsmci_stream_read_end(&done);
+		}
+	}
+	hsmci_unlock();
+	return (ret);
+#endif
+}
+
+/**
+ * wr_slots
+ */
+static int wr_slots(const int *idx, int n)
+{
+#if HSMCI_QUE == 1
+	return (que_slots(TRUE, idx, n));
+#else
+	const void *done;
+	int ret;
+
+	hsmci_lock();
+	if (n == 1) {
+		ret = hsmci_write_blocks(slots[idx[0]].lba, 1, data[idx[0]]);
+	} else if (!(ret = hsmci_stream_write_begin(slots[idx[0]].lba, data[idx[0]], 1))) {
+		for (int i = 1; i < n && !ret; i++) {
+			ret = hsmci_stream_write_next(data[idx[i]], 1, &done);
+		}
+		if (!ret) {
+			ret = hsmci_stream_write_end();
+		}
+	}
+	hsmci_unlock();
+	return (ret);
+#endif
+}
+
+/**
+ * rd_direct
+ */
+static int rd_direct(size_t lba, int n, void *buf)
+{
+#if HSMCI_QUE == 1
+	return (hsmci_que_read(lba, n, buf));
+#else
+	int ret;
+
+	hsmci_lock();
+	ret = hsmci_read_blocks(lba, n, buf);
+	hsmci_unlock();
+	return (ret);
+#endif
+}
+
+/**
+ * wr_direct
+ */
+static int wr_direct(size_t lba, int n, const void *buf)
+{
+#if HSMCI_QUE == 1
+	return (hsmci_que_write(lba, n, buf));
+#else
+	int ret;
+
+	hsmci_lock();
+	ret = hsmci_write_blocks(lba, n, buf);
+	hsmci_unlock();
+	return (ret);
+#endif
+}
+
+#if HSMCI_QUE == 1
+/**
+ * que_slots
+ *
+ * Queue one request per slot (adjacent LBAs) and wait for all of them. The
+ * requests are submitted with the scheduler suspended, so the queue task
+ * merges them into one command.
+ */
+static int que_slots(boolean_t wr, const int *idx, int n)
+{
+	int i, ret = 0;
+
+	vTaskSuspendAll();
+	for (i = 0; i < n; i++) {
+		rq[i].wr = wr;
+		rq[i].lba = slots[idx[i]].lba;
+		rq[i].block_cnt = 1;
+		rq[i].buf = data[idx[i]];
+		rq[i].clbk = NULL;
+		rq[i].tsk = xTaskGetCurrentTaskHandle();
+		rq[i].ret = REQ_PEND;
+		hsmci_submit(&rq[i]);
+	}
+	xTaskResumeAll();
+	for (i = 0; i < n; i++) {
+		while (*(volatile int *) &rq[i].ret == REQ_PEND) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		}
+		if (rq[i].ret) {
+			ret = rq[i].ret;
+		}
+	}
+	return (ret);
+}
+#endif
+
+#if HSMCI_CACHE_SLEEP == 1
+/**
+ * sleep_clbk
+ */
+static void sleep_clbk(enum sleep_cmd cmd, ...)
+{
+	if (cmd == SLEEP_CMD_SUSP) {
+		hsmci_cache_flush();
+	}
+}
+#endif
+
+#if TERMOUT == 1
+/**
+ * log_hsmci_cache_stats
+ */
+void log_hsmci_cache_stats(void)
+{
+	struct hsmci_cache_stats st;
+
+	get_hsmci_cache_stats(&st);
+	msg(INF, "hsmci_cache: hit=%u miss=%u evict=%u wb=%u ra=%u bypass=%u\n", st.hit, st.miss,
+	    st.evict, st.wb, st.ra, st.bypass);
+}
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * hsmci_cache.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file hsmci_cache.h
+ *
+ * @brief Write-back block cache above hsmci_read_blocks()/hsmci_write_blocks().
+ *
+ * Filesystems read and rewrite the same FAT/directory sectors repeatedly; the
+ * cache keeps HSMCI_CACHE_SLOTS blocks in RAM so that these accesses do not
+ * become separate CMD17/CMD24 commands.
+ *
+ * Key characteristics:
+ * - Fixed-size slots (one 512 B block each) with LRU replacement.
+ * - Write-back: written blocks are only marked dirty and reach the card on
+ *   eviction, hsmci_cache_flush() or (HSMCI_CACHE_SLEEP == 1) before sleep.
+ *   Flush writes adjacent dirty blocks with one CMD25.
+ * - Runs of two or more uncached blocks in one call bypass the cache and are
+ *   transferred directly with one multi-block command, so bulk transfers do
+ *   not evict the metadata working set.
+ * - Sequential read-ahead: a single-block miss at the block following the
+ *   previous read loads HSMCI_CACHE_RA_BLK further blocks with the same CMD18.
+ * - Card access runs under hsmci_lock(), shared with the other users of the
+ *   card. With HSMCI_QUE == 1, misses, write-backs and bypass transfers go
+ *   through the hsmci_que queue instead, in order with the other queued
+ *   requests. Read-ahead and flush runs are queued together, one request
+ *   per slot, and the queue merges them into one command. Cached blocks must
+ *   not be written around the cache. Calls are serialized by an internal
+ *   mutex.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when HSMCI_CACHE == 1.
+ *   Requires HSMCI_SD == 1 (and SLEEP_FEAT == 1 if HSMCI_CACHE_SLEEP == 1).
+ */
+
+#ifndef HSMCI_CACHE_H
+#define HSMCI_CACHE_H
+
+#ifndef HSMCI_CACHE
+ #define HSMCI_CACHE 0
+#endif
+
+#ifndef HSMCI_CACHE_SLOTS
+ #define HSMCI_CACHE_SLOTS 8
+#endif
+
+#ifndef HSMCI_CACHE_RA_BLK
+ #define HSMCI_CACHE_RA_BLK 2
+#endif
+
+#ifndef HSMCI_CACHE_SLEEP
+ #define HSMCI_CACHE_SLEEP 0
+#endif
+
+#if HSMCI_CACHE == 1
+
+/**
+ * @struct hsmci_cache_stats
+ *
+ * @brief Cache counters (in blocks).
+ */
+struct hsmci_cache_stats {
+	unsigned int hit;	/**< Blocks served from the cache (read and write). */
+	unsigned int miss;	/**< Blocks not found in the cache (read and write). */
+	unsigned int evict;	/**< Valid slots replaced. */
+	unsigned int wb;	/**< Dirty blocks written to the card. */
+	unsigned int ra;	/**< Blocks loaded by read-ahead. */
+	unsigned int bypass;	/**< Blocks transferred directly (multi-block runs). */
+};
+
+/**
+ * @brief Initialize the cache (empty).
+ *
+ * Call after init_hsmci() (and init_hsmci_que() if HSMCI_QUE == 1); registers
+ * the sleep callback if HSMCI_CACHE_SLEEP == 1.
+ */
+void init_hsmci_cache(void);
+
+/**
+ * @brief Read blocks through the cache.
+ *
+ * @param lba       Logical block address (512 B units).
+ * @param block_cnt Number of 512 B blocks.
+ * @param buf       Destination buffer (PDC accessible, 32-bit aligned).
+ *
+ * @return 0 - success; -EHW on error.
+ */
+int hsmci_cache_read(size_t lba, int block_cnt, void *buf);
+
+/**
+ * @brief Write blocks through the cache.
+ *
+ * Cached blocks are updated in RAM and written later (write-back).
+ *
+ * @param lba       Logical block address (512 B units).
+ * @param block_cnt Number of 512 B blocks.
+ * @param buf       Source buffer (PDC accessible, 32-bit aligned).
+ *
+ * @return 0 - success; -EHW on error (a dirty victim could not be written
+ *         or a direct transfer failed).
+ */
+int hsmci_cache_write(size_t lba, int block_cnt, const void *buf);
+
+/**
+ * @brief Write all dirty blocks to the card.
+ *
+ * @return 0 - success; -EHW on error (failed blocks stay dirty).
+ */
+int hsmci_cache_flush(void);
+
+/**
+ * @brief Drop all cached blocks, including dirty ones (e.g. card removed).
+ */
+void hsmci_cache_inval(void);
+
+/**
+ * @brief Get cache counters.
+ *
+ * @param st Counters (return).
+ */
+void get_hsmci_cache_stats(struct hsmci_cache_stats *st);
+
+#if TERMOUT == 1
+/**
+ * @brief Log cache counters (terminal output), complements log_hsmci_stats().
+ */
+void log_hsmci_cache_stats(void);
+#endif
+
+#endif
+
+#endif
@@ -128,6 +128,8 @@
 #define SDMMC_CMD17_READ_SINGLE_BLOCK    (17 | SDMMC_CMD_R1 | SDMMC_CMD_SINGLE_BLOCK)
 /** Cmd18(adtc, R1): Read multiple block */
 #define SDMMC_CMD18_READ_MULTIPLE_BLOCK  (18 | SDMMC_CMD_R1 | SDMMC_CMD_MULTI_BLOCK)
+/** Cmd23(ac, R1): Set the block count of the following CMD18/CMD25 */
+#define SDMMC_CMD23_SET_BLOCK_COUNT      (23 | SDMMC_CMD_R1)
 
 /*
  * --- Block-oriented write commands (class 4) ---
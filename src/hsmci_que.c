@@ -0,0 +1,290 @@
+/*
+ * hsmci_que.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "hsmci_sd.h"
+#include "hsmci_que.h"
+
+#if HSMCI_QUE == 1
+
+#if HSMCI_SD != 1
+ #error "HSMCI_QUE requires HSMCI_SD"
+#endif
+
+#define MAX_BLK 511
+#define REQ_PEND 1
+
+static TaskHandle_t tsk_hndl;
+static const char *const tsk_nm = "HSMCIQ";
+static struct hsmci_req *rq_head;
+static struct hsmci_req *rq_tail;
+static unsigned int rq_depth;
+static struct hsmci_que_stats stats;
+
+static void que_tsk(void *p);
+static struct hsmci_req *take_run(void);
+static void exec_run(struct hsmci_req *run);
+static int rd_run(struct hsmci_req *run);
+static int wr_run(struct hsmci_req *run);
+static int sync_req(boolean_t wr, size_t lba, int block_cnt, void *buf);
+
+/**
+ * init_hsmci_que
+ */
+void init_hsmci_que(void)
+{
+	if (tsk_hndl != NULL) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (pdPASS != xTaskCreate(que_tsk, tsk_nm, HSMCI_QUE_TASK_STACK_SIZE, NULL,
+                                  HSMCI_QUE_TASK_PRIO, &tsk_hndl)) {
+                crit_err_exit(MALLOC_ERROR);
+        }
+}
+
+/**
+ * hsmci_submit
+ */
+void hsmci_submit(struct hsmci_req *req)
+{
+	if (req->block_cnt < 1 || req->block_cnt > MAX_BLK || req->buf == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (tsk_hndl == NULL) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	req->next = NULL;
+	taskENTER_CRITICAL();
+	if (rq_tail != NULL) {
+		rq_tail->next = req;
+	} else {
+		rq_head = req;
+	}
+	rq_tail = req;
+	if (++rq_depth > stats.depth_max) {
+		stats.depth_max = rq_depth;
+	}
+	taskEXIT_CRITICAL();
+	xTaskNotifyGive(tsk_hndl);
+}
+
+/**
+ * hsmci_que_read
+ */
+int hsmci_que_read(size_t lba, int block_cnt, void *buf)
+{
+	return (sync_req(FALSE, lba, block_cnt, buf));
+}
+
+/**
+ * hsmci_que_write
+ */
+int hsmci_que_write(size_t lba, int block_cnt, const void *buf)
+{
+	return (sync_req(TRUE, lba, block_cnt, (void *) (uintptr_t) buf));
+}
+
+/**
+ * get_hsmci_que_stats
+ */
+void get_hsmci_que_stats(struct hsmci_que_stats *st)
+{
+	taskENTER_CRITICAL();
+	*st = stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * sync_req
+ */
+static int sync_req(boolean_t wr, size_t lba, int block_cnt, void *buf)
+{
+	struct hsmci_req req;
+
+	req.wr = wr;
+	req.lba = lba;
+	req.block_cnt = block_cnt;
+	req.buf = buf;
+	req.clbk = NULL;
+	req.tsk = xTaskGetCurrentTaskHandle();
+	req.ret = REQ_PEND;
+	hsmci_submit(&req);
+	// Tolerate a stale notification of the calling task.
+	do {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	} while (*(volatile int *) &req.ret == REQ_PEND);
+	return (req.ret);
+}
+
+/**
+ * que_tsk
+ */
+static void que_tsk(void *p)
+{
+	struct hsmci_req *run;
+
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while ((run = take_run()) != NULL) {
+			exec_run(run);
+		}
+	}
+}
+
+/**
+ * take_run
+ *
+ * Detach the queue head together with following requests of the same
+ * direction continuing at the next LBA.
+ */
+static struct hsmci_req *take_run(void)
+{
+	struct hsmci_req *run, *last;
+
+	taskENTER_CRITICAL();
+	if ((run = rq_head) != NULL) {
+		last = run;
+		rq_depth--;
+		while (last->next != NULL && last->next->wr == run->wr &&
+		       last->next->lba == last->lba + last->block_cnt) {
+			last = last->next;
+			rq_depth--;
+		}
+		rq_head = last->next;
+		if (rq_head == NULL) {
+			rq_tail = NULL;
+		}
+		last->next = NULL;
+	}
+	taskEXIT_CRITICAL();
+	return (run);
+}
+
+/**
+ * exec_run
+ */
+static void exec_run(struct hsmci_req *run)
+{
+	struct hsmci_req *req;
+	void (*clbk)(struct hsmci_req *req);
+	TaskHandle_t tsk;
+	boolean_t first = TRUE;
+	int ret;
+
+	hsmci_lock();
+	if (run->next == NULL) {
+		if (run->wr) {
+			ret = hsmci_write_blocks(run->lba, run->block_cnt, run->buf);
+		} else {
+			ret = hsmci_read_blocks(run->lba, run->block_cnt, run->buf);
+		}
+	} else {
+		ret = (run->wr) ? wr_run(run) : rd_run(run);
+	}
+	hsmci_unlock();
+	stats.cmd++;
+	if (ret) {
+		stats.err++;
+	}
+	while (run != NULL) {
+		req = run;
+		// Request may be reused by its owner as soon as it is signaled.
+		run = run->next;
+		stats.req++;
+		if (!first) {
+			stats.mrg++;
+		}
+		first = FALSE;
+		// A waiter may return (and drop a stack request) as soon as ret
+		// is set, so nothing is read from req after that.
+		clbk = req->clbk;
+		tsk = req->tsk;
+		req->ret = ret;
+		if (clbk != NULL) {
+			(*clbk)(req);
+		} else if (tsk != NULL) {
+			xTaskNotifyGive(tsk);
+		}
+	}
+}
+
+/**
+ * rd_run
+ */
+static int rd_run(struct hsmci_req *run)
+{
+	void *done;
+	int ret;
+
+	if ((ret = hsmci_stream_read_begin(run->lba, run->buf, run->block_cnt))) {
+		return (ret);
+	}
+	for (run = run->next; run != NULL; run = run->next) {
+		if ((ret = hsmci_stream_read_next(run->buf, run->block_cnt, &done))) {
+			return (ret);
+		}
+	}
+	return (hsmci_stream_read_end(&done));
+}
+
+/**
+ * wr_run
+ */
+static int wr_run(struct hsmci_req *run)
+{
+	const void *done;
+	int ret;
+
+	if ((ret = hsmci_stream_write_begin(run->lba, run->buf, run->block_cnt))) {
+		return (ret);
+	}
+	for (run = run->next; run != NULL; run = run->next) {
+		if ((ret = hsmci_stream_write_next(run->buf, run->block_cnt, &done))) {
+			return (ret);
+		}
+	}
+	return (hsmci_stream_write_end());
+}
+
+#if TERMOUT == 1
+/**
+ * log_hsmci_que_stats
+ */
+void log_hsmci_que_stats(void)
+{
+	struct hsmci_que_stats st;
+
+	get_hsmci_que_stats(&st);
+	msg(INF, "hsmci_que.c: req=%u cmd=%u mrg=%u err=%u depth_max=%u\n", st.req, st.cmd, st.mrg,
+	    st.err, st.depth_max);
+}
+#endif
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * hsmci_que.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file hsmci_que.h
+ *
+ * @brief Asynchronous queued block I/O on top of the HSMCI SD-card driver.
+ *
+ * Callers submit read/write requests with hsmci_submit() and continue
+ * immediately; a driver task executes the requests in submission order using
+ * the blocking hsmci_*() API and signals completion by a callback or a task
+ * notification. A producer therefore keeps running while earlier writes are
+ * transferred or wait in the card's busy (programming) phase.
+ *
+ * Key characteristics:
+ * - Merging: consecutive queued requests of the same direction with adjacent
+ *   LBAs are executed as one CMD18/CMD25 (hsmci_stream_*() API) with the PDC
+ *   switching between the request buffers. The merged requests complete
+ *   together with the status of the whole command.
+ * - The queue task holds hsmci_lock() for each command, so other users of
+ *   the card (hsmci_cache, sd_log, sd_erase) run between queued commands.
+ *   Completion callbacks run outside the lock.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when HSMCI_QUE == 1. Requires
+ *   HSMCI_SD == 1.
+ * - HSMCI_QUE_TASK_STACK_SIZE and HSMCI_QUE_TASK_PRIO must be defined in sysconf.h.
+ */
+
+#ifndef HSMCI_QUE_H
+#define HSMCI_QUE_H
+
+#ifndef HSMCI_QUE
+ #define HSMCI_QUE 0
+#endif
+
+#if HSMCI_QUE == 1
+
+/**
+ * @struct hsmci_req
+ *
+ * @brief Block read/write request for hsmci_submit().
+ *
+ * The request and its buffer are owned by the driver from hsmci_submit() until
+ * completion is signaled.
+ */
+struct hsmci_req {
+	boolean_t wr;		/**< Set by caller: TRUE -> write, FALSE -> read. */
+	size_t lba;		/**< Set by caller: Logical block address (512 B units). */
+	int block_cnt;		/**< Set by caller: Number of 512 B blocks (1..511). */
+	void *buf;		/**< Set by caller: Data buffer (PDC accessible, 32-bit aligned). */
+	/** Set by caller: Completion callback (queue task context), or NULL. */
+	void (*clbk)(struct hsmci_req *req);
+	TaskHandle_t tsk;	/**< Set by caller: Task notified (xTaskNotifyGive) if clbk == NULL, or NULL. */
+	void *arg;		/**< Set by caller: Caller context for clbk. */
+	int ret;		/**< Request status (return): 0 - success; -EHW on error. */
+	struct hsmci_req *next;
+};
+
+/**
+ * @struct hsmci_que_stats
+ *
+ * @brief Queue counters.
+ */
+struct hsmci_que_stats {
+	unsigned int req;	/**< Completed requests. */
+	unsigned int cmd;	/**< Executed read/write commands. */
+	unsigned int mrg;	/**< Requests merged into the command of a preceding request. */
+	unsigned int err;	/**< Failed commands. */
+	unsigned int depth_max;	/**< Maximal number of pending requests. */
+};
+
+/**
+ * @brief Create the queue task.
+ *
+ * Call after init_hsmci() and card initialization.
+ */
+void init_hsmci_que(void);
+
+/**
+ * @brief Queue a request (non-blocking).
+ *
+ * @param req Request descriptor.
+ */
+void hsmci_submit(struct hsmci_req *req);
+
+/**
+ * @brief Read blocks through the queue and wait for completion.
+ *
+ * Uses the task notification of the calling task.
+ *
+ * @param lba       Logical block address (512 B units).
+ * @param block_cnt Number of 512 B blocks (1..511).
+ * @param buf       Destination buffer.
+ *
+ * @return 0 - success; -EHW on error.
+ */
+int hsmci_que_read(size_t lba, int block_cnt, void *buf);
+
+/**
+ * @brief Write blocks through the queue and wait for completion.
+ *
+ * Uses the task notification of the calling task.
+ *
+ * @param lba       Logical block address (512 B units).
+ * @param block_cnt Number of 512 B blocks (1..511).
+ * @param buf       Source buffer.
+ *
+ * @return 0 - success; -EHW on error.
+ */
+int hsmci_que_write(size_t lba, int block_cnt, const void *buf);
+
+/**
+ * @brief Get queue counters.
+ *
+ * @param st Counters (return).
+ */
+void get_hsmci_que_stats(struct hsmci_que_stats *st);
+
+#if TERMOUT == 1
+/**
+ * @brief Log queue counters (terminal output).
+ */
+void log_hsmci_que_stats(void);
+#endif
+
+#endif
+
+#endif
@@ -44,9 +44,31 @@ _Static_assert((HSMCI_SD_DLINE_NUM == 1) || (HSMCI_SD_DLINE_NUM == 4),
 #define SEND_CLOCK_TMO_MS 30
 #define HSMCI_BLOCK_SIZE 512
 #define HSMCI_400K_CLOCK 400000
+#define STRM_MAX_BLK ((0xFFFF * 4) / HSMCI_BLOCK_SIZE)
+#define CMD_ERR (HSMCI_SR_CSTOE | HSMCI_SR_RTOE | HSMCI_SR_RENDE | HSMCI_SR_RCRCE | HSMCI_SR_RDIRE | HSMCI_SR_RINDE)
+#define DATA_ERR (HSMCI_SR_UNRE | HSMCI_SR_OVRE | HSMCI_SR_DTOE | HSMCI_SR_DCRCE | CMD_ERR)
+
+enum strm_state {
+	STRM_IDLE,
+	STRM_READ,
+	STRM_WRITE
+};
+
+static struct {
+	enum strm_state st;
+	uint32_t cur;
+	int cur_cnt;
+	uint32_t nxt;
+	int nxt_cnt;
+} strm;
 
 static QueueHandle_t sr_que;
+static SemaphoreHandle_t io_mtx;
 static unsigned int r1b_busy_tmo = R1B_BUSY_TMO_MS;
+static unsigned int adr_shift;
+static unsigned int wr_rca;
+static unsigned int wr_opt;
+static TickType_t io_tck;
 
 static unsigned int stat_spurious_int_cnt;
 static unsigned int stat_sr_unre_cnt;
@@ -72,9 +94,19 @@ static unsigned int stat_wr_n_notbusy_cnt;
 static unsigned int stat_wr_n_blke_cnt;
 static unsigned int stat_rx_blk_cnt;
 static unsigned int stat_tx_blk_cnt;
+static unsigned int stat_pre_erase_cnt;
+static unsigned int stat_set_blk_cnt;
+static unsigned int stat_strm_cnt;
+static unsigned int stat_strm_stall_cnt;
+static unsigned int stat_strm_err_cnt;
 
 static void reset_hsmci(void);
 static void sr_err_cnt(unsigned int sr);
+static int send_cmd(unsigned int cmd, unsigned int arg, hsmci_resp_t *resp, unsigned int trcmd);
+static int pre_write(int block_cnt);
+static int strm_wait(unsigned int ier, unsigned int flg, unsigned int *sr);
+static int strm_stop(void);
+static void strm_abort(void);
 
 /**
  * init_hsmci
@@ -89,6 +121,9 @@ void init_hsmci(void)
 	} else {
 		crit_err_exit(UNEXP_PROG_STATE);
 	}
+	if (NULL == (io_mtx = xSemaphoreCreateMutex())) {
+		crit_err_exit(MALLOC_ERROR);
+	}
 	NVIC_DisableIRQ(HSMCI_IRQn);
 	enable_periph_clk(ID_HSMCI);
 	HSMCI->HSMCI_CR = HSMCI_CR_SWRST;
@@ -229,17 +264,66 @@ void hsmci_set_next_r1b_busy_tmo_ms(unsigned int tmo_ms)
 	r1b_busy_tmo = tmo_ms;
 }
 
+/**
+ * hsmci_set_byte_addressing
+ */
+void hsmci_set_byte_addressing(boolean_t on)
+{
+	adr_shift = (on) ? 9 : 0;
+}
+
+/**
+ * hsmci_set_write_opt
+ */
+void hsmci_set_write_opt(unsigned int rca, unsigned int opt)
+{
+	wr_rca = rca;
+	wr_opt = opt;
+}
+
+/**
+ * hsmci_get_io_tick
+ */
+TickType_t hsmci_get_io_tick(void)
+{
+	return (io_tck);
+}
+
+/**
+ * hsmci_lock
+ */
+void hsmci_lock(void)
+{
+	xSemaphoreTake(io_mtx, portMAX_DELAY);
+}
+
+/**
+ * hsmci_unlock
+ */
+void hsmci_unlock(void)
+{
+	xSemaphoreGive(io_mtx);
+}
+
 /**
  * hsmci_send_cmd
  */
 int hsmci_send_cmd(unsigned int cmd, unsigned int arg, hsmci_resp_t *resp)
+{
+	return (send_cmd(cmd, arg, resp, 0));
+}
+
+/**
+ * send_cmd
+ */
+static int send_cmd(unsigned int cmd, unsigned int arg, hsmci_resp_t *resp, unsigned int trcmd)
 {
 	unsigned int cmdr;
 	unsigned int sr;
 
 	HSMCI->HSMCI_MR &= ~(HSMCI_MR_PDCMODE | HSMCI_MR_WRPROOF | HSMCI_MR_RDPROOF);
 	unsigned int cmd_idx = SDMMC_CMD_GET_INDEX(cmd);
-	cmdr = HSMCI_CMDR_SPCMD_STD | HSMCI_CMDR_CMDNB(cmd_idx);
+	cmdr = HSMCI_CMDR_SPCMD_STD | HSMCI_CMDR_CMDNB(cmd_idx) | trcmd;
 	if (cmd & SDMMC_RESP_PRESENT) {
 		cmdr |= HSMCI_CMDR_MAXLAT;
 		if (cmd & SDMMC_RESP_136) {
@@ -336,6 +420,7 @@ int hsmci_send_data_cmd(unsigned int cmd, unsigned int arg, void *buf, size_t le
 	if (cmd & SDMMC_CMD_MULTI_BLOCK) {
 		crit_err_exit(BAD_PARAMETER);
 	}
+	io_tck = xTaskGetTickCount();
 	nb_words = len / 4;
 	HSMCI->HSMCI_MR |= HSMCI_MR_PDCMODE | HSMCI_MR_RDPROOF | HSMCI_MR_WRPROOF;
 	cmd_idx = SDMMC_CMD_GET_INDEX(cmd);
@@ -428,6 +513,7 @@ int hsmci_read_blocks(size_t lba, int block_cnt, void *buf)
 			crit_err_exit(BAD_PARAMETER);
 		}
 	}
+	io_tck = xTaskGetTickCount();
 	nb_data = block_cnt * HSMCI_BLOCK_SIZE;
 	if (block_cnt == 1) {
 		cmdr = HSMCI_CMDR_TRTYP_SINGLE | HSMCI_CMDR_CMDNB(SDMMC_CMD_GET_INDEX(SDMMC_CMD17_READ_SINGLE_BLOCK));
@@ -440,7 +526,7 @@ int hsmci_read_blocks(size_t lba, int block_cnt, void *buf)
 	HSMCI->HSMCI_RPR = (uint32_t) buf;
 	HSMCI->HSMCI_RCR = nb_data / 4;
 	HSMCI->HSMCI_RNCR = 0;
-	HSMCI->HSMCI_ARGR = lba;
+	HSMCI->HSMCI_ARGR = lba << adr_shift;
 	taskENTER_CRITICAL();
 	HSMCI->HSMCI_PTCR = HSMCI_PTCR_RXTEN;
 	HSMCI->HSMCI_CMDR = cmdr;
@@ -501,6 +587,7 @@ int hsmci_write_blocks(size_t lba, int block_cnt, const void *buf)
 	unsigned int nb_data;
 	hsmci_resp_t resp;
 	unsigned int ier;
+	boolean_t auto_stop;
 	int ret = 0;
 
 	if (block_cnt < 1) {
@@ -510,19 +597,25 @@ int hsmci_write_blocks(size_t lba, int block_cnt, const void *buf)
 			crit_err_exit(BAD_PARAMETER);
 		}
 	}
+	io_tck = xTaskGetTickCount();
 	nb_data = block_cnt * HSMCI_BLOCK_SIZE;
 	if (block_cnt == 1) {
 		cmdr = HSMCI_CMDR_TRTYP_SINGLE | HSMCI_CMDR_CMDNB(SDMMC_CMD_GET_INDEX(SDMMC_CMD24_WRITE_BLOCK));
 	} else {
+		if ((ret = pre_write(block_cnt))) {
+			return (ret);
+		}
 		cmdr = HSMCI_CMDR_TRTYP_MULTIPLE | HSMCI_CMDR_CMDNB(SDMMC_CMD_GET_INDEX(SDMMC_CMD25_WRITE_MULTIPLE_BLOCK));
 	}
+	// CMD23 makes the card leave the receive state after block_cnt blocks.
+	auto_stop = block_cnt == 1 || (wr_opt & HSMCI_WR_OPT_BLK_CNT);
 	cmdr |= HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_MAXLAT | HSMCI_CMDR_RSPTYP_48_BIT;
 	HSMCI->HSMCI_MR |= HSMCI_MR_PDCMODE | HSMCI_MR_RDPROOF | HSMCI_MR_WRPROOF;
 	HSMCI->HSMCI_BLKR = HSMCI_BLKR_BLKLEN(HSMCI_BLOCK_SIZE) | HSMCI_BLKR_BCNT(block_cnt);
 	HSMCI->HSMCI_TPR  = (uint32_t) buf;
 	HSMCI->HSMCI_TCR  = nb_data / 4;
 	HSMCI->HSMCI_TNCR = 0;
-	HSMCI->HSMCI_ARGR = lba;
+	HSMCI->HSMCI_ARGR = lba << adr_shift;
 	taskENTER_CRITICAL();
 	HSMCI->HSMCI_CMDR = cmdr;
 	HSMCI->HSMCI_IER = HSMCI_IER_CSTOE | HSMCI_IER_RTOE | HSMCI_IER_RENDE | HSMCI_IER_RCRCE | HSMCI_IER_RDIRE | HSMCI_IER_RINDE |
@@ -551,10 +644,11 @@ int hsmci_write_blocks(size_t lba, int block_cnt, const void *buf)
 	}
 	ier = HSMCI_IER_UNRE | HSMCI_IER_OVRE | HSMCI_IER_CSTOE | HSMCI_IER_DTOE | HSMCI_IER_DCRCE | HSMCI_IER_RTOE |
 	      HSMCI_IER_RENDE | HSMCI_IER_RCRCE | HSMCI_IER_RDIRE | HSMCI_IER_RINDE;
-	if (block_cnt == 1) {
+	// BLKE is set for each block, XFRDONE once the last block (BCNT) is done.
+	if (auto_stop) {
 		ier |= HSMCI_IER_NOTBUSY;
 	} else {
-		ier |= HSMCI_IER_BLKE;
+		ier |= HSMCI_IER_XFRDONE;
 	}
 	taskENTER_CRITICAL();
 	HSMCI->HSMCI_PTCR = HSMCI_PTCR_TXTEN;
@@ -573,16 +667,16 @@ int hsmci_write_blocks(size_t lba, int block_cnt, const void *buf)
 		sr_err_cnt(sr);
 		return (-EHW);
 	}
-	if (block_cnt == 1) {
+	if (auto_stop) {
 		if (!(sr & HSMCI_SR_NOTBUSY)) {
 			reset_hsmci();
 			stat_wr_n_notbusy_cnt++;
 			return (-EHW);
 		}
 	} else {
-		if (!(sr & HSMCI_SR_BLKE)) {
+		if (!(sr & HSMCI_SR_XFRDONE)) {
 			reset_hsmci();
-			stat_wr_n_blke_cnt++;
+			stat_no_xfr_done_cnt++;
 			return (-EHW);
 		}
 	}
@@ -592,17 +686,346 @@ int hsmci_write_blocks(size_t lba, int block_cnt, const void *buf)
 		return (-EHW);
 	}
 	HSMCI->HSMCI_MR &= ~(HSMCI_MR_PDCMODE | HSMCI_MR_WRPROOF | HSMCI_MR_RDPROOF);
-	if (block_cnt > 1) {
+	if (!auto_stop) {
 		if ((ret = hsmci_send_cmd(SDMMC_CMD12_STOP_TRANSMISSION, 0, &resp))) {
 			return (ret);
 		}
+	} else if (wr_rca) {
+		// No CMD12 response, programming errors are reported by CMD13.
+		if ((ret = hsmci_send_cmd(SDMMC_MCI_CMD13_SEND_STATUS, wr_rca << 16, &resp))) {
+			return (ret);
+		}
+	} else {
+		resp.r1 = 0;
+	}
+	if (resp.r1 & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_COM_CRC_ERROR)) {
+		stat_wr_err_cnt++;
+		return (-EHW);
+	}
+	stat_tx_blk_cnt += block_cnt;
+	return (ret);
+}
+
+/**
+ * pre_write
+ *
+ * ACMD23 (pre-erase) and CMD23 (block count) ahead of CMD25.
+ */
+static int pre_write(int block_cnt)
+{
+	hsmci_resp_t resp;
+	int ret;
+
+	if ((wr_opt & HSMCI_WR_OPT_PRE_ERASE) && block_cnt >= HSMCI_PRE_ERASE_MIN_BLK) {
+		if ((ret = hsmci_send_cmd(SDMMC_CMD55_APP_CMD, wr_rca << 16, &resp))) {
+			return (ret);
+		}
+		if ((ret = hsmci_send_cmd(SD_ACMD23_SET_WR_BLK_ERASE_COUNT, block_cnt, &resp))) {
+			return (ret);
+		}
 		if (resp.r1 & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_COM_CRC_ERROR)) {
 			stat_wr_err_cnt++;
 			return (-EHW);
 		}
+		stat_pre_erase_cnt++;
 	}
-	stat_tx_blk_cnt += block_cnt;
-	return (ret);
+	// CMD23 must immediately precede CMD25.
+	if (wr_opt & HSMCI_WR_OPT_BLK_CNT) {
+		if ((ret = hsmci_send_cmd(SDMMC_CMD23_SET_BLOCK_COUNT, block_cnt, &resp))) {
+			return (ret);
+		}
+		if (resp.r1 & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_COM_CRC_ERROR)) {
+			stat_wr_err_cnt++;
+			return (-EHW);
+		}
+		stat_set_blk_cnt++;
+	}
+	return (0);
+}
+
+/**
+ * hsmci_stream_read_begin
+ */
+int hsmci_stream_read_begin(size_t lba, void *buf, int block_cnt)
+{
+	unsigned int sr;
+	int ret;
+
+	if (strm.st != STRM_IDLE) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (block_cnt < 1 || block_cnt > STRM_MAX_BLK) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	io_tck = xTaskGetTickCount();
+	HSMCI->HSMCI_MR |= HSMCI_MR_PDCMODE | HSMCI_MR_RDPROOF | HSMCI_MR_WRPROOF;
+	// BCNT == 0 -> infinite block transfer, stopped by CMD12.
+	HSMCI->HSMCI_BLKR = HSMCI_BLKR_BLKLEN(HSMCI_BLOCK_SIZE) | HSMCI_BLKR_BCNT(0);
+	HSMCI->HSMCI_RPR = (uint32_t) buf;
+	HSMCI->HSMCI_RCR = block_cnt * HSMCI_BLOCK_SIZE / 4;
+	HSMCI->HSMCI_RNCR = 0;
+	HSMCI->HSMCI_ARGR = lba << adr_shift;
+	strm.st = STRM_READ;
+	strm.cur = (uint32_t) buf;
+	strm.cur_cnt = block_cnt;
+	taskENTER_CRITICAL();
+	HSMCI->HSMCI_PTCR = HSMCI_PTCR_RXTEN;
+	HSMCI->HSMCI_CMDR = HSMCI_CMDR_TRTYP_MULTIPLE | HSMCI_CMDR_TRDIR_READ | HSMCI_CMDR_TRCMD_START_DATA |
+			    HSMCI_CMDR_MAXLAT | HSMCI_CMDR_RSPTYP_48_BIT |
+			    HSMCI_CMDR_CMDNB(SDMMC_CMD_GET_INDEX(SDMMC_CMD18_READ_MULTIPLE_BLOCK));
+	HSMCI->HSMCI_IER = DATA_ERR | HSMCI_IER_CMDRDY;
+	taskEXIT_CRITICAL();
+	if ((ret = strm_wait(0, HSMCI_SR_CMDRDY, &sr))) {
+		return (ret);
+	}
+	if (HSMCI->HSMCI_RSPR[0] & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_COM_CRC_ERROR)) {
+		strm_abort();
+		stat_rd_err_cnt++;
+		return (-EHW);
+	}
+	stat_strm_cnt++;
+	return (0);
+}
+
+/**
+ * hsmci_stream_read_next
+ */
+int hsmci_stream_read_next(void *buf, int block_cnt, void **done)
+{
+	unsigned int sr;
+	int ret;
+
+	if (strm.st != STRM_READ) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (block_cnt < 1 || block_cnt > STRM_MAX_BLK) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	io_tck = xTaskGetTickCount();
+	strm.nxt = (uint32_t) buf;
+	strm.nxt_cnt = block_cnt;
+	taskENTER_CRITICAL();
+	HSMCI->HSMCI_RNPR = (uint32_t) buf;
+	HSMCI->HSMCI_RNCR = block_cnt * HSMCI_BLOCK_SIZE / 4;
+	if (HSMCI->HSMCI_RNCR == 0) {
+		// Current buffer was already full (card clock held by RDPROOF),
+		// next one was loaded immediately.
+		taskEXIT_CRITICAL();
+		stat_strm_stall_cnt++;
+	} else {
+		HSMCI->HSMCI_IER = DATA_ERR | HSMCI_IER_ENDRX;
+		taskEXIT_CRITICAL();
+		if ((ret = strm_wait(0, HSMCI_SR_ENDRX, &sr))) {
+			return (ret);
+		}
+	}
+	*done = (void *) strm.cur;
+	stat_rx_blk_cnt += strm.cur_cnt;
+	strm.cur = strm.nxt;
+	strm.cur_cnt = strm.nxt_cnt;
+	return (0);
+}
+
+/**
+ * hsmci_stream_read_end
+ */
+int hsmci_stream_read_end(void **done)
+{
+	unsigned int sr;
+	int ret;
+
+	if (strm.st != STRM_READ) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (done != NULL) {
+		if ((ret = strm_wait(DATA_ERR | HSMCI_IER_RXBUFF, HSMCI_SR_RXBUFF, &sr))) {
+			return (ret);
+		}
+		*done = (void *) strm.cur;
+		stat_rx_blk_cnt += strm.cur_cnt;
+	}
+	HSMCI->HSMCI_PTCR = HSMCI_PTCR_RXTDIS | HSMCI_PTCR_TXTDIS;
+	if ((ret = strm_stop())) {
+		return (ret);
+	}
+	// Discard data of the interrupted block.
+	while (HSMCI->HSMCI_SR & HSMCI_SR_RXRDY) {
+		HSMCI->HSMCI_RDR;
+	}
+	return (0);
+}
+
+/**
+ * hsmci_stream_write_begin
+ */
+int hsmci_stream_write_begin(size_t lba, const void *buf, int block_cnt)
+{
+	unsigned int sr;
+	int ret;
+
+	if (strm.st != STRM_IDLE) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (block_cnt < 1 || block_cnt > STRM_MAX_BLK) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	io_tck = xTaskGetTickCount();
+	HSMCI->HSMCI_MR |= HSMCI_MR_PDCMODE | HSMCI_MR_RDPROOF | HSMCI_MR_WRPROOF;
+	// BCNT == 0 -> infinite block transfer, stopped by CMD12.
+	HSMCI->HSMCI_BLKR = HSMCI_BLKR_BLKLEN(HSMCI_BLOCK_SIZE) | HSMCI_BLKR_BCNT(0);
+	HSMCI->HSMCI_TPR = (uint32_t) buf;
+	HSMCI->HSMCI_TCR = block_cnt * HSMCI_BLOCK_SIZE / 4;
+	HSMCI->HSMCI_TNCR = 0;
+	HSMCI->HSMCI_ARGR = lba << adr_shift;
+	strm.st = STRM_WRITE;
+	strm.cur = (uint32_t) buf;
+	strm.cur_cnt = block_cnt;
+	taskENTER_CRITICAL();
+	HSMCI->HSMCI_CMDR = HSMCI_CMDR_TRTYP_MULTIPLE | HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_MAXLAT |
+			    HSMCI_CMDR_RSPTYP_48_BIT |
+			    HSMCI_CMDR_CMDNB(SDMMC_CMD_GET_INDEX(SDMMC_CMD25_WRITE_MULTIPLE_BLOCK));
+	HSMCI->HSMCI_IER = CMD_ERR | HSMCI_IER_CMDRDY;
+	taskEXIT_CRITICAL();
+	if ((ret = strm_wait(0, HSMCI_SR_CMDRDY, &sr))) {
+		return (ret);
+	}
+	if (HSMCI->HSMCI_RSPR[0] & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_COM_CRC_ERROR)) {
+		strm_abort();
+		stat_wr_err_cnt++;
+		return (-EHW);
+	}
+	HSMCI->HSMCI_PTCR = HSMCI_PTCR_TXTEN;
+	stat_strm_cnt++;
+	return (0);
+}
+
+/**
+ * hsmci_stream_write_next
+ */
+int hsmci_stream_write_next(const void *buf, int block_cnt, const void **done)
+{
+	unsigned int sr;
+	int ret;
+
+	if (strm.st != STRM_WRITE) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (block_cnt < 1 || block_cnt > STRM_MAX_BLK) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	io_tck = xTaskGetTickCount();
+	strm.nxt = (uint32_t) buf;
+	strm.nxt_cnt = block_cnt;
+	taskENTER_CRITICAL();
+	HSMCI->HSMCI_TNPR = (uint32_t) buf;
+	HSMCI->HSMCI_TNCR = block_cnt * HSMCI_BLOCK_SIZE / 4;
+	if (HSMCI->HSMCI_TNCR == 0) {
+		// Current buffer was already sent (card clock held by WRPROOF),
+		// next one was loaded immediately.
+		taskEXIT_CRITICAL();
+		stat_strm_stall_cnt++;
+	} else {
+		HSMCI->HSMCI_IER = DATA_ERR | HSMCI_IER_ENDTX;
+		taskEXIT_CRITICAL();
+		if ((ret = strm_wait(0, HSMCI_SR_ENDTX, &sr))) {
+			return (ret);
+		}
+	}
+	*done = (const void *) strm.cur;
+	stat_tx_blk_cnt += strm.cur_cnt;
+	strm.cur = strm.nxt;
+	strm.cur_cnt = strm.nxt_cnt;
+	return (0);
+}
+
+/**
+ * hsmci_stream_write_end
+ */
+int hsmci_stream_write_end(void)
+{
+	unsigned int sr;
+	int ret;
+
+	if (strm.st != STRM_WRITE) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if ((ret = strm_wait(DATA_ERR | HSMCI_IER_TXBUFE, HSMCI_SR_TXBUFE, &sr))) {
+		return (ret);
+	}
+	// PDC is drained. BLKE is set per block and cleared by any SR read, so it
+	// cannot identify the last block. XFRDONE is a level flag: it is set
+	// only when the FIFO is empty, the last block and its CRC status are
+	// done and the card released the busy line.
+	if ((ret = strm_wait(DATA_ERR | HSMCI_IER_XFRDONE, HSMCI_SR_XFRDONE, &sr))) {
+		stat_wr_n_blke_cnt++;
+		return (ret);
+	}
+	HSMCI->HSMCI_PTCR = HSMCI_PTCR_RXTDIS | HSMCI_PTCR_TXTDIS;
+	stat_tx_blk_cnt += strm.cur_cnt;
+	return (strm_stop());
+}
+
+/**
+ * strm_wait
+ *
+ * Enable interrupts ier (unless already enabled by caller) and wait for
+ * status flag flg. Aborts the stream on error.
+ */
+static int strm_wait(unsigned int ier, unsigned int flg, unsigned int *sr)
+{
+	if (ier) {
+		HSMCI->HSMCI_IER = ier;
+	}
+	if (pdFALSE == xQueueReceive(sr_que, sr, ms_to_os_ticks(WAIT_INTR_MS))) {
+		stat_intr_tmo_cnt++;
+		strm_abort();
+		return (-EHW);
+	}
+	if (*sr & DATA_ERR) {
+		sr_err_cnt(*sr);
+		strm_abort();
+		return (-EHW);
+	}
+	if (!(*sr & flg)) {
+		strm_abort();
+		return (-EHW);
+	}
+	return (0);
+}
+
+/**
+ * strm_stop
+ */
+static int strm_stop(void)
+{
+	hsmci_resp_t resp;
+	int ret;
+
+	strm.st = STRM_IDLE;
+	if ((ret = send_cmd(SDMMC_CMD12_STOP_TRANSMISSION, 0, &resp, HSMCI_CMDR_TRCMD_STOP_DATA))) {
+		stat_strm_err_cnt++;
+		return (ret);
+	}
+	if (resp.r1 & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_COM_CRC_ERROR)) {
+		stat_strm_err_cnt++;
+		return (-EHW);
+	}
+	return (0);
+}
+
+/**
+ * strm_abort
+ */
+static void strm_abort(void)
+{
+	unsigned int sr;
+
+	reset_hsmci();
+	xQueueReceive(sr_que, &sr, 0);
+	stat_strm_err_cnt++;
+	strm.st = STRM_IDLE;
+	// Try to return the card to the transfer state.
+	send_cmd(SDMMC_CMD12_STOP_TRANSMISSION, 0, NULL, HSMCI_CMDR_TRCMD_STOP_DATA);
 }
 
 /**
@@ -725,6 +1148,13 @@ void log_hsmci_stats(void)
 	if (stat_wr_n_blke_cnt) {
 		msg(INF, "hsmci_sd: stat_wr_n_blke_cnt=%u\n", stat_wr_n_blke_cnt);
 	}
+	if (stat_pre_erase_cnt || stat_set_blk_cnt) {
+		msg(INF, "hsmci_sd: stat_pre_erase_cnt=%u stat_set_blk_cnt=%u\n", stat_pre_erase_cnt, stat_set_blk_cnt);
+	}
+	if (stat_strm_cnt) {
+		msg(INF, "hsmci_sd: stat_strm_cnt=%u stat_strm_stall_cnt=%u stat_strm_err_cnt=%u\n", stat_strm_cnt,
+		    stat_strm_stall_cnt, stat_strm_err_cnt);
+	}
 }
 #endif
 
@@ -29,12 +29,15 @@
  *  - Controller: SAM HSMCI, slot A, 1 or 4 bit data bus selected at
  *    compile time via HSMCI_SD_DLINE_NUM.
  *  - Block size is fixed to 512 bytes; all transfers are in 512-byte
- *    units. SDSC (byte-addressed) cards are not supported by this driver.
+ *    units.
  *  - Addressing in the API uses LBA (unit: 512-byte block) as for
- *    SDHC/SDXC devices.
+ *    SDHC/SDXC devices. For SDSC (byte-addressed) cards the card layer
+ *    enables hsmci_set_byte_addressing() and sets block length 512.
  *  - Single-instance, non-reentrant driver: only one command or data
  *    transfer may be active at any time. Callers running in multiple
- *    tasks must provide external serialization (e.g. a mutex).
+ *    tasks serialize whole transactions (e.g. a stream from begin to
+ *    end) by hsmci_lock()/hsmci_unlock(); hsmci_que, hsmci_cache,
+ *    sd_log and sd_erase all use this lock.
  *  - All functions are strictly blocking and wait until the command or
  *    data transfer completes or an error/timeout occurs.
  *  - Data buffers must reside in memory accessible by the HSMCI PDC/DMA
@@ -57,6 +60,10 @@
  #define HSMCI_SD 0
 #endif
 
+#ifndef HSMCI_PRE_ERASE_MIN_BLK
+ #define HSMCI_PRE_ERASE_MIN_BLK 8
+#endif
+
 #if HSMCI_SD == 1
 
 enum hsmci_bus_width {
@@ -64,6 +71,16 @@ enum hsmci_bus_width {
 	HSMCI_BUS_WIDTH_4
 };
 
+/**
+ * @brief Multi-block write options (hsmci_set_write_opt() bit mask).
+ */
+enum hsmci_wr_opt {
+	/** ACMD23 pre-erase before writes of HSMCI_PRE_ERASE_MIN_BLK or more blocks. */
+	HSMCI_WR_OPT_PRE_ERASE = 1,
+	/** CMD23 predefined block count instead of CMD12 stop (SCR.CMD_SUPPORT). */
+	HSMCI_WR_OPT_BLK_CNT = 2
+};
+
 /**
  * @brief HSMCI command response container.
  *
@@ -189,6 +206,57 @@ int hsmci_send_clock(void);
   */
 void hsmci_set_next_r1b_busy_tmo_ms(unsigned int tmo_ms);
 
+/**
+ * @brief Select byte addressing of data blocks (SDSC cards).
+ *
+ * When enabled, the LBA passed to the block read/write and stream functions
+ * is converted to a byte address (LBA * 512) in the command argument.
+ *
+ * @param on TRUE -> byte addressing (SDSC); FALSE -> block addressing (default).
+ */
+void hsmci_set_byte_addressing(boolean_t on);
+
+/**
+ * @brief Set multi-block write options of hsmci_write_blocks().
+ *
+ * With HSMCI_WR_OPT_PRE_ERASE the card is told by ACMD23 how many blocks
+ * follow, so it can erase them ahead of programming. With
+ * HSMCI_WR_OPT_BLK_CNT, CMD23 announces the block count; the card finishes
+ * CMD25 by itself and CMD12 with its R1b busy wait is not needed. Streams
+ * (hsmci_stream_write_*()) are open-ended and are not affected.
+ * Default: no options.
+ *
+ * Writes ended without CMD12 (single block, HSMCI_WR_OPT_BLK_CNT) read the
+ * card status by CMD13 to report programming errors; this needs rca.
+ *
+ * @param rca Relative card address (CMD55 of ACMD23, CMD13), 0 -> no status check.
+ * @param opt Bit mask of enum hsmci_wr_opt values.
+ */
+void hsmci_set_write_opt(unsigned int rca, unsigned int opt);
+
+/**
+ * @brief Get OS tick count of the last data transfer start.
+ *
+ * Covers block reads/writes, streams and hsmci_send_data_cmd(). Commands
+ * without data (e.g. erase) do not update it. Used to detect idle card I/O.
+ *
+ * @return Tick count (xTaskGetTickCount()).
+ */
+TickType_t hsmci_get_io_tick(void);
+
+/**
+ * @brief Take the driver access lock (blocking).
+ *
+ * Serializes card users running in different tasks. Hold it for a whole
+ * transaction, not only for single calls. Not recursive.
+ */
+void hsmci_lock(void);
+
+/**
+ * @brief Release the driver access lock.
+ */
+void hsmci_unlock(void);
+
 /**
  * @brief Send a command to the card and receive the response.
  *
@@ -250,8 +318,8 @@ int hsmci_send_data_cmd(unsigned int cmd, unsigned int arg, void *buf, size_t le
  *  - for block_cnt > 1 it uses multi-block read (CMD18) with STOP.
  *
  * Address argument is the logical block address (LBA, unit: 512-byte block)
- * as used by SDHC/SDXC cards. SDSC (byte-addressed) cards are not supported
- * by this low-level driver.
+ * as used by SDHC/SDXC cards; it is converted to a byte address if
+ * hsmci_set_byte_addressing() is enabled (SDSC cards).
  * The implementation relies on the 16-bit HSMCI/PDC transfer counters;
  * the caller should choose @p block_cnt such that the resulting transfer
  * length fits into the underlying counters.
@@ -273,11 +341,12 @@ int hsmci_read_blocks(size_t lba, int block_cnt, void *buf);
  *
  * Driver chooses appropriate SD command:
  *  - for block_cnt == 1 it uses single-block write (CMD24),
- *  - for block_cnt > 1 it uses multi-block write (CMD25) with STOP.
+ *  - for block_cnt > 1 it uses multi-block write (CMD25) with STOP, or
+ *    with CMD23/ACMD23 ahead of it as set by hsmci_set_write_opt().
  *
  * Address argument is the logical block address (LBA, unit: 512-byte block)
- * as used by SDHC/SDXC cards. SDSC (byte-addressed) cards are not supported
- * by this low-level driver.
+ * as used by SDHC/SDXC cards; it is converted to a byte address if
+ * hsmci_set_byte_addressing() is enabled (SDSC cards).
  * The implementation relies on the 16-bit HSMCI/PDC transfer counters;
  * the caller should choose @p block_cnt such that the resulting transfer
  * length fits into the underlying counters.
@@ -292,6 +361,94 @@ int hsmci_read_blocks(size_t lba, int block_cnt, void *buf);
  */
 int hsmci_write_blocks(size_t lba, int block_cnt, const void *buf);
 
+/**
+ * @brief Start an open-ended multi-block read stream.
+ *
+ * Issues CMD18 with an infinite HSMCI block count and arms the PDC with
+ * the first buffer. Further buffers are supplied by hsmci_stream_read_next()
+ * through the PDC next-pointer registers, so one CMD18 covers the whole
+ * stream regardless of its length and no contiguous RAM for it is needed.
+ * If the caller runs out of buffers, RDPROOF holds the card clock until
+ * the next buffer is supplied; no data is lost (counted as stall in stats).
+ *
+ * Only one stream (read or write) may be active and no other hsmci_*()
+ * call is allowed until the stream is finished by hsmci_stream_read_end().
+ * On error the stream is aborted (CMD12 is sent) and must not be ended.
+ *
+ * @param lba       Logical block address of the first block (512 B units).
+ * @param buf       First destination buffer (PDC accessible, 32-bit aligned).
+ * @param block_cnt Size of @p buf in 512 B blocks (1..511).
+ *
+ * Returns: 0 - success; -EHW on error.
+ */
+int hsmci_stream_read_begin(size_t lba, void *buf, int block_cnt);
+
+/**
+ * @brief Supply the next read stream buffer and wait for the current one.
+ *
+ * @p buf becomes the PDC next buffer; the function blocks until the PDC
+ * has filled the current buffer and switched to @p buf. The filled buffer
+ * is returned in @p done and belongs to the caller again.
+ *
+ * @param buf       Next destination buffer (may differ in size and location).
+ * @param block_cnt Size of @p buf in 512 B blocks (1..511).
+ * @param done      Filled buffer (return).
+ *
+ * Returns: 0 - success; -EHW on error (stream aborted).
+ */
+int hsmci_stream_read_next(void *buf, int block_cnt, void **done);
+
+/**
+ * @brief Finish a read stream with CMD12.
+ *
+ * @param done If not NULL, the function waits until the current buffer is
+ *        filled and returns it here. If NULL, the current buffer is
+ *        discarded and the transfer is stopped immediately.
+ *
+ * Returns: 0 - success; -EHW on error.
+ */
+int hsmci_stream_read_end(void **done);
+
+/**
+ * @brief Start an open-ended multi-block write stream.
+ *
+ * Write counterpart of hsmci_stream_read_begin() using CMD25. WRPROOF holds
+ * the card clock when the caller runs out of buffers, so the card does not
+ * see an underrun.
+ *
+ * @param lba       Logical block address of the first block (512 B units).
+ * @param buf       First source buffer (PDC accessible, 32-bit aligned).
+ * @param block_cnt Size of @p buf in 512 B blocks (1..511).
+ *
+ * Returns: 0 - success; -EHW on error.
+ */
+int hsmci_stream_write_begin(size_t lba, const void *buf, int block_cnt);
+
+/**
+ * @brief Supply the next write stream buffer and wait for the current one.
+ *
+ * Blocks until the PDC has moved the current buffer into the HSMCI and
+ * switched to @p buf. The sent buffer is returned in @p done and may be
+ * refilled by the caller.
+ *
+ * @param buf       Next source buffer (may differ in size and location).
+ * @param block_cnt Size of @p buf in 512 B blocks (1..511).
+ * @param done      Sent buffer (return).
+ *
+ * Returns: 0 - success; -EHW on error (stream aborted).
+ */
+int hsmci_stream_write_next(const void *buf, int block_cnt, const void **done);
+
+/**
+ * @brief Finish a write stream.
+ *
+ * Waits until the last buffer is written to the card and sends CMD12
+ * (including the R1b busy wait for card programming).
+ *
+ * Returns: 0 - success; -EHW on error.
+ */
+int hsmci_stream_write_end(void);
+
 #if TERMOUT == 1
 /**
  * @brief Logs HSMCI driver statistics.
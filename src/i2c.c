@@ -20,6 +20,7 @@
 #include <task.h>
 #include <semphr.h>
 #include <queue.h>
+#include <timers.h>
 #include <gentyp.h>
 #include <string.h>
 #include <stdarg.h>
@@ -35,11 +36,24 @@
 
 #if I2CBUS == 1
 
+#if I2C_REQ_QUE == 1 && configUSE_TIMERS != 1
+ #error "I2C_REQ_QUE requires configUSE_TIMERS"
+#endif
+
 #define WAIT_INTR_MS 1000
 #define LOW_LEV_TM_LIMIT 384000
 #define FAST_MODE_SPEED  400000
 #define CWGR_CEIL 1
 
+#if I2C_SLV == 1
+enum i2c_slv_st {
+	I2C_SLV_IDLE,
+	I2C_SLV_PTR,
+	I2C_SLV_WR,
+	I2C_SLV_RD
+};
+#endif
+
 static i2cbus i2c0;
 #ifdef ID_TWI1
 static i2cbus i2c1;
@@ -47,13 +61,42 @@ static i2cbus i2c1;
 #ifdef ID_TWI2
 static i2cbus i2c2;
 #endif
+#if I2C_REQ_QUE == 1
+static TimerHandle_t rq_tmr[3];
+#endif
 
+static void map_bus(i2cbus bus);
 static void set_cwgr(i2cbus bus);
+static boolean_t chk_iadr(enum i2c_mode mode, int iadr);
+static void msen(i2cbus bus);
+static void set_mmr(i2cbus bus, enum i2c_mode mode, int adr, int iadr, boolean_t rd);
+static void start_read(i2cbus bus, uint8_t *p_buf, int size, boolean_t dma);
+static void start_write(i2cbus bus, uint8_t *p_buf, int size, boolean_t dma);
+static void start_msg(i2cbus bus);
+static void tmo_reset(i2cbus bus);
+static BaseType_t trans_end(i2cbus bus, int8_t msg);
+static void acq_bus(i2cbus bus);
+static void rel_bus(i2cbus bus);
+#if I2C_REQ_QUE == 1
+static void start_req(i2cbus bus);
+static BaseType_t req_end(i2cbus bus, int8_t msg);
+static void compl_req(struct i2c_req *req, BaseType_t *tsk_wkn);
+static void abort_req(i2cbus bus, struct i2c_req *req, int xidx);
+static void rq_tmr_cb(TimerHandle_t tmr);
+static TimerHandle_t *bus_tmr(i2cbus bus);
+#endif
 static BaseType_t i2c_read_hndlr(i2cbus bus);
 static BaseType_t i2c_dma_read_hndlr(i2cbus bus);
 static BaseType_t i2c_write_hndlr(i2cbus bus);
 static BaseType_t i2c_dma_write_hndlr(i2cbus bus);
 static BaseType_t i2c_empty_hndlr(i2cbus bus);
+#if I2C_SLV == 1
+static void slv_idle(i2cbus bus);
+static void slv_rd_start(i2cbus bus);
+static void slv_rd_end(i2cbus bus);
+static void slv_wr_end(i2cbus bus, BaseType_t *tsk_wkn);
+static BaseType_t i2c_slv_hndlr(i2cbus bus);
+#endif
 static IRQn_Type busid2irqn(int per_id);
 static inline uint32_t udiv_ceil(uint32_t a, uint32_t b);
 
@@ -64,6 +107,50 @@ void init_i2c(i2cbus bus)
 {
 	NVIC_DisableIRQ(busid2irqn(bus->id));
 	memset(&bus->stats, 0, sizeof(bus->stats));
+	map_bus(bus);
+	if (bus->sig_que == NULL) {
+		bus->sig_que = xQueueCreate(1, sizeof(int8_t));
+		if (bus->sig_que == NULL) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	} else {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+        enable_periph_clk(bus->id);
+        bus->mmio->TWI_CR = TWI_CR_SWRST;
+	bus->mmio->TWI_CR = TWI_CR_SVDIS;
+        bus->mmio->TWI_CR = TWI_CR_MSDIS;
+        bus->mmio->TWI_IDR = ~0;
+	bus->mmio->TWI_SR;
+	if (!(bus->clk_hz > 0)) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	set_cwgr(bus);
+	bus->ini = 0;
+	bus->xmsg = NULL;
+#if I2C_REQ_QUE == 1
+	bus->rq_head = bus->rq_tail = bus->areq = NULL;
+	bus->busy = bus->wt_idle = FALSE;
+	bus->rq_prog = bus->rq_prog_chk = 0;
+	if (*bus_tmr(bus) == NULL) {
+		if (NULL == (*bus_tmr(bus) = xTimerCreate("I2CRQ", ms_to_os_ticks(WAIT_INTR_MS), pdFALSE, bus,
+							  rq_tmr_cb))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	}
+#endif
+	NVIC_ClearPendingIRQ(busid2irqn(bus->id));
+	NVIC_SetPriority(busid2irqn(bus->id), configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY);
+	bus->hndlr = i2c_empty_hndlr;
+	NVIC_EnableIRQ(busid2irqn(bus->id));
+        disable_periph_clk(bus->id);
+}
+
+/**
+ * map_bus
+ */
+static void map_bus(i2cbus bus)
+{
 	bus->dma = FALSE;
         if (bus->id == ID_TWI0) {
 		i2c0 = bus;
@@ -93,32 +180,208 @@ void init_i2c(i2cbus bus)
 	} else {
 		crit_err_exit(BAD_PARAMETER);
 	}
-	if (bus->sig_que == NULL) {
-		bus->sig_que = xQueueCreate(1, sizeof(int8_t));
-		if (bus->sig_que == NULL) {
-			crit_err_exit(MALLOC_ERROR);
-		}
-	} else {
-		crit_err_exit(UNEXP_PROG_STATE);
+}
+
+#if I2C_SLV == 1
+/**
+ * init_i2c_slv
+ */
+void init_i2c_slv(i2cbus bus)
+{
+	struct i2c_slv *slv = bus->slv;
+
+	if (slv == NULL || slv->adr < 1 || slv->adr > 0x7F || slv->map == NULL ||
+	    slv->map_size < 1 || slv->map_size > 256 || slv->wr_buf == NULL || slv->wr_size < 1) {
+		crit_err_exit(BAD_PARAMETER);
 	}
+	NVIC_DisableIRQ(busid2irqn(bus->id));
+	map_bus(bus);
+	memset(&slv->stats, 0, sizeof(slv->stats));
+	slv->ptr = 0;
+	bus->hndlr = i2c_slv_hndlr;
         enable_periph_clk(bus->id);
         bus->mmio->TWI_CR = TWI_CR_SWRST;
-	bus->mmio->TWI_CR = TWI_CR_SVDIS;
         bus->mmio->TWI_CR = TWI_CR_MSDIS;
-        bus->mmio->TWI_IDR = ~0;
+	bus->mmio->TWI_CR = TWI_CR_SVDIS;
+	bus->mmio->TWI_SMR = TWI_SMR_SADR(slv->adr);
+	slv_idle(bus);
 	bus->mmio->TWI_SR;
-	if (!(bus->clk_hz > 0)) {
-		crit_err_exit(BAD_PARAMETER);
-	}
-	set_cwgr(bus);
-	bus->ini = 0;
 	NVIC_ClearPendingIRQ(busid2irqn(bus->id));
 	NVIC_SetPriority(busid2irqn(bus->id), configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY);
-	bus->hndlr = i2c_empty_hndlr;
 	NVIC_EnableIRQ(busid2irqn(bus->id));
-        disable_periph_clk(bus->id);
+	bus->mmio->TWI_CR = TWI_CR_SVEN;
+}
+
+/**
+ * slv_idle
+ */
+static void slv_idle(i2cbus bus)
+{
+	bus->slv->st = I2C_SLV_IDLE;
+	bus->mmio->TWI_IDR = ~0;
+	bus->mmio->TWI_IER = TWI_IER_SVACC;
+}
+
+/**
+ * slv_rd_start
+ *
+ * Master reads: the register map is sent from the pointer on, by PDC if possible.
+ */
+static void slv_rd_start(i2cbus bus)
+{
+	struct i2c_slv *slv = bus->slv;
+
+	slv->st = I2C_SLV_RD;
+	slv->stats.rd_acc++;
+	slv->pos = slv->ptr;
+	bus->mmio->TWI_IDR = ~0;
+	if (bus->dma && slv->pos < slv->map_size) {
+		slv->pdc = TRUE;
+		bus->mmio->TWI_TPR = (unsigned int) (slv->map + slv->pos);
+                bus->mmio->TWI_TCR = slv->map_size - slv->pos;
+                bus->mmio->TWI_TNCR = 0;
+                bus->mmio->TWI_PTCR = TWI_PTCR_TXTEN;
+		bus->mmio->TWI_IER = TWI_IER_ENDTX | TWI_IER_EOSACC;
+	} else {
+		slv->pdc = FALSE;
+		bus->mmio->TWI_IER = TWI_IER_TXRDY | TWI_IER_EOSACC;
+	}
+}
+
+/**
+ * slv_rd_end
+ */
+static void slv_rd_end(i2cbus bus)
+{
+	struct i2c_slv *slv = bus->slv;
+
+	if (slv->pdc) {
+		bus->mmio->TWI_PTCR = TWI_PTCR_TXTDIS;
+		slv->pos = slv->map_size - bus->mmio->TWI_TCR;
+		bus->mmio->TWI_TCR = 0;
+	}
+	slv->stats.rd_bytes += slv->pos - slv->ptr;
+	slv_idle(bus);
+}
+
+/**
+ * slv_wr_end
+ */
+static void slv_wr_end(i2cbus bus, BaseType_t *tsk_wkn)
+{
+	struct i2c_slv *slv = bus->slv;
+
+	if (slv->pdc) {
+		bus->mmio->TWI_PTCR = TWI_PTCR_RXTDIS;
+		slv->pos = slv->wr_size - bus->mmio->TWI_RCR;
+		bus->mmio->TWI_RCR = 0;
+	}
+	if (slv->pos > 0) {
+		slv->stats.wr_bytes += slv->pos;
+		if (slv->wr_clbk != NULL) {
+			(*slv->wr_clbk)(bus, slv->ptr, slv->wr_buf, slv->pos, tsk_wkn);
+		}
+	}
 }
 
+/**
+ * i2c_slv_hndlr
+ */
+static BaseType_t i2c_slv_hndlr(i2cbus bus)
+{
+	struct i2c_slv *slv = bus->slv;
+	BaseType_t tsk_wkn = pdFALSE;
+	unsigned int sr, imr;
+
+	sr = bus->mmio->TWI_SR;
+	imr = bus->mmio->TWI_IMR;
+	if (sr & TWI_SR_OVRE) {
+		slv->stats.ovre++;
+	}
+	if (slv->st != I2C_SLV_RD && sr & TWI_SR_SVACC && sr & TWI_SR_SVREAD) {
+		// Read access, possibly after repeated start following the pointer write.
+		if (slv->st == I2C_SLV_WR) {
+			slv_wr_end(bus, &tsk_wkn);
+		}
+		slv_rd_start(bus);
+		return (tsk_wkn);
+	}
+	switch (slv->st) {
+	case I2C_SLV_IDLE :
+		if (sr & TWI_SR_SVACC) {
+			slv->st = I2C_SLV_PTR;
+			slv->stats.wr_acc++;
+			bus->mmio->TWI_IDR = TWI_IDR_SVACC;
+			bus->mmio->TWI_IER = TWI_IER_RXRDY | TWI_IER_SCL_WS | TWI_IER_EOSACC;
+		}
+		break;
+	case I2C_SLV_PTR :
+		if (sr & TWI_SR_RXRDY) {
+			slv->ptr = bus->mmio->TWI_RHR;
+			slv->st = I2C_SLV_WR;
+			slv->pos = 0;
+			if (bus->dma) {
+				slv->pdc = TRUE;
+				bus->mmio->TWI_RPR = (unsigned int) slv->wr_buf;
+				bus->mmio->TWI_RCR = slv->wr_size;
+				bus->mmio->TWI_RNCR = 0;
+				bus->mmio->TWI_PTCR = TWI_PTCR_RXTEN;
+				bus->mmio->TWI_IDR = TWI_IDR_RXRDY;
+				bus->mmio->TWI_IER = TWI_IER_ENDRX;
+			} else {
+				slv->pdc = FALSE;
+			}
+		} else if (sr & TWI_SR_EOSACC) {
+			// Address only access (probe).
+			slv_idle(bus);
+		}
+		break;
+	case I2C_SLV_WR :
+		if (sr & TWI_SR_ENDRX && imr & TWI_IMR_ENDRX) {
+			// Write buffer full, further bytes are dropped.
+			bus->mmio->TWI_PTCR = TWI_PTCR_RXTDIS;
+			slv->pdc = FALSE;
+			slv->pos = slv->wr_size;
+			bus->mmio->TWI_IDR = TWI_IDR_ENDRX;
+			bus->mmio->TWI_IER = TWI_IER_RXRDY;
+		} else if (sr & TWI_SR_RXRDY && imr & TWI_IMR_RXRDY) {
+			if (slv->pos < slv->wr_size) {
+				slv->wr_buf[slv->pos++] = bus->mmio->TWI_RHR;
+			} else {
+				bus->mmio->TWI_RHR;
+				slv->stats.wr_drop++;
+			}
+		}
+		if (sr & TWI_SR_EOSACC) {
+			slv_wr_end(bus, &tsk_wkn);
+			slv_idle(bus);
+		}
+		break;
+	case I2C_SLV_RD :
+		if (sr & TWI_SR_EOSACC) {
+			slv_rd_end(bus);
+			break;
+		}
+		if (sr & TWI_SR_ENDTX && imr & TWI_IMR_ENDTX) {
+			bus->mmio->TWI_PTCR = TWI_PTCR_TXTDIS;
+			slv->pdc = FALSE;
+			slv->pos = slv->map_size;
+			bus->mmio->TWI_IDR = TWI_IDR_ENDTX;
+			bus->mmio->TWI_IER = TWI_IER_TXRDY;
+		} else if (sr & TWI_SR_TXRDY && imr & TWI_IMR_TXRDY) {
+			if (slv->pos < slv->map_size) {
+				bus->mmio->TWI_THR = slv->map[slv->pos++];
+			} else {
+				bus->mmio->TWI_THR = 0xFF;
+				slv->stats.rd_pad++;
+			}
+		}
+		break;
+	}
+	return (tsk_wkn);
+}
+#endif
+
 #if CWGR_CEIL == 1
 /**
  * set_cwgr
@@ -210,18 +473,8 @@ int i2c_read(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
 		va_start(ap, dma);
 		iadr = va_arg(ap, int);
 		va_end(ap);
-		if (mode == I2C_MODE_7BIT_ADR_IADR1 || mode == I2C_MODE_10BIT_ADR_IADR1) {
-			if (iadr & 0xFFFFFF00) {
-				return (-EADDR);
-			}
-		} else if (mode == I2C_MODE_7BIT_ADR_IADR2 || mode == I2C_MODE_10BIT_ADR_IADR2) {
-			if (iadr & 0xFFFF0000) {
-				return (-EADDR);
-			}
-		} else {
-			if (iadr & 0xFF000000) {
-				return (-EADDR);
-			}
+		if (!chk_iadr(mode, iadr)) {
+			return (-EADDR);
 		}
 	}
 	if (size < 1) {
@@ -230,23 +483,73 @@ int i2c_read(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
 	if (bus->mtx != NULL) {
 		xSemaphoreTake(bus->mtx, portMAX_DELAY);
 	}
-        bus->ovre = FALSE;
-        enable_periph_clk(bus->id);
+	acq_bus(bus);
+	set_mmr(bus, mode, adr, iadr, TRUE);
+	start_read(bus, p_buf, size, dma);
+        if (pdFALSE == xQueueReceive(bus->sig_que, &msg, ms_to_os_ticks(WAIT_INTR_MS))) {
+		tmo_reset(bus);
+		msg = EHW;
+	}
+	if (msg == 0) {
+		bus->stats.rx_bytes_cnt += size;
+	}
+	rel_bus(bus);
+	if (bus->mtx != NULL) {
+		xSemaphoreGive(bus->mtx);
+	}
+	return (-msg);
+}
+
+/**
+ * chk_iadr
+ */
+static boolean_t chk_iadr(enum i2c_mode mode, int iadr)
+{
+	if (mode == I2C_MODE_7BIT_ADR_IADR1 || mode == I2C_MODE_10BIT_ADR_IADR1) {
+		if (iadr & 0xFFFFFF00) {
+			return (FALSE);
+		}
+	} else if (mode == I2C_MODE_7BIT_ADR_IADR2 || mode == I2C_MODE_10BIT_ADR_IADR2) {
+		if (iadr & 0xFFFF0000) {
+			return (FALSE);
+		}
+	} else if (mode == I2C_MODE_7BIT_ADR_IADR3) {
+		if (iadr & 0xFF000000) {
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
+/**
+ * msen
+ */
+static void msen(i2cbus bus)
+{
 	if (bus->ini == 0 || bus->ini == 2) {
 		bus->ini = 1;
 		bus->mmio->TWI_CR = TWI_CR_MSDIS;
 		bus->mmio->TWI_CR = TWI_CR_SVDIS;
 		bus->mmio->TWI_CR = TWI_CR_MSEN;
 	}
+}
+
+/**
+ * set_mmr
+ */
+static void set_mmr(i2cbus bus, enum i2c_mode mode, int adr, int iadr, boolean_t rd)
+{
+	unsigned int mread = (rd) ? TWI_MMR_MREAD : 0;
+
 	if (mode < I2C_MODE_10BIT_ADR) {
-		bus->mmio->TWI_MMR = TWI_MMR_DADR(adr) | TWI_MMR_MREAD | mode << 8;
+		bus->mmio->TWI_MMR = TWI_MMR_DADR(adr) | mread | mode << 8;
 		if (mode > I2C_MODE_7BIT_ADR) {
 			bus->mmio->TWI_IADR = iadr;
 		}
 	} else {
 		int a = 0x78;
 		a |= adr >> 8;
-                bus->mmio->TWI_MMR = TWI_MMR_DADR(a) | TWI_MMR_MREAD | (mode - 3) << 8;
+                bus->mmio->TWI_MMR = TWI_MMR_DADR(a) | mread | (mode - 3) << 8;
 		if (mode == I2C_MODE_10BIT_ADR) {
 			iadr = adr & 0xFF;
 		} else if (mode == I2C_MODE_10BIT_ADR_IADR1) {
@@ -256,6 +559,16 @@ int i2c_read(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
 		}
 		bus->mmio->TWI_IADR = iadr;
 	}
+}
+
+/**
+ * start_read
+ *
+ * Start master read of size bytes (task or ISR context).
+ */
+static void start_read(i2cbus bus, uint8_t *p_buf, int size, boolean_t dma)
+{
+        bus->ovre = FALSE;
 	bus->mmio->TWI_SR;
 	if (bus->dma && dma && size >= 4) {
 		bus->hndlr = i2c_dma_read_hndlr;
@@ -280,51 +593,328 @@ int i2c_read(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
 		barrier();
                 bus->mmio->TWI_IER = TWI_IER_NACK | TWI_IER_RXRDY;
 	}
-        if (pdFALSE == xQueueReceive(bus->sig_que, &msg, ms_to_os_ticks(WAIT_INTR_MS))) {
-		bus->mmio->TWI_IDR = ~0;
-		bus->mmio->TWI_CR = TWI_CR_SWRST;
-		bus->mmio->TWI_CR = TWI_CR_MSDIS;
-		bus->mmio->TWI_CR = TWI_CR_SVDIS;
-		bus->mmio->TWI_SR;
-		set_cwgr(bus);
-		xQueueReceive(bus->sig_que, &msg, 0);
-		bus->ini = 0;
-		bus->stats.intr_tmo_err_cnt++;
-		msg = EHW;
+}
+
+/**
+ * tmo_reset
+ */
+static void tmo_reset(i2cbus bus)
+{
+	int8_t msg;
+
+	bus->mmio->TWI_IDR = ~0;
+	bus->mmio->TWI_CR = TWI_CR_SWRST;
+	bus->mmio->TWI_CR = TWI_CR_MSDIS;
+	bus->mmio->TWI_CR = TWI_CR_SVDIS;
+	bus->mmio->TWI_SR;
+	set_cwgr(bus);
+	xQueueReceive(bus->sig_que, &msg, 0);
+	bus->ini = 0;
+	bus->stats.intr_tmo_err_cnt++;
+}
+
+/**
+ * trans_end
+ *
+ * Called from ISR at the end of a transfer. Within an i2c_xfer() batch the next
+ * message is started directly, the task is signaled after the last one or on error.
+ */
+static BaseType_t trans_end(i2cbus bus, int8_t msg)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+
+	if (bus->xmsg != NULL) {
+#if I2C_REQ_QUE == 1
+		bus->rq_prog++;
+#endif
+		bus->xmsg[bus->xidx].ret = -msg;
+		if (bus->xmrg) {
+			bus->xmsg[bus->xidx - 1].ret = -msg;
+		}
+		if (msg == 0 && ++bus->xidx < bus->xnum) {
+			start_msg(bus);
+			return (pdFALSE);
+		}
+#if I2C_REQ_QUE == 1
+		if (bus->areq != NULL) {
+			return (req_end(bus, msg));
+		}
+#endif
 	}
-	if (msg == 0) {
-		bus->stats.rx_bytes_cnt += size;
+	xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
+	return (tsk_wkn);
+}
+
+/**
+ * acq_bus
+ *
+ * Claim the bus for a blocking transfer (caller holds bus->mtx). The running
+ * queued request is allowed to finish, then the bus is handed over to the
+ * caller before the next queued one starts.
+ */
+static void acq_bus(i2cbus bus)
+{
+#if I2C_REQ_QUE == 1
+	int8_t msg;
+
+	for (;;) {
+		taskENTER_CRITICAL();
+		if (!bus->busy) {
+			bus->busy = TRUE;
+			taskEXIT_CRITICAL();
+			break;
+		}
+		bus->wt_idle = TRUE;
+		taskEXIT_CRITICAL();
+		if (pdTRUE == xQueueReceive(bus->sig_que, &msg, ms_to_os_ticks(WAIT_INTR_MS))) {
+			// Bus handed over by req_end() or abort_req() (busy stays set).
+			break;
+		}
 	}
+#endif
+        enable_periph_clk(bus->id);
+	msen(bus);
+}
+
+/**
+ * rel_bus
+ *
+ * Release the bus after a blocking transfer; start queued requests if any.
+ */
+static void rel_bus(i2cbus bus)
+{
+#if I2C_REQ_QUE == 1
+	msen(bus);
+	taskENTER_CRITICAL();
+	if (bus->rq_head != NULL) {
+		start_req(bus);
+	} else {
+		bus->busy = FALSE;
+		disable_periph_clk(bus->id);
+	}
+	taskEXIT_CRITICAL();
+#else
         disable_periph_clk(bus->id);
-	if (bus->mtx != NULL) {
-		xSemaphoreGive(bus->mtx);
+#endif
+}
+
+#if I2C_REQ_QUE == 1
+/**
+ * i2c_submit
+ */
+int i2c_submit(i2cbus bus, struct i2c_req *req)
+{
+	boolean_t start = FALSE;
+
+	if (req->num < 1) {
+		crit_err_exit(BAD_PARAMETER);
 	}
-	return (-msg);
+	for (int i = 0; i < req->num; i++) {
+		if (req->msgs[i].size < 1) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		if (!chk_iadr(req->msgs[i].mode, req->msgs[i].iadr)) {
+			req->msgs[i].ret = req->ret = -EADDR;
+			return (-EADDR);
+		}
+		req->msgs[i].ret = -EINTR;
+	}
+	req->ret = -EINTR;
+	req->next = NULL;
+	taskENTER_CRITICAL();
+	if (bus->rq_head == NULL) {
+		bus->rq_head = req;
+	} else {
+		bus->rq_tail->next = req;
+	}
+	bus->rq_tail = req;
+	if (!bus->busy) {
+		bus->busy = start = TRUE;
+	}
+	taskEXIT_CRITICAL();
+	if (start) {
+		enable_periph_clk(bus->id);
+		msen(bus);
+		taskENTER_CRITICAL();
+		start_req(bus);
+		taskEXIT_CRITICAL();
+	}
+	if (pdFALSE == xTimerIsTimerActive(*bus_tmr(bus))) {
+		xTimerReset(*bus_tmr(bus), portMAX_DELAY);
+	}
+	return (0);
 }
 
 /**
- * i2c_read_hndlr
+ * start_req
+ *
+ * Start request at the queue head (ISR context or task critical section).
  */
-static BaseType_t i2c_read_hndlr(i2cbus bus)
+static void start_req(i2cbus bus)
+{
+	bus->rq_prog++;
+	bus->areq = bus->rq_head;
+	bus->xmsg = bus->areq->msgs;
+	bus->xnum = bus->areq->num;
+	bus->xidx = 0;
+	start_msg(bus);
+}
+
+/**
+ * req_end
+ */
+static BaseType_t req_end(i2cbus bus, int8_t msg)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	struct i2c_req *req = bus->areq;
+
+	for (int i = 0; i < req->num; i++) {
+		if (req->msgs[i].ret == 0) {
+			if (req->msgs[i].rd) {
+				bus->stats.rx_bytes_cnt += req->msgs[i].size;
+			} else {
+				bus->stats.tx_bytes_cnt += req->msgs[i].size;
+			}
+		}
+	}
+	req->ret = -msg;
+	bus->rq_head = req->next;
+	bus->areq = NULL;
+	bus->xmsg = NULL;
+	compl_req(req, &tsk_wkn);
+	if (bus->wt_idle) {
+		// Blocking caller goes first, so submitters cannot starve it.
+		bus->wt_idle = FALSE;
+		msg = 0;
+		xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
+	} else if (bus->rq_head != NULL) {
+		start_req(bus);
+	} else {
+		bus->busy = FALSE;
+		disable_periph_clk_nocs(bus->id);
+	}
+	return (tsk_wkn);
+}
+
+/**
+ * compl_req
+ */
+static void compl_req(struct i2c_req *req, BaseType_t *tsk_wkn)
+{
+	if (req->clbk != NULL) {
+		(*req->clbk)(req, tsk_wkn);
+	} else if (req->tsk != NULL) {
+		vTaskNotifyGiveFromISR(req->tsk, tsk_wkn);
+	}
+}
+
+/**
+ * abort_req
+ *
+ * Fail request which made no progress within WAIT_INTR_MS with -EINTR and
+ * continue with the next one (timer task context).
+ */
+static void abort_req(i2cbus bus, struct i2c_req *req, int xidx)
 {
 	BaseType_t tsk_wkn = pdFALSE;
-        int8_t msg;
+	int8_t msg = 0;
+
+	taskENTER_CRITICAL();
+	if (req == NULL || bus->areq != req || bus->xidx != xidx) {
+		taskEXIT_CRITICAL();
+		return;
+	}
+	bus->mmio->TWI_IDR = ~0;
+	req->ret = -EINTR;
+	bus->rq_head = req->next;
+	bus->areq = NULL;
+	bus->xmsg = NULL;
+	taskEXIT_CRITICAL();
+	tmo_reset(bus);
+	msen(bus);
+	taskENTER_CRITICAL();
+	compl_req(req, &tsk_wkn);
+	if (bus->wt_idle) {
+		bus->wt_idle = FALSE;
+		xQueueSend(bus->sig_que, &msg, 0);
+	} else if (bus->rq_head != NULL) {
+		start_req(bus);
+	} else {
+		bus->busy = FALSE;
+		disable_periph_clk_nocs(bus->id);
+	}
+	taskEXIT_CRITICAL();
+	if (tsk_wkn) {
+		taskYIELD();
+	}
+}
+
+/**
+ * rq_tmr_cb
+ *
+ * Request watchdog, runs every WAIT_INTR_MS while requests are queued. The
+ * active request is aborted if no message ended and no request started
+ * since the previous run.
+ */
+static void rq_tmr_cb(TimerHandle_t tmr)
+{
+	i2cbus bus = pvTimerGetTimerID(tmr);
+	struct i2c_req *req;
+	boolean_t stall, pend;
+	int xidx;
+
+	taskENTER_CRITICAL();
+	req = bus->areq;
+	xidx = bus->xidx;
+	stall = (req != NULL && bus->rq_prog == bus->rq_prog_chk) ? TRUE : FALSE;
+	bus->rq_prog_chk = bus->rq_prog;
+	taskEXIT_CRITICAL();
+	if (stall) {
+		abort_req(bus, req, xidx);
+	}
+	taskENTER_CRITICAL();
+	pend = (bus->rq_head != NULL) ? TRUE : FALSE;
+	taskEXIT_CRITICAL();
+	if (pend) {
+		xTimerReset(tmr, 0);
+	}
+}
+
+/**
+ * bus_tmr
+ */
+static TimerHandle_t *bus_tmr(i2cbus bus)
+{
+#ifdef ID_TWI2
+	if (bus->id == ID_TWI2) {
+		return (&rq_tmr[2]);
+	}
+#endif
+#ifdef ID_TWI1
+	if (bus->id == ID_TWI1) {
+		return (&rq_tmr[1]);
+	}
+#endif
+	return (&rq_tmr[0]);
+}
+#endif
 
+/**
+ * i2c_read_hndlr
+ */
+static BaseType_t i2c_read_hndlr(i2cbus bus)
+{
 	unsigned int sr = bus->mmio->TWI_SR;
 	if (sr & TWI_SR_NACK) {
 		bus->mmio->TWI_IDR = ~0;
-		msg = ENACK;
-                xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
-                return (tsk_wkn);
+                return (trans_end(bus, ENACK));
 	}
 	if (sr & TWI_SR_OVRE) {
 		bus->ovre = TRUE;
 	}
         if (sr & TWI_SR_TXCOMP && bus->mmio->TWI_IMR & TWI_IMR_TXCOMP) {
 		bus->mmio->TWI_IDR = ~0;
-		msg = (bus->ovre == FALSE) ? 0 : EDATA;
-		xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
-                return (tsk_wkn);
+                return (trans_end(bus, (bus->ovre == FALSE) ? 0 : EDATA));
 	}
 	if (sr & TWI_SR_RXRDY) {
                 if (--bus->cnt < 2) {
@@ -337,7 +927,7 @@ static BaseType_t i2c_read_hndlr(i2cbus bus)
 		}
 		*bus->buf++ = bus->mmio->TWI_RHR;
 	}
-        return (tsk_wkn);
+        return (pdFALSE);
 }
 
 /**
@@ -345,23 +935,18 @@ static BaseType_t i2c_read_hndlr(i2cbus bus)
  */
 static BaseType_t i2c_dma_read_hndlr(i2cbus bus)
 {
-	BaseType_t tsk_wkn = pdFALSE;
-        int8_t msg;
-
 	unsigned int sr = bus->mmio->TWI_SR;
 	bus->mmio->TWI_PTCR = TWI_PTCR_RXTDIS;
 	if (sr & TWI_SR_NACK) {
 		bus->mmio->TWI_IDR = ~0;
-		msg = ENACK;
-                xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
-                return (tsk_wkn);
+                return (trans_end(bus, ENACK));
 	}
         if (sr & TWI_SR_ENDRX) {
         	bus->hndlr = i2c_read_hndlr;
 		bus->mmio->TWI_IDR = TWI_IDR_ENDRX;
 		bus->mmio->TWI_IER = TWI_IER_RXRDY;
 	}
-        return (tsk_wkn);
+        return (pdFALSE);
 }
 
 /**
@@ -377,18 +962,8 @@ int i2c_write(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
 		va_start(ap, dma);
 		iadr = va_arg(ap, int);
 		va_end(ap);
-		if (mode == I2C_MODE_7BIT_ADR_IADR1 || mode == I2C_MODE_10BIT_ADR_IADR1) {
-			if (iadr & 0xFFFFFF00) {
-				return (-EADDR);
-			}
-		} else if (mode == I2C_MODE_7BIT_ADR_IADR2 || mode == I2C_MODE_10BIT_ADR_IADR2) {
-			if (iadr & 0xFFFF0000) {
-				return (-EADDR);
-			}
-		} else {
-			if (iadr & 0xFF000000) {
-				return (-EADDR);
-			}
+		if (!chk_iadr(mode, iadr)) {
+			return (-EADDR);
 		}
 	}
 	if (size < 1) {
@@ -397,32 +972,32 @@ int i2c_write(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
 	if (bus->mtx != NULL) {
 		xSemaphoreTake(bus->mtx, portMAX_DELAY);
 	}
-        enable_periph_clk(bus->id);
-	if (bus->ini == 0 || bus->ini == 2) {
-		bus->ini = 1;
-		bus->mmio->TWI_CR = TWI_CR_MSDIS;
-		bus->mmio->TWI_CR = TWI_CR_SVDIS;
-		bus->mmio->TWI_CR = TWI_CR_MSEN;
+	acq_bus(bus);
+	set_mmr(bus, mode, adr, iadr, FALSE);
+        taskENTER_CRITICAL();
+	start_write(bus, p_buf, size, dma);
+        taskEXIT_CRITICAL();
+        if (pdFALSE == xQueueReceive(bus->sig_que, &msg, ms_to_os_ticks(WAIT_INTR_MS))) {
+		tmo_reset(bus);
+		msg = EHW;
 	}
-	if (mode < I2C_MODE_10BIT_ADR) {
-		bus->mmio->TWI_MMR = TWI_MMR_DADR(adr) | mode << 8;
-		if (mode > I2C_MODE_7BIT_ADR) {
-			bus->mmio->TWI_IADR = iadr;
-		}
-	} else {
-		int a = 0x78;
-		a |= adr >> 8;
-                bus->mmio->TWI_MMR = TWI_MMR_DADR(a) | (mode - 3) << 8;
-		if (mode == I2C_MODE_10BIT_ADR) {
-			iadr = adr & 0xFF;
-		} else if (mode == I2C_MODE_10BIT_ADR_IADR1) {
-			iadr |= (adr & 0xFF) << 8;
-		} else {
-			iadr |= (adr & 0xFF) << 16;
-		}
-		bus->mmio->TWI_IADR = iadr;
+	if (msg == 0) {
+		bus->stats.tx_bytes_cnt += size;
 	}
-        taskENTER_CRITICAL();
+	rel_bus(bus);
+	if (bus->mtx != NULL) {
+		xSemaphoreGive(bus->mtx);
+	}
+	return (-msg);
+}
+
+/**
+ * start_write
+ *
+ * Start master write of size bytes (ISR context or task critical section).
+ */
+static void start_write(i2cbus bus, uint8_t *p_buf, int size, boolean_t dma)
+{
 	bus->mmio->TWI_SR;
 	if (bus->dma && dma && size >= 3) {
 		bus->hndlr = i2c_dma_write_hndlr;
@@ -449,27 +1024,95 @@ int i2c_write(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
 			bus->mmio->TWI_IER = TWI_IER_NACK | TWI_IER_TXRDY;
 		}
 	}
+}
+
+/**
+ * i2c_xfer
+ */
+int i2c_xfer(i2cbus bus, struct i2c_msg *msgs, int num)
+{
+	int8_t msg;
+	int ret = 0;
+
+	if (num < 1) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (int i = 0; i < num; i++) {
+		if (msgs[i].size < 1) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		msgs[i].ret = -EINTR;
+	}
+	for (int i = 0; i < num; i++) {
+		if (!chk_iadr(msgs[i].mode, msgs[i].iadr)) {
+			msgs[i].ret = -EADDR;
+			return (-EADDR);
+		}
+	}
+	if (bus->mtx != NULL) {
+		xSemaphoreTake(bus->mtx, portMAX_DELAY);
+	}
+	acq_bus(bus);
+	bus->xmsg = msgs;
+	bus->xnum = num;
+	bus->xidx = 0;
+        taskENTER_CRITICAL();
+	start_msg(bus);
         taskEXIT_CRITICAL();
-        if (pdFALSE == xQueueReceive(bus->sig_que, &msg, ms_to_os_ticks(WAIT_INTR_MS))) {
-		bus->mmio->TWI_IDR = ~0;
-                bus->mmio->TWI_CR = TWI_CR_SWRST;
-		bus->mmio->TWI_CR = TWI_CR_MSDIS;
-		bus->mmio->TWI_CR = TWI_CR_SVDIS;
-		bus->mmio->TWI_SR;
-		set_cwgr(bus);
-		xQueueReceive(bus->sig_que, &msg, 0);
-		bus->ini = 0;
-		bus->stats.intr_tmo_err_cnt++;
-		msg = EHW;
+        if (pdFALSE == xQueueReceive(bus->sig_que, &msg, ms_to_os_ticks(WAIT_INTR_MS * num))) {
+		tmo_reset(bus);
+		msgs[bus->xidx].ret = -EHW;
 	}
-	if (msg == 0) {
-		bus->stats.tx_bytes_cnt += size;
+	bus->xmsg = NULL;
+	for (int i = 0; i < num; i++) {
+		if (msgs[i].ret == 0) {
+			if (msgs[i].rd) {
+				bus->stats.rx_bytes_cnt += msgs[i].size;
+			} else {
+				bus->stats.tx_bytes_cnt += msgs[i].size;
+			}
+		} else if (!ret) {
+			ret = msgs[i].ret;
+		}
 	}
-        disable_periph_clk(bus->id);
+	rel_bus(bus);
 	if (bus->mtx != NULL) {
 		xSemaphoreGive(bus->mtx);
 	}
-	return (-msg);
+	return (ret);
+}
+
+/**
+ * start_msg
+ *
+ * Start message xmsg[xidx] of an i2c_xfer() batch (ISR context or task critical
+ * section). A write of 1..3 bytes followed by a read from the same 7-bit address
+ * is issued as one IADR read, i.e. with a repeated start between both messages.
+ */
+static void start_msg(i2cbus bus)
+{
+	struct i2c_msg *m = bus->xmsg + bus->xidx;
+	int iadr = 0;
+
+	bus->xmrg = FALSE;
+	if (!m->rd && m->mode == I2C_MODE_7BIT_ADR && m->size <= 3 && bus->xidx + 1 < bus->xnum &&
+	    (m + 1)->rd && (m + 1)->mode == I2C_MODE_7BIT_ADR && (m + 1)->adr == m->adr) {
+		for (int i = 0; i < m->size; i++) {
+			iadr = iadr << 8 | m->buf[i];
+		}
+		bus->xmrg = TRUE;
+		bus->xidx++;
+		m++;
+		set_mmr(bus, I2C_MODE_7BIT_ADR + (m - 1)->size, m->adr, iadr, TRUE);
+		start_read(bus, m->buf, m->size, m->dma);
+		return;
+	}
+	set_mmr(bus, m->mode, m->adr, m->iadr, m->rd);
+	if (m->rd) {
+		start_read(bus, m->buf, m->size, m->dma);
+	} else {
+		start_write(bus, m->buf, m->size, m->dma);
+	}
 }
 
 /**
@@ -508,21 +1151,14 @@ i2cbus get_i2cbus_by_per_id(int per_id)
  */
 static BaseType_t i2c_write_hndlr(i2cbus bus)
 {
-	BaseType_t tsk_wkn = pdFALSE;
-        int8_t msg;
-
 	unsigned int sr = bus->mmio->TWI_SR;
 	if (sr & TWI_SR_NACK) {
 		bus->mmio->TWI_IDR = ~0;
-		msg = ENACK;
-                xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
-                return (tsk_wkn);
+                return (trans_end(bus, ENACK));
 	}
 	if (sr & TWI_SR_TXCOMP) {
 		bus->mmio->TWI_IDR = ~0;
-		msg = 0;
-		xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
-                return (tsk_wkn);
+                return (trans_end(bus, 0));
 	}
 	if (sr & TWI_SR_TXRDY) {
 		bus->mmio->TWI_THR = *bus->buf++;
@@ -532,7 +1168,7 @@ static BaseType_t i2c_write_hndlr(i2cbus bus)
 			bus->mmio->TWI_IDR = TWI_IDR_TXRDY;
 		}
 	}
-        return (tsk_wkn);
+        return (pdFALSE);
 }
 
 /**
@@ -540,23 +1176,18 @@ static BaseType_t i2c_write_hndlr(i2cbus bus)
  */
 static BaseType_t i2c_dma_write_hndlr(i2cbus bus)
 {
-	BaseType_t tsk_wkn = pdFALSE;
-        int8_t msg;
-
 	unsigned int sr = bus->mmio->TWI_SR;
 	bus->mmio->TWI_PTCR = TWI_PTCR_TXTDIS;
 	if (sr & TWI_SR_NACK) {
 		bus->mmio->TWI_IDR = ~0;
-		msg = ENACK;
-                xQueueSendFromISR(bus->sig_que, &msg, &tsk_wkn);
-                return (tsk_wkn);
+                return (trans_end(bus, ENACK));
 	}
         if (sr & TWI_SR_ENDTX) {
         	bus->hndlr = i2c_write_hndlr;
 		bus->mmio->TWI_IDR = TWI_IDR_ENDTX;
 		bus->mmio->TWI_IER = TWI_IER_TXRDY;
 	}
-        return (tsk_wkn);
+        return (pdFALSE);
 }
 
 /**
@@ -640,6 +1271,24 @@ void log_i2c_stats(i2cbus bus)
 	vTaskPrioritySet(NULL, pr);
 }
 
+#if I2C_SLV == 1
+/**
+ * log_i2c_slv_stats
+ */
+void log_i2c_slv_stats(i2cbus bus)
+{
+	UBaseType_t pr;
+
+	pr = uxTaskPriorityGet(NULL);
+        vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+        msg(INF, "i2c.c: bus=%s slave cnt: rd_acc=%u rd_bytes=%u rd_pad=%u\n", bus->nm,
+	    bus->slv->stats.rd_acc, bus->slv->stats.rd_bytes, bus->slv->stats.rd_pad);
+        msg(INF, "i2c.c: bus=%s slave cnt: wr_acc=%u wr_bytes=%u wr_drop=%u ovre=%u\n", bus->nm,
+	    bus->slv->stats.wr_acc, bus->slv->stats.wr_bytes, bus->slv->stats.wr_drop, bus->slv->stats.ovre);
+	vTaskPrioritySet(NULL, pr);
+}
+#endif
+
 /**
  * log_i2c_waveform
  */
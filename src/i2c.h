@@ -31,6 +31,21 @@
  *   bytes for 10-bit, as supported by the SAM TWI hardware).
  * - Optional use of PDC/DMA (when available for the particular TWI instance).
  * - Optional mutual exclusion via user-provided FreeRTOS mutex.
+ * - Batched transfers (i2c_xfer()): a list of messages is executed in one locked
+ *   session; each next message is started directly from the TWI interrupt and the
+ *   calling task is woken only once.
+ * - Asynchronous requests (i2c_submit(), I2C_REQ_QUE == 1): message batches are
+ *   queued per bus and executed back-to-back from the TWI interrupt; completion
+ *   is signaled by a callback or a task notification. Blocking calls on the
+ *   same bus wait for the running request only. Stalled requests are aborted
+ *   by a per-bus watchdog timer.
+ * - Slave mode (init_i2c_slv(), I2C_SLV == 1): the bus acts as an I2C peripheral
+ *   exposing a register map. The first byte written by the master is the register
+ *   pointer; following bytes are received by PDC into a staging buffer and passed
+ *   to a callback at the end of the access. Reads are served by PDC directly from
+ *   the application-owned map starting at the pointer, so a block read costs a few
+ *   interrupts regardless of its length. A bus descriptor is used either in master
+ *   or in slave mode.
  *
  * @note The driver intentionally does not validate the slave address @p adr on
  *       every call (caller responsibility). It does validate the *internal*
@@ -44,6 +59,14 @@
  #define I2CBUS 0
 #endif
 
+#ifndef I2C_REQ_QUE
+ #define I2C_REQ_QUE 0
+#endif
+
+#ifndef I2C_SLV
+ #define I2C_SLV 0
+#endif
+
 #if I2CBUS == 1
 
 /**
@@ -77,6 +100,43 @@ enum i2c_mode {
 	I2C_MODE_10BIT_ADR_IADR2
 };
 
+/**
+ * @struct i2c_msg
+ *
+ * @brief One message of an i2c_xfer() batch.
+ */
+struct i2c_msg {
+	enum i2c_mode mode;	/**< Addressing mode. */
+	int adr;		/**< Slave address (7-bit or 10-bit depending on mode). */
+	int iadr;		/**< Internal address (IADR modes only). */
+	boolean_t rd;		/**< TRUE -> read, FALSE -> write. */
+	uint8_t *buf;		/**< Data buffer. */
+	int size;		/**< Number of bytes (must be >= 1). */
+	boolean_t dma;		/**< Request PDC usage (as for i2c_read()/i2c_write()). */
+	int ret;		/**< Message status (return), see i2c_xfer(). */
+};
+
+#if I2C_REQ_QUE == 1
+/**
+ * @struct i2c_req
+ *
+ * @brief Asynchronous request (a batch of messages) for i2c_submit().
+ *
+ * The request and its messages are owned by the driver from i2c_submit() until
+ * completion is signaled.
+ */
+struct i2c_req {
+	struct i2c_msg *msgs;	/**< Set by caller: Messages (executed as by i2c_xfer()). */
+	int num;		/**< Set by caller: Number of messages (>= 1). */
+	/** Set by caller: Completion callback (ISR context), or NULL. */
+	void (*clbk)(struct i2c_req *req, BaseType_t *tsk_wkn);
+	TaskHandle_t tsk;	/**< Set by caller: Task notified (xTaskNotifyGive) if clbk == NULL, or NULL. */
+	void *arg;		/**< Set by caller: Caller context for clbk. */
+	int ret;		/**< Request status (return), as returned by i2c_xfer(). */
+	struct i2c_req *next;
+};
+#endif
+
 /**
  * @typedef i2cbus
  *
@@ -84,6 +144,43 @@ enum i2c_mode {
  */
 typedef struct i2c_dsc *i2cbus;
 
+#if I2C_SLV == 1
+/**
+ * @struct i2c_slv_stats
+ *
+ * @brief Slave mode counters.
+ */
+struct i2c_slv_stats {
+	unsigned int rd_acc;	/**< Master read accesses. */
+	unsigned int rd_bytes;	/**< Bytes read from the map (approximate with PDC). */
+	unsigned int rd_pad;	/**< 0xFF bytes sent after the end of the map. */
+	unsigned int wr_acc;	/**< Master write accesses (including pointer only writes). */
+	unsigned int wr_bytes;	/**< Data bytes passed to wr_clbk. */
+	unsigned int wr_drop;	/**< Bytes dropped because wr_buf was full. */
+	unsigned int ovre;	/**< Receive overruns. */
+};
+
+/**
+ * @struct i2c_slv
+ *
+ * @brief Slave mode configuration and state (referenced by i2c_dsc.slv).
+ */
+struct i2c_slv {
+	int adr;		/**< Set by caller: 7-bit slave address. */
+	const uint8_t *map;	/**< Set by caller: Register map read by the master (zero copy). */
+	int map_size;		/**< Set by caller: Map size in bytes (1..256). */
+	uint8_t *wr_buf;	/**< Set by caller: Staging buffer for written data. */
+	int wr_size;		/**< Set by caller: Size of wr_buf (>= 1). */
+	/** Set by caller: Called from ISR at the end of a write access with data (or NULL). */
+	void (*wr_clbk)(i2cbus bus, int ptr, uint8_t *data, int cnt, BaseType_t *tsk_wkn);
+	int st;
+	int ptr;
+	int pos;
+	boolean_t pdc;
+	struct i2c_slv_stats stats;
+};
+#endif
+
 /**
  * @struct i2c_stats
  *
@@ -124,8 +221,24 @@ struct i2c_dsc {
 	boolean_t ovre;
         QueueHandle_t sig_que;
 	int ini;
+	struct i2c_msg *xmsg;
+	int xnum;
+	int xidx;
+	boolean_t xmrg;
+#if I2C_REQ_QUE == 1
+	struct i2c_req *rq_head;
+	struct i2c_req *rq_tail;
+	struct i2c_req *areq;
+	boolean_t busy;
+	boolean_t wt_idle;
+	unsigned int rq_prog;
+	unsigned int rq_prog_chk;
+#endif
 	struct i2c_stats stats;
 	unsigned int cwgr_reg;
+#if I2C_SLV == 1
+	struct i2c_slv *slv; /**< Slave mode: must be set by the caller before init_i2c_slv(). */
+#endif
 };
 
 /**
@@ -147,6 +260,29 @@ struct i2c_dsc {
  */
 void init_i2c(i2cbus bus);
 
+#if I2C_SLV == 1
+/**
+ * @brief Initialize one TWI instance in slave mode (register map emulation).
+ *
+ * Protocol seen by the master:
+ * - Write: [pointer] [data ...]. The data bytes are stored in slv->wr_buf and
+ *   slv->wr_clbk(bus, pointer, wr_buf, cnt) is called from ISR context at the end
+ *   of the access (STOP or repeated start). Bytes beyond wr_size are dropped.
+ *   The callback is not called for a pointer only write.
+ * - Read: data is sent from map[pointer] on; the pointer is the last value written
+ *   and is not advanced by reads. Bytes past the end of the map read as 0xFF.
+ *
+ * The PDC reads the map while the master clocks it out; the application must
+ * update multi-byte values so that a torn read is harmless or acceptable.
+ *
+ * The peripheral clock stays enabled. bus->id and bus->slv must be set by the
+ * caller; init_i2c() must not be called for the same descriptor.
+ *
+ * @param[in,out] bus Bus descriptor pointer.
+ */
+void init_i2c_slv(i2cbus bus);
+#endif
+
 /**
  * @brief Read bytes from an I2C slave device.
  *
@@ -205,6 +341,61 @@ int i2c_read(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size,
  */
 int i2c_write(i2cbus bus, enum i2c_mode mode, int adr, uint8_t *p_buf, int size, boolean_t dma, ...);
 
+/**
+ * @brief Execute a batch of I2C messages in one locked session.
+ *
+ * The bus mutex is taken and the TWI clock enabled once for the whole batch.
+ * Messages are executed in order, possibly to different slave addresses; the
+ * next message is started from the TWI interrupt as soon as the previous one
+ * completes, so the calling task is blocked and woken only once.
+ *
+ * The SAM TWI master can generate a repeated start only between the internal
+ * address phase and the data phase of one transfer. Therefore a write of 1..3
+ * bytes (mode I2C_MODE_7BIT_ADR) directly followed by a read from the same
+ * address (mode I2C_MODE_7BIT_ADR) is merged into one IADR read, i.e. the
+ * typical "write register pointer, read block" pair is sent with a repeated
+ * start. All other consecutive messages are separated by STOP + START.
+ *
+ * Processing stops at the first failing message.
+ *
+ * @param[in,out] bus  Bus instance.
+ * @param[in,out] msgs Message array; msgs[i].ret receives the status of each
+ *                     message: 0 on success, -ENACK, -EDATA, -EADDR or -EHW as
+ *                     for i2c_read()/i2c_write(), -EINTR if not executed.
+ * @param[in]     num  Number of messages (must be >= 1).
+ *
+ * @return 0 if all messages succeeded; status of the first failing message otherwise.
+ */
+int i2c_xfer(i2cbus bus, struct i2c_msg *msgs, int num);
+
+#if I2C_REQ_QUE == 1
+/**
+ * @brief Queue an asynchronous request (non-blocking).
+ *
+ * The request is appended to the bus queue and started immediately if the bus
+ * is idle. Requests run back-to-back from the TWI interrupt without a task
+ * switch in between. On completion req->ret and msgs[i].ret are set as by
+ * i2c_xfer() and then req->clbk is called from ISR context or, if clbk is NULL,
+ * req->tsk is notified (wait with ulTaskNotifyTake()). The callback must use
+ * only ISR-safe API and must not call i2c_submit(); set *tsk_wkn as for
+ * FreeRTOS FromISR functions.
+ *
+ * A request whose current message does not complete within 1..2 s is failed
+ * with -EINTR by a per-bus watchdog timer (requires configUSE_TIMERS), its
+ * completion is then signaled from the timer task, and the next request is
+ * started. A blocking call on the bus gets the bus after the running request,
+ * before the remaining queued ones.
+ *
+ * Several requests may be in flight on each bus, and on several buses at once.
+ *
+ * @param[in,out] bus Bus instance.
+ * @param[in,out] req Request (must stay valid until completion).
+ *
+ * @return 0 if queued; -EADDR if an internal address does not fit its IADR size.
+ */
+int i2c_submit(i2cbus bus, struct i2c_req *req);
+#endif
+
 /**
  * @brief Obtain the bus descriptor by peripheral ID.
  *
@@ -227,6 +418,15 @@ i2cbus get_i2cbus_by_per_id(int per_id);
  */
 void log_i2c_stats(i2cbus bus);
 
+#if I2C_SLV == 1
+/**
+ * @brief Log slave mode statistics for a bus.
+ *
+ * @param[in] bus Bus instance initialized by init_i2c_slv().
+ */
+void log_i2c_slv_stats(i2cbus bus);
+#endif
+
 /**
  * @brief Log computed I2C waveform timing (SCL frequency, tLOW, tHIGH).
  *
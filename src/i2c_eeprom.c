@@ -0,0 +1,201 @@
+/*
+ * i2c_eeprom.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "atom.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "i2c.h"
+#include "i2c_eeprom.h"
+#include <string.h>
+
+#if I2C_EEPROM == 1
+
+#if I2CBUS != 1
+ #error "I2C_EEPROM requires I2CBUS"
+#endif
+
+static int xfer(i2c_eeprom dev, int adr, uint8_t *buf, int len, boolean_t rd);
+static int chunk_len(i2c_eeprom dev, int adr, int len, boolean_t rd);
+
+/**
+ * init_i2c_eeprom
+ */
+void init_i2c_eeprom(i2c_eeprom dev)
+{
+	if (dev->bus == NULL || dev->size < 1 || dev->adr_bytes < 1 || dev->adr_bytes > 2 ||
+	    (!dev->fram && (dev->page_size < 1 || dev->wr_tmo_ms < 1))) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->wr_pend = FALSE;
+	memset(&dev->stats, 0, sizeof(struct i2c_eeprom_stats));
+}
+
+/**
+ * i2c_eeprom_read
+ */
+int i2c_eeprom_read(i2c_eeprom dev, int adr, uint8_t *buf, int len)
+{
+	int n, ret;
+
+	if (adr < 0 || len < 1 || adr + len > dev->size) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	while (len) {
+		n = chunk_len(dev, adr, len, TRUE);
+		if ((ret = xfer(dev, adr, buf, n, TRUE))) {
+			return (ret);
+		}
+		dev->stats.rd_bytes += n;
+		adr += n;
+		buf += n;
+		len -= n;
+	}
+	return (0);
+}
+
+/**
+ * i2c_eeprom_write
+ */
+int i2c_eeprom_write(i2c_eeprom dev, int adr, uint8_t *buf, int len)
+{
+	TickType_t tm;
+	int n, ret = 0;
+
+	if (adr < 0 || len < 1 || adr + len > dev->size) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	tm = xTaskGetTickCount();
+	while (len) {
+		n = chunk_len(dev, adr, len, FALSE);
+		if ((ret = xfer(dev, adr, buf, n, FALSE))) {
+			break;
+		}
+		if (!dev->fram) {
+			dev->wr_pend = TRUE;
+			dev->wr_tm = xTaskGetTickCount();
+		}
+		dev->stats.wr_pages++;
+		dev->stats.wr_bytes += n;
+		adr += n;
+		buf += n;
+		len -= n;
+	}
+	dev->stats.wr_ticks += xTaskGetTickCount() - tm;
+	return (ret);
+}
+
+/**
+ * i2c_eeprom_sync
+ */
+int i2c_eeprom_sync(i2c_eeprom dev)
+{
+	uint8_t b;
+
+	if (!dev->wr_pend) {
+		return (0);
+	}
+	// Current address read: harmless transfer used as acknowledge poll.
+	return (xfer(dev, -1, &b, 1, TRUE));
+}
+
+/**
+ * chunk_len
+ *
+ * Length of the next transfer: pages for EEPROM writes, device address blocks
+ * (memory address wrap around) otherwise.
+ */
+static int chunk_len(i2c_eeprom dev, int adr, int len, boolean_t rd)
+{
+	int lim;
+
+	lim = (1 << 8 * dev->adr_bytes) - (adr & ((1 << 8 * dev->adr_bytes) - 1));
+	if (!rd && !dev->fram && dev->page_size - adr % dev->page_size < lim) {
+		lim = dev->page_size - adr % dev->page_size;
+	}
+	return ((len < lim) ? len : lim);
+}
+
+/**
+ * xfer
+ *
+ * One transfer; repeated while the device is in its write cycle (NACK). A
+ * negative adr requests a current address read.
+ */
+static int xfer(i2c_eeprom dev, int adr, uint8_t *buf, int len, boolean_t rd)
+{
+	int ret, dadr;
+	enum i2c_mode mode;
+
+	if (adr < 0) {
+		dadr = dev->adr;
+		mode = I2C_MODE_7BIT_ADR;
+		adr = 0;
+	} else {
+		dadr = dev->adr | adr >> 8 * dev->adr_bytes;
+		mode = (dev->adr_bytes == 1) ? I2C_MODE_7BIT_ADR_IADR1 : I2C_MODE_7BIT_ADR_IADR2;
+		adr &= (1 << 8 * dev->adr_bytes) - 1;
+	}
+	while (TRUE) {
+		if (rd) {
+			ret = i2c_read(dev->bus, mode, dadr, buf, len, DMA_ON, adr);
+		} else {
+			ret = i2c_write(dev->bus, mode, dadr, buf, len, DMA_ON, adr);
+		}
+		if (ret != -ENACK || !dev->wr_pend) {
+			break;
+		}
+		if (xTaskGetTickCount() - dev->wr_tm > (TickType_t) ms_to_os_ticks(dev->wr_tmo_ms)) {
+			dev->stats.tmo++;
+			break;
+		}
+		dev->stats.polls++;
+	}
+	dev->wr_pend = FALSE;
+	return (ret);
+}
+
+#if TERMOUT == 1
+/**
+ * log_i2c_eeprom_stats
+ */
+void log_i2c_eeprom_stats(i2c_eeprom dev, const char *nm)
+{
+	UBaseType_t pr;
+	unsigned int ms;
+
+	pr = uxTaskPriorityGet(NULL);
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	ms = dev->stats.wr_ticks * portTICK_PERIOD_MS;
+	msg(INF, "i2c_eeprom.c: dev=%s rd_bytes=%u wr_bytes=%u wr_pages=%u\n", nm, dev->stats.rd_bytes,
+	    dev->stats.wr_bytes, dev->stats.wr_pages);
+	msg(INF, "i2c_eeprom.c: dev=%s polls=%u tmo=%u wr=%u B/s\n", nm, dev->stats.polls, dev->stats.tmo,
+	    (ms) ? (unsigned int) ((uint64_t) dev->stats.wr_bytes * 1000 / ms) : 0);
+	vTaskPrioritySet(NULL, pr);
+}
+#endif
+
+#endif
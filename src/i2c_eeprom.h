@@ -0,0 +1,142 @@
+/*
+ * i2c_eeprom.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file i2c_eeprom.h
+ *
+ * @brief 24Cxx EEPROM / I2C FRAM driver on top of the I2C master driver.
+ *
+ * Key characteristics:
+ * - Writes of any length are split on page boundaries.
+ * - EEPROM write cycle: instead of a fixed delay after each page, the next page
+ *   write (or read) is simply issued and repeated while the device answers its
+ *   address with NACK (acknowledge polling), so it starts the instant the
+ *   internal write cycle has finished.
+ * - Sequential reads of any length are split only on device address block
+ *   boundaries and use the TWI PDC.
+ * - Memory address bits above the 1 or 2 address bytes are placed into the low
+ *   bits of the device address (24C04..24C16, 24CM01/24CM02 style).
+ * - FRAM (fram == TRUE) has no page buffer and no write cycle: writes are split
+ *   only on address block boundaries and no polling is done.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when I2C_EEPROM == 1 (requires
+ *   I2CBUS == 1).
+ */
+
+#ifndef I2C_EEPROM_H
+#define I2C_EEPROM_H
+
+#ifndef I2C_EEPROM
+ #define I2C_EEPROM 0
+#endif
+
+#if I2C_EEPROM == 1
+
+/**
+ * @struct i2c_eeprom_stats
+ *
+ * @brief Cumulative counters of one device.
+ */
+struct i2c_eeprom_stats {
+	unsigned int rd_bytes;	/**< Bytes read. */
+	unsigned int wr_bytes;	/**< Bytes written. */
+	unsigned int wr_pages;	/**< Page (chunk) writes. */
+	unsigned int wr_ticks;	/**< Time spent in i2c_eeprom_write() (OS ticks). */
+	unsigned int polls;	/**< Transfers repeated because the device was busy (NACK). */
+	unsigned int tmo;	/**< Write cycles not finished within wr_tmo_ms. */
+};
+
+typedef struct i2c_eeprom_dsc *i2c_eeprom;
+
+/**
+ * @struct i2c_eeprom_dsc
+ *
+ * @brief Device descriptor.
+ */
+struct i2c_eeprom_dsc {
+	i2cbus bus;		/**< Set by caller: I2C bus (initialized by init_i2c()). */
+	int adr;		/**< Set by caller: 7-bit device address (e.g., 0x50). */
+	int size;		/**< Set by caller: Memory size in bytes. */
+	int page_size;		/**< Set by caller: Write page size in bytes (EEPROM only). */
+	int adr_bytes;		/**< Set by caller: Number of memory address bytes (1 or 2). */
+	boolean_t fram;		/**< Set by caller: TRUE for FRAM (no paging, no write cycle). */
+	int wr_tmo_ms;		/**< Set by caller: Maximum write cycle time in ms (EEPROM only). */
+	boolean_t wr_pend;
+	TickType_t wr_tm;
+	struct i2c_eeprom_stats stats;
+};
+
+/**
+ * @brief Check the descriptor and reset counters.
+ *
+ * @param dev Device descriptor.
+ */
+void init_i2c_eeprom(i2c_eeprom dev);
+
+/**
+ * @brief Read len bytes from memory address adr.
+ *
+ * @param dev Device descriptor.
+ * @param adr Memory address.
+ * @param buf Destination buffer.
+ * @param len Number of bytes (adr + len must not exceed dev->size).
+ *
+ * @return 0 on success; -ENACK if the device did not respond within the write
+ *         cycle timeout; other error codes as returned by i2c_read().
+ */
+int i2c_eeprom_read(i2c_eeprom dev, int adr, uint8_t *buf, int len);
+
+/**
+ * @brief Write len bytes to memory address adr.
+ *
+ * Returns as soon as the last page was transferred; its write cycle is
+ * finished by the next access (or by i2c_eeprom_sync()).
+ *
+ * @param dev Device descriptor.
+ * @param adr Memory address.
+ * @param buf Source buffer.
+ * @param len Number of bytes (adr + len must not exceed dev->size).
+ *
+ * @return 0 on success; -ENACK if the device did not respond within the write
+ *         cycle timeout; other error codes as returned by i2c_write().
+ */
+int i2c_eeprom_write(i2c_eeprom dev, int adr, uint8_t *buf, int len);
+
+/**
+ * @brief Wait until the write cycle of the last page has finished.
+ *
+ * @param dev Device descriptor.
+ *
+ * @return 0 on success; -ENACK on write cycle timeout.
+ */
+int i2c_eeprom_sync(i2c_eeprom dev);
+
+#if TERMOUT == 1
+/**
+ * @brief Log device counters and achieved write throughput (terminal output).
+ *
+ * @param dev Device descriptor.
+ * @param nm  Device name used in the output.
+ */
+void log_i2c_eeprom_stats(i2c_eeprom dev, const char *nm);
+#endif
+
+#endif
+
+#endif
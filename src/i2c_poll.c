@@ -0,0 +1,310 @@
+/*
+ * i2c_poll.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "atom.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "i2c.h"
+#include "i2c_poll.h"
+#include <string.h>
+
+#if I2C_POLL == 1
+
+#if I2CBUS != 1 || I2C_REQ_QUE != 1
+ #error "I2C_POLL requires I2CBUS and I2C_REQ_QUE"
+#endif
+
+#define IDLE_MS 100
+#define WAIT_REQ_MS 1000
+
+static TaskHandle_t tsk_hndl;
+static const char *const tsk_nm = "I2CPOLL";
+static struct i2c_poll_sns *sns_list;
+
+static void poll_tsk(void *p);
+static void req_clbk(struct i2c_req *req, BaseType_t *tsk_wkn);
+static void stall(void);
+static void give_up(void);
+static int issue(TickType_t now);
+static void publish(TickType_t now);
+
+/**
+ * init_i2c_poll
+ */
+void init_i2c_poll(void)
+{
+	if (pdPASS != xTaskCreate(poll_tsk, tsk_nm, I2C_POLL_TASK_STACK_SIZE, NULL,
+                                  I2C_POLL_TASK_PRIO, &tsk_hndl)) {
+                crit_err_exit(MALLOC_ERROR);
+        }
+}
+
+/**
+ * add_i2c_poll_sns
+ */
+void add_i2c_poll_sns(i2c_poll_sns sns)
+{
+	if (sns->size < 1 || sns->buf[0] == NULL || sns->buf[1] == NULL || sns->period_ms < 1) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	sns->msg.mode = sns->mode;
+	sns->msg.adr = sns->adr;
+	sns->msg.iadr = sns->iadr;
+	sns->msg.rd = TRUE;
+	sns->msg.size = sns->size;
+	sns->msg.dma = DMA_ON;
+	sns->req.msgs = &sns->msg;
+	sns->req.num = 1;
+	sns->req.clbk = req_clbk;
+	sns->req.arg = sns;
+	sns->per = ms_to_os_ticks(sns->period_ms);
+	sns->act = sns->done = sns->orph = FALSE;
+	sns->rdy = 0;
+	sns->seq = 0;
+	memset(&sns->stats, 0, sizeof(struct i2c_poll_stats));
+	taskENTER_CRITICAL();
+	sns->due = xTaskGetTickCount();
+	sns->next = sns_list;
+	sns_list = sns;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * i2c_poll_get
+ */
+unsigned int i2c_poll_get(i2c_poll_sns sns, uint8_t *dst, TickType_t *tm)
+{
+	unsigned int seq;
+	int idx;
+
+	do {
+		seq = sns->seq;
+		if (seq == 0) {
+			return (0);
+		}
+		barrier();
+		idx = sns->rdy;
+		memcpy(dst, sns->buf[idx], sns->size);
+		if (tm != NULL) {
+			*tm = sns->tm[idx];
+		}
+		barrier();
+	} while (seq != sns->seq);
+	return (seq);
+}
+
+/**
+ * poll_tsk
+ */
+static void poll_tsk(void *p)
+{
+	struct i2c_poll_sns *s;
+	TickType_t now, dly;
+	int n, tmo;
+
+	while (TRUE) {
+		n = issue(xTaskGetTickCount());
+		for (tmo = 0; n;) {
+			if (ulTaskNotifyTake(pdFALSE, ms_to_os_ticks(WAIT_REQ_MS))) {
+				n--;
+			} else {
+				stall();
+				if (++tmo == I2C_POLL_STALL_MAX) {
+					give_up();
+					n = 0;
+				}
+			}
+		}
+		now = xTaskGetTickCount();
+		publish(now);
+		dly = ms_to_os_ticks(IDLE_MS);
+		for (s = sns_list; s != NULL; s = s->next) {
+			// Orphaned sensors are not issued until their read ends.
+			if (s->orph) {
+				continue;
+			}
+			if ((int) (s->due - now) <= 0) {
+				dly = 0;
+				break;
+			}
+			if (s->due - now < dly) {
+				dly = s->due - now;
+			}
+		}
+		if (dly) {
+			vTaskDelay(dly);
+		}
+	}
+}
+
+/**
+ * req_clbk
+ */
+static void req_clbk(struct i2c_req *req, BaseType_t *tsk_wkn)
+{
+	struct i2c_poll_sns *s = req->arg;
+
+	if (s->orph) {
+		// Round was given up, the sensor may be issued again.
+		s->orph = FALSE;
+	} else {
+		s->done = TRUE;
+		vTaskNotifyGiveFromISR(tsk_hndl, tsk_wkn);
+	}
+}
+
+/**
+ * stall
+ *
+ * Count a read wait timeout for every sensor still outstanding.
+ */
+static void stall(void)
+{
+	struct i2c_poll_sns *s;
+
+	taskENTER_CRITICAL();
+	for (s = sns_list; s != NULL; s = s->next) {
+		if (s->act && !s->done) {
+			s->stats.stall++;
+		}
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * give_up
+ *
+ * Stop waiting for reads outstanding after I2C_POLL_STALL_MAX timeouts.
+ */
+static void give_up(void)
+{
+	struct i2c_poll_sns *s;
+
+	taskENTER_CRITICAL();
+	for (s = sns_list; s != NULL; s = s->next) {
+		if (s->act && !s->done) {
+			s->act = FALSE;
+			s->orph = TRUE;
+			s->stats.err++;
+		}
+	}
+	taskEXIT_CRITICAL();
+	// Drop notifications of reads completed meanwhile (still published).
+	ulTaskNotifyTake(pdTRUE, 0);
+}
+
+/**
+ * issue
+ *
+ * Submit reads of all sensors due within the coalescing window.
+ */
+static int issue(TickType_t now)
+{
+	struct i2c_poll_sns *s;
+	int n = 0, d;
+
+	for (s = sns_list; s != NULL; s = s->next) {
+		d = now - s->due;
+		if (d < -(int) ms_to_os_ticks(I2C_POLL_COAL_MS) || s->orph) {
+			continue;
+		}
+		if (s->stats.smpl + s->stats.nack + s->stats.err == 0) {
+			s->stats.jit_min = s->stats.jit_max = d;
+		} else if (d < s->stats.jit_min) {
+			s->stats.jit_min = d;
+		} else if (d > s->stats.jit_max) {
+			s->stats.jit_max = d;
+		}
+		s->stats.jit_abs += (d < 0) ? -d : d;
+		s->due += s->per;
+		if ((int) (s->due - now) <= 0) {
+			s->stats.miss += (now - s->due) / s->per + 1;
+			s->due = now + s->per;
+		}
+		s->msg.buf = s->buf[s->rdy ^ 1];
+		s->done = FALSE;
+		if (i2c_submit(s->bus, &s->req)) {
+			s->stats.err++;
+			continue;
+		}
+		s->act = TRUE;
+		n++;
+	}
+	return (n);
+}
+
+/**
+ * publish
+ *
+ * Flip result buffers of successfully read sensors.
+ */
+static void publish(TickType_t now)
+{
+	struct i2c_poll_sns *s;
+
+	for (s = sns_list; s != NULL; s = s->next) {
+		if (!s->act || !s->done) {
+			continue;
+		}
+		s->act = FALSE;
+		if (s->req.ret == 0) {
+			s->tm[s->rdy ^ 1] = now;
+			s->rdy ^= 1;
+			barrier();
+			if (++s->seq == 0) {
+				s->seq = 1;
+			}
+			s->stats.smpl++;
+		} else if (s->req.ret == -ENACK) {
+			s->stats.nack++;
+		} else {
+			s->stats.err++;
+		}
+	}
+}
+
+#if TERMOUT == 1
+/**
+ * log_i2c_poll_stats
+ */
+void log_i2c_poll_stats(i2c_poll_sns sns, const char *nm)
+{
+	struct i2c_poll_stats st;
+	unsigned int cnt;
+
+	taskENTER_CRITICAL();
+	st = sns->stats;
+	taskEXIT_CRITICAL();
+	cnt = st.smpl + st.nack + st.err;
+	msg(INF, "i2c_poll.c: sns=%s smpl=%u nack=%u err=%u miss=%u stall=%u\n", nm, st.smpl, st.nack,
+	    st.err, st.miss, st.stall);
+	msg(INF, "i2c_poll.c: sns=%s jitter min=%d max=%d mean_abs=%u (ticks)\n", nm, st.jit_min, st.jit_max,
+	    (cnt) ? st.jit_abs / cnt : 0);
+}
+#endif
+
+#endif
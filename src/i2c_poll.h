@@ -0,0 +1,145 @@
+/*
+ * i2c_poll.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file i2c_poll.h
+ *
+ * @brief Periodic I2C sensor polling scheduler.
+ *
+ * One engine task reads all registered sensors at their periods instead of one
+ * task (and stack) per sensor. Each sensor read is one I2C read transfer with
+ * optional internal address (the usual "register pointer + block read").
+ *
+ * Key characteristics:
+ * - Coalescing: all sensors due within I2C_POLL_COAL_MS are issued in one round
+ *   as asynchronous requests (i2c_submit()), so transfers on different TWI
+ *   instances run in parallel and the engine wakes once per round.
+ * - Double-buffered results: a sample is read into the back buffer and
+ *   published by flipping the buffers. i2c_poll_get() never blocks; it retries
+ *   the copy if a new sample was published meanwhile.
+ * - A round waits at most I2C_POLL_STALL_MAX * 1 s for its reads. Reads still
+ *   outstanding then are counted as errors and their sensors skip further
+ *   rounds until the I2C driver completes or aborts the request.
+ * - Per-sensor statistics: samples, NACKs, other errors, missed periods and
+ *   start time jitter (issue time minus due time, in OS ticks; negative when
+ *   issued early by coalescing).
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when I2C_POLL == 1. Requires
+ *   I2CBUS == 1 and I2C_REQ_QUE == 1.
+ * - I2C_POLL_TASK_STACK_SIZE and I2C_POLL_TASK_PRIO must be defined in sysconf.h.
+ */
+
+#ifndef I2C_POLL_H
+#define I2C_POLL_H
+
+#ifndef I2C_POLL
+ #define I2C_POLL 0
+#endif
+
+#ifndef I2C_POLL_COAL_MS
+ #define I2C_POLL_COAL_MS 2
+#endif
+
+#ifndef I2C_POLL_STALL_MAX
+ #define I2C_POLL_STALL_MAX 3
+#endif
+
+#if I2C_POLL == 1
+
+/**
+ * @struct i2c_poll_stats
+ *
+ * @brief Per-sensor counters.
+ */
+struct i2c_poll_stats {
+	unsigned int smpl;	/**< Published samples. */
+	unsigned int nack;	/**< Reads failed with -ENACK. */
+	unsigned int err;	/**< Reads failed otherwise. */
+	unsigned int miss;	/**< Periods skipped because the engine was late. */
+	unsigned int stall;	/**< Read wait timeouts while this sensor was outstanding. */
+	int jit_min;		/**< Minimal issue time - due time (ticks). */
+	int jit_max;		/**< Maximal issue time - due time (ticks). */
+	unsigned int jit_abs;	/**< Sum of |issue time - due time| (ticks). */
+};
+
+typedef struct i2c_poll_sns *i2c_poll_sns;
+
+/**
+ * @struct i2c_poll_sns
+ *
+ * @brief Sensor descriptor.
+ */
+struct i2c_poll_sns {
+	i2cbus bus;		/**< Set by caller: I2C bus. */
+	enum i2c_mode mode;	/**< Set by caller: Addressing mode. */
+	int adr;		/**< Set by caller: Slave address. */
+	int iadr;		/**< Set by caller: Internal address (IADR modes only). */
+	int size;		/**< Set by caller: Bytes to read (>= 1). */
+	uint8_t *buf[2];	/**< Set by caller: Two result buffers of size bytes. */
+	int period_ms;		/**< Set by caller: Read period in ms. */
+	struct i2c_msg msg;
+	struct i2c_req req;
+	TickType_t due;
+	TickType_t per;
+	boolean_t act;
+	volatile boolean_t done;
+	volatile boolean_t orph;
+	volatile int rdy;
+	volatile unsigned int seq;
+	TickType_t tm[2];
+	struct i2c_poll_stats stats;
+	struct i2c_poll_sns *next;
+};
+
+/**
+ * @brief Create the engine task.
+ */
+void init_i2c_poll(void);
+
+/**
+ * @brief Register a sensor; the first read is issued in the next round.
+ *
+ * @param sns Sensor descriptor (must stay valid).
+ */
+void add_i2c_poll_sns(i2c_poll_sns sns);
+
+/**
+ * @brief Copy the latest sample (non-blocking).
+ *
+ * @param sns Sensor descriptor.
+ * @param dst Destination of sns->size bytes.
+ * @param tm  Sample time in OS ticks (return), or NULL.
+ *
+ * @return Sample sequence number; 0 if no sample is available yet (dst unchanged).
+ */
+unsigned int i2c_poll_get(i2c_poll_sns sns, uint8_t *dst, TickType_t *tm);
+
+#if TERMOUT == 1
+/**
+ * @brief Log sensor counters (terminal output).
+ *
+ * @param sns Sensor descriptor.
+ * @param nm  Sensor name used in the output.
+ */
+void log_i2c_poll_stats(i2c_poll_sns sns, const char *nm);
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * sd_bench.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "hsmci_sd.h"
+#include "hsmci_cmd.h"
+#include "sd_card.h"
+#include "sd_bench.h"
+#include <string.h>
+
+#if SD_BENCH == 1
+
+#if SD_CARD != 1
+ #error "SD_BENCH requires SD_CARD"
+#endif
+
+#define CLK_DEFAULT 25000000
+#define MAX_DIRECT_BLK 511
+
+static uint32_t lat[SD_BENCH_LAT_N];
+static uint32_t rnd;
+
+static void run_wr(size_t lba, const void *buf, int block_cnt, int total_blk, struct sd_bench_res *res);
+static int xfer(boolean_t wr, size_t lba, int block_cnt, void *buf, int buf_blk);
+static int xfer_blk(boolean_t wr, size_t lba, int block_cnt, void *buf, int buf_blk);
+static void sort_lat(uint32_t *v, int n);
+static uint32_t next_rnd(void);
+static void dwt_on(void);
+static uint32_t dwt_cyc(void);
+static unsigned int cyc_to_us(uint32_t cyc);
+
+/**
+ * sd_bench_wr_opt
+ */
+void sd_bench_wr_opt(struct sd_card *card, size_t lba, const void *buf, int block_cnt, int total_blk,
+		     struct sd_bench_res *res)
+{
+	static const unsigned int opt[SD_BENCH_WR_CFG_NUM] = {
+		0,
+		HSMCI_WR_OPT_PRE_ERASE,
+		HSMCI_WR_OPT_BLK_CNT,
+		HSMCI_WR_OPT_PRE_ERASE | HSMCI_WR_OPT_BLK_CNT
+	};
+
+	if (block_cnt < 2 || block_cnt > 511 || total_blk < block_cnt) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dwt_on();
+	// Write options are global, keep other card users out until restored.
+	hsmci_lock();
+	for (int i = 0; i < SD_BENCH_WR_CFG_NUM; i++) {
+		memset(&res[i], 0, sizeof(struct sd_bench_res));
+		if ((opt[i] & HSMCI_WR_OPT_BLK_CNT) && !card->cmd23) {
+			res[i].ret = -ENRDY;
+			continue;
+		}
+		hsmci_set_write_opt(card->rca, opt[i]);
+		run_wr(lba, buf, block_cnt, total_blk, &res[i]);
+	}
+	hsmci_set_write_opt(card->rca, HSMCI_WR_OPT_PRE_ERASE | ((card->cmd23) ? HSMCI_WR_OPT_BLK_CNT : 0));
+	hsmci_unlock();
+}
+
+/**
+ * sd_bench_set_bus
+ */
+int sd_bench_set_bus(struct sd_card *card, int bus_width, unsigned int clk_hz, unsigned int *clk_hz_set)
+{
+	hsmci_resp_t resp;
+	unsigned int clk;
+	int ret;
+
+	if ((bus_width != 1 && bus_width != 4) || bus_width > card->bus_width || clk_hz > card->clk_hz) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	hsmci_lock();
+	if ((ret = hsmci_send_cmd(SDMMC_CMD55_APP_CMD, (unsigned int) card->rca << 16, &resp))) {
+		hsmci_unlock();
+		return (ret);
+	}
+	// ACMD6 argument: 0 -> 1 bit, 2 -> 4 bit.
+	if ((ret = hsmci_send_cmd(SD_ACMD6_SET_BUS_WIDTH, (bus_width == 4) ? 2 : 0, &resp))) {
+		hsmci_unlock();
+		return (ret);
+	}
+	if (resp.r1 & CARD_STATUS_ERR_RD_WR) {
+		hsmci_unlock();
+		return (-EHW);
+	}
+	hsmci_set_bus_width((bus_width == 4) ? HSMCI_BUS_WIDTH_4 : HSMCI_BUS_WIDTH_1);
+	hsmci_set_clock(clk_hz, &clk, FALSE);
+	hsmci_unlock();
+	if (clk_hz_set) {
+		*clk_hz_set = clk;
+	}
+	return (0);
+}
+
+/**
+ * sd_bench_run
+ */
+void sd_bench_run(enum sd_bench_pat pat, size_t lba, size_t range_blk, int block_cnt, void *buf, int buf_blk,
+		  struct sd_bench_lat *res)
+{
+	dwt_on();
+	sd_bench_run_io(xfer, dwt_cyc, SystemCoreClock, pat, lba, range_blk, block_cnt, buf, buf_blk, res);
+}
+
+/**
+ * sd_bench_run_io
+ */
+void sd_bench_run_io(sd_bench_xfer io, sd_bench_tm tm, uint32_t tm_hz, enum sd_bench_pat pat, size_t lba,
+		     size_t range_blk, int block_cnt, void *buf, int buf_blk, struct sd_bench_lat *res)
+{
+	boolean_t wr = pat == SD_BENCH_SEQ_WR || pat == SD_BENCH_RND_WR;
+	size_t slots, pos = 0;
+	uint32_t c0;
+	int n, ret = 0;
+
+	if (block_cnt < 1 || block_cnt > 0xFFFF || range_blk < (size_t) block_cnt || buf_blk < 1 ||
+	    buf_blk > MAX_DIRECT_BLK) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	slots = range_blk / block_cnt;
+	rnd = 0x2545F491;
+	for (n = 0; n < SD_BENCH_LAT_N; n++) {
+		if (pat == SD_BENCH_RND_RD || pat == SD_BENCH_RND_WR) {
+			pos = next_rnd() % slots;
+		}
+		c0 = (*tm)();
+		if ((ret = (*io)(wr, lba + pos * block_cnt, block_cnt, buf, buf_blk))) {
+			break;
+		}
+		lat[n] = (*tm)() - c0;
+		if (++pos == slots) {
+			pos = 0;
+		}
+	}
+	sd_bench_lat_calc(lat, n, block_cnt, tm_hz, res);
+	res->ret = ret;
+}
+
+/**
+ * sd_bench_lat_calc
+ */
+void sd_bench_lat_calc(uint32_t *cyc, int n, int block_cnt, uint32_t cyc_hz, struct sd_bench_lat *res)
+{
+	uint64_t cyc_sum = 0;
+
+	memset(res, 0, sizeof(struct sd_bench_lat));
+	res->cmd = n;
+	if (n == 0) {
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		cyc_sum += cyc[i];
+	}
+	sort_lat(cyc, n);
+	res->p50_us = (uint64_t) cyc[(n * 50 + 99) / 100 - 1] * 1000000 / cyc_hz;
+	res->p90_us = (uint64_t) cyc[(n * 90 + 99) / 100 - 1] * 1000000 / cyc_hz;
+	res->p99_us = (uint64_t) cyc[(n * 99 + 99) / 100 - 1] * 1000000 / cyc_hz;
+	res->max_us = (uint64_t) cyc[n - 1] * 1000000 / cyc_hz;
+	// kB/s = bytes / 1000 / (cyc / cyc_hz)
+	if (cyc_sum) {
+		res->kbps = (uint64_t) n * block_cnt * 512 * (cyc_hz / 1000) / cyc_sum;
+	}
+}
+
+/**
+ * run_wr
+ *
+ * Caller holds the driver lock.
+ */
+static void run_wr(size_t lba, const void *buf, int block_cnt, int total_blk, struct sd_bench_res *res)
+{
+	TickType_t t0;
+	uint32_t c0, cyc;
+
+	t0 = xTaskGetTickCount();
+	while (res->blk + block_cnt <= (unsigned int) total_blk) {
+		c0 = DWT->CYCCNT;
+		if ((res->ret = hsmci_write_blocks(lba + res->blk, block_cnt, buf))) {
+			break;
+		}
+		cyc = DWT->CYCCNT - c0;
+		if (cyc_to_us(cyc) > res->lat_max_us) {
+			res->lat_max_us = cyc_to_us(cyc);
+		}
+		res->blk += block_cnt;
+	}
+	res->ms = (xTaskGetTickCount() - t0) * portTICK_PERIOD_MS;
+	if (res->ms) {
+		res->kbps = (unsigned int) ((uint64_t) res->blk * 512 / res->ms);
+	}
+}
+
+/**
+ * xfer
+ */
+static int xfer(boolean_t wr, size_t lba, int block_cnt, void *buf, int buf_blk)
+{
+	int ret;
+
+	// A stream must not interleave with commands of other card users.
+	hsmci_lock();
+	ret = xfer_blk(wr, lba, block_cnt, buf, buf_blk);
+	hsmci_unlock();
+	return (ret);
+}
+
+/**
+ * xfer_blk
+ *
+ * Commands longer than the buffer run as a stream reusing the buffer.
+ */
+static int xfer_blk(boolean_t wr, size_t lba, int block_cnt, void *buf, int buf_blk)
+{
+	const void *wr_done;
+	void *rd_done;
+	int n, cnt, ret;
+
+	if (block_cnt <= buf_blk) {
+		if (wr) {
+			return (hsmci_write_blocks(lba, block_cnt, buf));
+		} else {
+			return (hsmci_read_blocks(lba, block_cnt, buf));
+		}
+	}
+	if (wr) {
+		ret = hsmci_stream_write_begin(lba, buf, buf_blk);
+	} else {
+		ret = hsmci_stream_read_begin(lba, buf, buf_blk);
+	}
+	if (ret) {
+		return (ret);
+	}
+	for (cnt = buf_blk; cnt < block_cnt; cnt += n) {
+		n = (block_cnt - cnt < buf_blk) ? block_cnt - cnt : buf_blk;
+		if (wr) {
+			ret = hsmci_stream_write_next(buf, n, &wr_done);
+		} else {
+			ret = hsmci_stream_read_next(buf, n, &rd_done);
+		}
+		if (ret) {
+			return (ret);
+		}
+	}
+	if (wr) {
+		return (hsmci_stream_write_end());
+	} else {
+		return (hsmci_stream_read_end(&rd_done));
+	}
+}
+
+/**
+ * sort_lat
+ */
+static void sort_lat(uint32_t *v, int n)
+{
+	uint32_t t;
+	int i, j;
+
+	for (i = 1; i < n; i++) {
+		t = v[i];
+		for (j = i; j > 0 && v[j - 1] > t; j--) {
+			v[j] = v[j - 1];
+		}
+		v[j] = t;
+	}
+}
+
+/**
+ * next_rnd
+ *
+ * Xorshift32.
+ */
+static uint32_t next_rnd(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	return (rnd);
+}
+
+/**
+ * dwt_on
+ */
+static void dwt_on(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * dwt_cyc
+ */
+static uint32_t dwt_cyc(void)
+{
+	return (DWT->CYCCNT);
+}
+
+/**
+ * cyc_to_us
+ */
+static unsigned int cyc_to_us(uint32_t cyc)
+{
+	return ((uint64_t) cyc * 1000000 / SystemCoreClock);
+}
+
+#if TERMOUT == 1
+/**
+ * log_sd_bench_suite
+ */
+void log_sd_bench_suite(struct sd_card *card, size_t lba, size_t range_blk, void *buf, int buf_blk)
+{
+	static const char *const pat_str[SD_BENCH_PAT_NUM] = {"seq_rd", "seq_wr", "rnd_rd", "rnd_wr"};
+	static const int blk[] = {1, 8, 64, 256};
+	struct sd_bench_lat res;
+	int width[3];
+	unsigned int clk[3], clk_set;
+	int bus_cnt = 0, ret;
+
+	width[bus_cnt] = card->bus_width;
+	clk[bus_cnt++] = card->clk_hz;
+	if (card->clk_hz > CLK_DEFAULT) {
+		width[bus_cnt] = card->bus_width;
+		clk[bus_cnt++] = CLK_DEFAULT;
+	}
+	if (card->bus_width == 4) {
+		width[bus_cnt] = 1;
+		clk[bus_cnt++] = (card->clk_hz > CLK_DEFAULT) ? CLK_DEFAULT : card->clk_hz;
+	}
+	for (int b = 0; b < bus_cnt; b++) {
+		if ((ret = sd_bench_set_bus(card, width[b], clk[b], &clk_set))) {
+			msg(INF, "sd_bench.c: bus %d bit: %s\n", width[b], hwerr_str(ret));
+			break;
+		}
+		msg(INF, "sd_bench.c: bus %d bit %u Hz\n", width[b], clk_set);
+		for (unsigned int i = 0; i < sizeof(blk) / sizeof(blk[0]); i++) {
+			for (int p = 0; p < SD_BENCH_PAT_NUM; p++) {
+				sd_bench_run(p, lba, range_blk, blk[i], buf, buf_blk, &res);
+				if (res.ret) {
+					msg(INF, "sd_bench.c: %s blk=%d: %s\n", pat_str[p], blk[i], hwerr_str(res.ret));
+				} else {
+					msg(INF, "sd_bench.c: %s blk=%d kB/s=%u p50=%u p90=%u p99=%u max=%u us\n",
+					    pat_str[p], blk[i], res.kbps, res.p50_us, res.p90_us, res.p99_us,
+					    res.max_us);
+				}
+			}
+		}
+	}
+	if ((ret = sd_bench_set_bus(card, card->bus_width, card->clk_hz, NULL))) {
+		msg(INF, "sd_bench.c: bus restore: %s\n", hwerr_str(ret));
+	}
+}
+
+/**
+ * log_sd_bench_wr_opt
+ */
+void log_sd_bench_wr_opt(struct sd_card *card, size_t lba, const void *buf, int block_cnt, int total_blk)
+{
+	static const char *const cfg_str[SD_BENCH_WR_CFG_NUM] = {"CMD25+CMD12", "ACMD23+CMD25+CMD12",
+								 "CMD23+CMD25", "ACMD23+CMD23+CMD25"};
+	struct sd_bench_res res[SD_BENCH_WR_CFG_NUM];
+
+	sd_bench_wr_opt(card, lba, buf, block_cnt, total_blk, res);
+	for (int i = 0; i < SD_BENCH_WR_CFG_NUM; i++) {
+		if (res[i].ret) {
+			msg(INF, "sd_bench.c: %s: %s\n", cfg_str[i], hwerr_str(res[i].ret));
+		} else {
+			msg(INF, "sd_bench.c: %s: blk=%u ms=%u kB/s=%u lat_max_us=%u\n", cfg_str[i], res[i].blk,
+			    res[i].ms, res[i].kbps, res[i].lat_max_us);
+		}
+	}
+}
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * sd_bench.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file sd_bench.h
+ *
+ * @brief On-target SD card throughput and latency benchmarks.
+ *
+ * The benchmarks access the card directly through hsmci_read_blocks() and
+ * hsmci_write_blocks() under hsmci_lock(); the tested LBA range is
+ * overwritten by write tests. Command latency is measured with the DWT cycle
+ * counter. sd_bench_run_io() takes the block transfer and the timestamp
+ * source as function pointers and sd_bench_lat_calc() computes the
+ * statistics without hardware access, so the benchmark runs also on the host
+ * against the simulated card of test/hsmci_sim.c.
+ *
+ * - sd_bench_wr_opt() compares multi-block write command variants.
+ * - sd_bench_run() measures sequential/random read/write throughput and
+ *   latency percentiles of one block count; log_sd_bench_suite() runs it for
+ *   block counts 1, 8, 64, 256 and several bus settings.
+ * - Commands longer than the caller buffer are executed as streams
+ *   (hsmci_stream_*()) recycling the buffer, so a 256-block command does not
+ *   need 128 kB of RAM.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when SD_BENCH == 1. Requires
+ *   SD_CARD == 1.
+ */
+
+#ifndef SD_BENCH_H
+#define SD_BENCH_H
+
+#ifndef SD_BENCH
+ #define SD_BENCH 0
+#endif
+
+#ifndef SD_BENCH_LAT_N
+ #define SD_BENCH_LAT_N 64
+#endif
+
+#if SD_BENCH == 1
+
+/**
+ * @brief Access patterns of sd_bench_run().
+ */
+enum sd_bench_pat {
+	SD_BENCH_SEQ_RD,	/**< Sequential read. */
+	SD_BENCH_SEQ_WR,	/**< Sequential write. */
+	SD_BENCH_RND_RD,	/**< Random read (block_cnt aligned). */
+	SD_BENCH_RND_WR,	/**< Random write (block_cnt aligned). */
+	SD_BENCH_PAT_NUM
+};
+
+/**
+ * @brief Multi-block write configurations compared by sd_bench_wr_opt().
+ */
+enum sd_bench_wr_cfg {
+	SD_BENCH_WR_PLAIN,	/**< CMD25 + CMD12. */
+	SD_BENCH_WR_PRE_ERASE,	/**< ACMD23 + CMD25 + CMD12. */
+	SD_BENCH_WR_BLK_CNT,	/**< CMD23 + CMD25. */
+	SD_BENCH_WR_BOTH,	/**< ACMD23 + CMD23 + CMD25. */
+	SD_BENCH_WR_CFG_NUM
+};
+
+/**
+ * @struct sd_bench_res
+ *
+ * @brief Result of one benchmark run.
+ */
+struct sd_bench_res {
+	int ret;		/**< 0, error of the failed command, or -ENRDY if not supported. */
+	unsigned int blk;	/**< Transferred blocks. */
+	unsigned int ms;	/**< Total time in ms. */
+	unsigned int kbps;	/**< Throughput in kB/s. */
+	unsigned int lat_max_us; /**< Maximal command latency in us. */
+};
+
+/**
+ * @brief Compare sustained write throughput with and without ACMD23/CMD23.
+ *
+ * Writes total_blk blocks from lba in commands of block_cnt blocks for each
+ * enum sd_bench_wr_cfg configuration (the same range every time). CMD23
+ * configurations are skipped (-ENRDY) if the card does not support CMD23.
+ * The write options of sd_card_init() are restored afterwards. The driver
+ * lock is held for the whole comparison, other card users wait.
+ *
+ * @param card      Initialized card.
+ * @param lba       First LBA of the test range.
+ * @param buf       Source buffer of block_cnt blocks.
+ * @param block_cnt Blocks per command (2..511).
+ * @param total_blk Blocks per configuration.
+ * @param res       Results, SD_BENCH_WR_CFG_NUM items (return).
+ */
+void sd_bench_wr_opt(struct sd_card *card, size_t lba, const void *buf, int block_cnt, int total_blk,
+		     struct sd_bench_res *res);
+
+/**
+ * @struct sd_bench_lat
+ *
+ * @brief Result of sd_bench_run().
+ */
+struct sd_bench_lat {
+	int ret;		/**< 0 or error of the failed command. */
+	unsigned int cmd;	/**< Executed commands. */
+	unsigned int kbps;	/**< Throughput in kB/s (sum of command latencies). */
+	unsigned int p50_us;	/**< Median command latency in us. */
+	unsigned int p90_us;	/**< 90th percentile command latency in us. */
+	unsigned int p99_us;	/**< 99th percentile command latency in us. */
+	unsigned int max_us;	/**< Maximal command latency in us. */
+};
+
+/**
+ * @brief Set bus width and card clock for the following benchmarks.
+ *
+ * The card mode (default/high speed) is not changed, clk_hz must not exceed
+ * card->clk_hz. The card structure is not modified; call
+ * sd_bench_set_bus(card, card->bus_width, card->clk_hz, NULL) to restore.
+ *
+ * @param card       Initialized card.
+ * @param bus_width  1 or 4 (4 only if card->bus_width == 4).
+ * @param clk_hz     Card clock frequency in Hz.
+ * @param clk_hz_set Clock frequency set (return), may be NULL.
+ *
+ * @return 0 - success; -EHW on ACMD6 error.
+ */
+int sd_bench_set_bus(struct sd_card *card, int bus_width, unsigned int clk_hz, unsigned int *clk_hz_set);
+
+/**
+ * @brief Measure SD_BENCH_LAT_N commands of one access pattern.
+ *
+ * Sequential patterns continue from lba and wrap inside the range, random
+ * patterns pick block_cnt aligned positions of the range by a fixed-seed
+ * pseudo-random sequence (repeatable runs).
+ *
+ * @param pat       Access pattern.
+ * @param lba       First LBA of the test range.
+ * @param range_blk Size of the test range in blocks (>= block_cnt).
+ * @param block_cnt Blocks per command (1..65535).
+ * @param buf       Data buffer of buf_blk blocks (PDC accessible, 32-bit aligned).
+ * @param buf_blk   Size of buf in blocks (1..511).
+ * @param res       Result (return).
+ */
+void sd_bench_run(enum sd_bench_pat pat, size_t lba, size_t range_blk, int block_cnt, void *buf, int buf_blk,
+		  struct sd_bench_lat *res);
+
+/**
+ * @brief Block transfer of sd_bench_run_io().
+ *
+ * Transfers block_cnt blocks at lba (wr == TRUE -> write) through buf of
+ * buf_blk blocks. Returns 0 or a negative error code.
+ */
+typedef int (*sd_bench_xfer)(boolean_t wr, size_t lba, int block_cnt, void *buf, int buf_blk);
+
+/**
+ * @brief Timestamp source of sd_bench_run_io().
+ *
+ * Returns a free-running 32-bit counter (wraps around).
+ */
+typedef uint32_t (*sd_bench_tm)(void);
+
+/**
+ * @brief As sd_bench_run(), with the commands executed by io and timed by tm.
+ *
+ * Lets the access patterns and statistics run on another block layer (e.g.
+ * hsmci_que) or against a simulated card. sd_bench_run() passes the HSMCI
+ * transfer and the DWT cycle counter.
+ *
+ * @param io    Block transfer function.
+ * @param tm    Timestamp counter.
+ * @param tm_hz Frequency of tm in Hz.
+ *
+ * Other parameters as for sd_bench_run().
+ */
+void sd_bench_run_io(sd_bench_xfer io, sd_bench_tm tm, uint32_t tm_hz, enum sd_bench_pat pat, size_t lba,
+		     size_t range_blk, int block_cnt, void *buf, int buf_blk, struct sd_bench_lat *res);
+
+/**
+ * @brief Compute the sd_bench_run() statistics from command latencies.
+ *
+ * No hardware access; res->ret is set to 0.
+ *
+ * @param cyc       Latencies in counter cycles, n items (sorted in place).
+ * @param n         Number of commands (0..).
+ * @param block_cnt Blocks per command.
+ * @param cyc_hz    Counter frequency in Hz.
+ * @param res       Result (return).
+ */
+void sd_bench_lat_calc(uint32_t *cyc, int n, int block_cnt, uint32_t cyc_hz, struct sd_bench_lat *res);
+
+#if TERMOUT == 1
+/**
+ * @brief Run the benchmark matrix and log the results (terminal output).
+ *
+ * All patterns for block counts 1, 8, 64, 256 at the bus settings: card
+ * width at card clock, card width at 25 MHz (if card clock is higher),
+ * 1 bit at 25 MHz (if card width is 4). The card bus setting is restored
+ * afterwards.
+ *
+ * @param card      Initialized card.
+ * @param lba       First LBA of the test range.
+ * @param range_blk Size of the test range in blocks (>= 256).
+ * @param buf       Data buffer of buf_blk blocks.
+ * @param buf_blk   Size of buf in blocks (1..511).
+ */
+void log_sd_bench_suite(struct sd_card *card, size_t lba, size_t range_blk, void *buf, int buf_blk);
+
+/**
+ * @brief Run sd_bench_wr_opt() and log the results (terminal output).
+ *
+ * Parameters as for sd_bench_wr_opt().
+ */
+void log_sd_bench_wr_opt(struct sd_card *card, size_t lba, const void *buf, int block_cnt, int total_blk);
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ * sd_card.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "atom.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "hsmci_cmd.h"
+#include "hsmci_sd.h"
+#include "sd_card.h"
+#include <string.h>
+
+#if SD_CARD == 1
+
+#if HSMCI_SD != 1
+ #error "SD_CARD requires HSMCI_SD"
+#endif
+
+#define ACMD41_TMO_MS 1000
+#define ACMD41_POLL_MS 10
+#define SD_CLK_INIT 400000
+#define SD_CLK_DEFAULT 25000000
+#define SD_CLK_HSPEED 50000000
+#define OCR_VDD_WIN (OCR_VDD_32_33 | OCR_VDD_33_34)
+#define CSD_CCC(csd) CSD_STRUCTURE(csd, 84, 12)
+#define CCC_SWITCH (1 << 10)
+#define SW_FUN_HSPEED 1
+#define SCR_CMD23 (1 << 1)
+
+static int op_cond(struct sd_card *card);
+static int parse_csd(struct sd_card *card);
+static int read_scr(struct sd_card *card);
+static int set_bus_width(struct sd_card *card);
+static int set_hspeed(struct sd_card *card);
+
+/**
+ * sd_card_init
+ */
+int sd_card_init(struct sd_card *card)
+{
+	hsmci_resp_t resp;
+	int ret;
+
+	memset(card, 0, sizeof(struct sd_card));
+	card->bus_width = 1;
+	hsmci_disable_hspeed();
+	hsmci_set_bus_width(HSMCI_BUS_WIDTH_1);
+	hsmci_set_byte_addressing(FALSE);
+	hsmci_set_write_opt(0, 0);
+	hsmci_set_clock(SD_CLK_INIT, &card->clk_hz, FALSE);
+	if ((ret = hsmci_send_clock())) {
+		return (ret);
+	}
+	if ((ret = hsmci_send_cmd(SDMMC_MCI_CMD0_GO_IDLE_STATE, 0, NULL))) {
+		return (ret);
+	}
+	// Cards of physical spec 1.x do not respond to CMD8.
+	if (0 == hsmci_send_cmd(SD_CMD8_SEND_IF_COND, SD_CMD8_HIGH_VOLTAGE | SD_CMD8_PATTERN, &resp)) {
+		if ((resp.r1 & (SD_CMD8_MASK_VOLTAGE | SD_CMD8_MASK_PATTERN)) != (SD_CMD8_HIGH_VOLTAGE | SD_CMD8_PATTERN)) {
+			return (-EFMT);
+		}
+		card->v2 = TRUE;
+	}
+	if ((ret = op_cond(card))) {
+		return (ret);
+	}
+	if ((ret = hsmci_send_cmd(SDMMC_CMD2_ALL_SEND_CID, 0, &resp))) {
+		return (ret);
+	}
+	memcpy(card->cid, resp.r2, sizeof(card->cid));
+	if ((ret = hsmci_send_cmd(SD_CMD3_SEND_RELATIVE_ADDR, 0, &resp))) {
+		return (ret);
+	}
+	if (SD_R6_GET_STATUS(resp.r1) & SD_R6_STATUS_ERR_MASK) {
+		return (-EHW);
+	}
+	card->rca = SD_R6_GET_RCA(resp.r1);
+	if ((ret = hsmci_send_cmd(SDMMC_MCI_CMD9_SEND_CSD, (unsigned int) card->rca << 16, &resp))) {
+		return (ret);
+	}
+	memcpy(card->csd, resp.r2, sizeof(card->csd));
+	if ((ret = parse_csd(card))) {
+		return (ret);
+	}
+	if ((ret = hsmci_send_cmd(SDMMC_CMD7_SELECT_CARD_CMD, (unsigned int) card->rca << 16, &resp))) {
+		return (ret);
+	}
+	// Default speed is allowed in transfer state.
+	hsmci_set_clock(SD_CLK_DEFAULT, &card->clk_hz, FALSE);
+	if (card->type == SD_CARD_SDSC) {
+		if ((ret = hsmci_send_cmd(SDMMC_CMD16_SET_BLOCKLEN, 512, &resp))) {
+			return (ret);
+		}
+		if (resp.r1 & CARD_STATUS_ERR_RD_WR) {
+			return (-EHW);
+		}
+		hsmci_set_byte_addressing(TRUE);
+	}
+	if ((ret = read_scr(card))) {
+		return (ret);
+	}
+	if ((ret = set_bus_width(card))) {
+		return (ret);
+	}
+	if ((ret = set_hspeed(card))) {
+		return (ret);
+	}
+	hsmci_set_clock((card->hspeed) ? SD_CLK_HSPEED : SD_CLK_DEFAULT, &card->clk_hz, FALSE);
+	hsmci_set_write_opt(card->rca, HSMCI_WR_OPT_PRE_ERASE | ((card->cmd23) ? HSMCI_WR_OPT_BLK_CNT : 0));
+	return (0);
+}
+
+/**
+ * op_cond
+ */
+static int op_cond(struct sd_card *card)
+{
+	hsmci_resp_t resp;
+	TickType_t t0;
+	int ret;
+
+	t0 = xTaskGetTickCount();
+	for (;;) {
+		if ((ret = hsmci_send_cmd(SDMMC_CMD55_APP_CMD, 0, &resp))) {
+			return (ret);
+		}
+		if ((ret = hsmci_send_cmd(SD_MCI_ACMD41_SD_SEND_OP_COND,
+					  OCR_VDD_WIN | ((card->v2) ? SD_ACMD41_HCS : 0), &resp))) {
+			return (ret);
+		}
+		if (resp.r1 & OCR_POWER_UP_BUSY) {
+			if (!(resp.r1 & OCR_VDD_WIN)) {
+				return (-EFMT);
+			}
+			card->type = (resp.r1 & OCR_CCS) ? SD_CARD_SDHC : SD_CARD_SDSC;
+			return (0);
+		}
+		if ((xTaskGetTickCount() - t0) > (TickType_t) ms_to_os_ticks(ACMD41_TMO_MS)) {
+			return (-ETMO);
+		}
+		vTaskDelay(ms_to_os_ticks(ACMD41_POLL_MS));
+	}
+}
+
+/**
+ * parse_csd
+ */
+static int parse_csd(struct sd_card *card)
+{
+	uint32_t c_size;
+
+	switch (CSD_STRUCTURE_VERSION(card->csd)) {
+	case SD_CSD_VER_1_0 :
+		card->blk_cnt = (size_t) (SD_CSD_1_0_C_SIZE(card->csd) + 1) <<
+				(SD_CSD_1_0_C_SIZE_MULT(card->csd) + 2 + SD_CSD_1_0_READ_BL_LEN(card->csd) - 9);
+		break;
+	case SD_CSD_VER_2_0 :
+		c_size = SD_CSD_2_0_C_SIZE(card->csd);
+		card->blk_cnt = (size_t) (c_size + 1) * 1024;
+		// SDHC C_SIZE ends at 0xFF5F (32 GB), SDXC starts at 0xFFFF.
+		if (c_size >= 0xFFFF) {
+			card->type = SD_CARD_SDXC;
+		}
+		break;
+	default :
+		return (-EFMT);
+	}
+	return (0);
+}
+
+/**
+ * read_scr
+ */
+static int read_scr(struct sd_card *card)
+{
+	uint32_t scr[SD_SCR_REG_BSIZE / 4];
+	hsmci_resp_t resp;
+	int ret;
+
+	if ((ret = hsmci_send_cmd(SDMMC_CMD55_APP_CMD, (unsigned int) card->rca << 16, &resp))) {
+		return (ret);
+	}
+	if ((ret = hsmci_send_data_cmd(SD_ACMD51_SEND_SCR, 0, scr, sizeof(scr), &resp))) {
+		return (ret);
+	}
+	memcpy(card->scr, scr, sizeof(card->scr));
+	card->spec = SD_SCR_SD_SPEC(card->scr);
+	card->cmd23 = (SD_SCR_SD_CMD_SUPPORT(card->scr) & SCR_CMD23) ? TRUE : FALSE;
+	return (0);
+}
+
+/**
+ * set_bus_width
+ */
+static int set_bus_width(struct sd_card *card)
+{
+#if HSMCI_SD_DLINE_NUM == 4
+	hsmci_resp_t resp;
+	int ret;
+
+	if (!(SD_SCR_SD_BUS_WIDTHS(card->scr) & SD_SCR_SD_BUS_WIDTH_4BITS)) {
+		return (0);
+	}
+	if ((ret = hsmci_send_cmd(SDMMC_CMD55_APP_CMD, (unsigned int) card->rca << 16, &resp))) {
+		return (ret);
+	}
+	// ACMD6 argument: 0 -> 1 bit, 2 -> 4 bit.
+	if ((ret = hsmci_send_cmd(SD_ACMD6_SET_BUS_WIDTH, 2, &resp))) {
+		return (ret);
+	}
+	if (resp.r1 & CARD_STATUS_ERR_RD_WR) {
+		return (-EHW);
+	}
+	hsmci_set_bus_width(HSMCI_BUS_WIDTH_4);
+	card->bus_width = 4;
+#endif
+	return (0);
+}
+
+/**
+ * set_hspeed
+ */
+static int set_hspeed(struct sd_card *card)
+{
+	uint32_t sw[SD_SW_STATUS_BSIZE / 4];
+	hsmci_resp_t resp;
+	unsigned int arg;
+	int ret;
+
+	if (card->spec < SD_SCR_SD_SPEC_1_10 || !(CSD_CCC(card->csd) & CCC_SWITCH)) {
+		return (0);
+	}
+	arg = SD_CMD6_GRP6_NO_INFLUENCE | SD_CMD6_GRP5_NO_INFLUENCE | SD_CMD6_GRP4_NO_INFLUENCE |
+	      SD_CMD6_GRP3_NO_INFLUENCE | SD_CMD6_GRP2_NO_INFLUENCE | SD_CMD6_GRP1_HIGH_SPEED;
+	if ((ret = hsmci_send_data_cmd(SD_CMD6_SWITCH_FUNC, SD_CMD6_MODE_CHECK | arg, sw, sizeof(sw), &resp))) {
+		return (ret);
+	}
+	if (!(SD_SW_STATUS_FUN_GRP1_INFO((uint8_t *) sw) & (1 << SW_FUN_HSPEED)) ||
+	    SD_SW_STATUS_FUN_GRP1_RC((uint8_t *) sw) != SW_FUN_HSPEED) {
+		return (0);
+	}
+	if ((ret = hsmci_send_data_cmd(SD_CMD6_SWITCH_FUNC, SD_CMD6_MODE_SWITCH | arg, sw, sizeof(sw), &resp))) {
+		return (ret);
+	}
+	if (SD_SW_STATUS_FUN_GRP1_RC((uint8_t *) sw) != SW_FUN_HSPEED) {
+		return (0);
+	}
+	// Card switches timing within 8 clocks after the switch status block.
+	hsmci_enable_hspeed();
+	card->hspeed = TRUE;
+	return (0);
+}
+
+#if TERMOUT == 1
+/**
+ * log_sd_card_info
+ */
+void log_sd_card_info(struct sd_card *card)
+{
+	static const char *const type_str[] = {"SDSC", "SDHC", "SDXC"};
+
+	msg(INF, "sd_card.c: %s spec=%d rca=0x%04X blk_cnt=%u (%u MB)\n", type_str[card->type], card->spec,
+	    card->rca, (unsigned int) card->blk_cnt, (unsigned int) (card->blk_cnt / 2048));
+	msg(INF, "sd_card.c: bus_width=%d %s clk_hz=%u cmd23=%d\n", card->bus_width,
+	    (card->hspeed) ? "high-speed" : "default-speed", card->clk_hz, card->cmd23);
+}
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * sd_card.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file sd_card.h
+ *
+ * @brief SD memory card bring-up on top of the HSMCI driver.
+ *
+ * sd_card_init() runs the SD identification sequence and leaves the card in
+ * transfer state configured for the fastest bus mode supported by the card and
+ * the board:
+ * - CMD0, CMD8 (physical spec 2.00+ detection), ACMD41 with HCS until ready,
+ *   CMD2 (CID), CMD3 (RCA), CMD9 (CSD), CMD7 (select).
+ * - SDSC/SDHC/SDXC identification from OCR.CCS and CSD; SDSC cards use
+ *   byte addressing (hsmci_set_byte_addressing()) and block length 512 (CMD16).
+ * - SCR read (ACMD51); 4-bit bus via ACMD6 when HSMCI_SD_DLINE_NUM == 4 and the
+ *   card supports it.
+ * - High-speed mode via CMD6 (spec 1.10+ cards with group 1 function 1), then
+ *   HSMCI high-speed timing and 50 MHz clock; otherwise 25 MHz. The clock is
+ *   limited by F_MCK / 2.
+ * - Multi-block write options (hsmci_set_write_opt()): ACMD23 pre-erase always,
+ *   CMD23 block count if the card supports it.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when SD_CARD == 1. Requires
+ *   HSMCI_SD == 1.
+ */
+
+#ifndef SD_CARD_H
+#define SD_CARD_H
+
+#ifndef SD_CARD
+ #define SD_CARD 0
+#endif
+
+#if SD_CARD == 1
+
+enum sd_card_type {
+	SD_CARD_SDSC,	/**< Standard capacity (byte addressed, up to 2 GB). */
+	SD_CARD_SDHC,	/**< High capacity (block addressed, up to 32 GB). */
+	SD_CARD_SDXC	/**< Extended capacity (block addressed, over 32 GB). */
+};
+
+/**
+ * @struct sd_card
+ *
+ * @brief Card information filled by sd_card_init().
+ */
+struct sd_card {
+	enum sd_card_type type;	/**< Card capacity class. */
+	boolean_t v2;		/**< Card answered CMD8 (physical spec 2.00 or later). */
+	uint16_t rca;		/**< Relative card address. */
+	uint8_t cid[16];	/**< CID register (big-endian). */
+	uint8_t csd[16];	/**< CSD register (big-endian). */
+	uint8_t scr[8];		/**< SCR register (big-endian). */
+	int spec;		/**< SCR.SD_SPEC (0 -> 1.0x, 1 -> 1.10, 2 -> 2.00+). */
+	size_t blk_cnt;		/**< Capacity in 512 B blocks. */
+	int bus_width;		/**< Data bus width (1 or 4). */
+	boolean_t hspeed;	/**< High-speed mode active. */
+	boolean_t cmd23;	/**< Card supports CMD23 (SCR.CMD_SUPPORT). */
+	unsigned int clk_hz;	/**< Card clock frequency set. */
+};
+
+/**
+ * @brief Identify and initialize the card.
+ *
+ * Call after init_hsmci() with a card inserted. May be called again after a
+ * card change.
+ *
+ * @param card Card information (return).
+ *
+ * @return 0 - success; -EHW on command error; -ETMO if the card did not leave
+ *         the busy state (ACMD41); -EFMT if the card is not a usable SD memory
+ *         card (voltage/pattern mismatch, unknown CSD).
+ */
+int sd_card_init(struct sd_card *card);
+
+#if TERMOUT == 1
+/**
+ * @brief Log card type, capacity and bus mode (terminal output).
+ *
+ * @param card Card information.
+ */
+void log_sd_card_info(struct sd_card *card);
+#endif
+
+#endif
+
+#endif
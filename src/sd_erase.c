@@ -0,0 +1,336 @@
+/*
+ * sd_erase.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "atom.h"
+#include "hsmci_sd.h"
+#include "hsmci_cmd.h"
+#include "sd_card.h"
+#include "sd_erase.h"
+
+#if SD_ERASE == 1
+
+#if SD_CARD != 1
+ #error "SD_ERASE requires SD_CARD"
+#endif
+
+struct rng {
+	size_t lba;
+	size_t cnt;
+};
+
+static const char *const tsk_nm = "SDERS";
+static TaskHandle_t tsk_hndl;
+static struct sd_card *crd;
+static struct rng rng[SD_ERASE_RANGES];
+static int rng_cnt;
+static struct sd_erase_stats stats;
+
+static void erase_tsk(void *p);
+static boolean_t take_chunk(size_t *lba, size_t *cnt);
+static void del_rng(int i);
+static int erase(size_t lba, size_t cnt);
+
+/**
+ * init_sd_erase
+ */
+void init_sd_erase(struct sd_card *card)
+{
+	if (card == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (tsk_hndl != NULL) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	crd = card;
+	if (pdPASS != xTaskCreate(erase_tsk, tsk_nm, SD_ERASE_TASK_STACK_SIZE, NULL,
+				  SD_ERASE_TASK_PRIO, &tsk_hndl)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+}
+
+/**
+ * sd_erase_discard
+ */
+int sd_erase_discard(size_t lba, size_t cnt)
+{
+	size_t end = lba + cnt;
+	int i, j;
+
+	if (cnt == 0 || end < lba || end > crd->blk_cnt) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	taskENTER_CRITICAL();
+	for (i = 0; i < rng_cnt && rng[i].lba + rng[i].cnt < lba; i++) {
+		;
+	}
+	// rng[i] is the first range ending at or after lba.
+	if (i < rng_cnt && rng[i].lba <= end) {
+		stats.pend -= rng[i].cnt;
+		if (lba < rng[i].lba) {
+			rng[i].cnt += rng[i].lba - lba;
+			rng[i].lba = lba;
+		}
+		if (end > rng[i].lba + rng[i].cnt) {
+			rng[i].cnt = end - rng[i].lba;
+		}
+		// Absorb following ranges reached by the grown one.
+		while (i + 1 < rng_cnt && rng[i + 1].lba <= rng[i].lba + rng[i].cnt) {
+			stats.pend -= rng[i + 1].cnt;
+			if (rng[i + 1].lba + rng[i + 1].cnt > rng[i].lba + rng[i].cnt) {
+				rng[i].cnt = rng[i + 1].lba + rng[i + 1].cnt - rng[i].lba;
+			}
+			del_rng(i + 1);
+		}
+		stats.pend += rng[i].cnt;
+	} else {
+		if (rng_cnt == SD_ERASE_RANGES) {
+			stats.rej++;
+			taskEXIT_CRITICAL();
+			return (-EBFOV);
+		}
+		for (j = rng_cnt; j > i; j--) {
+			rng[j] = rng[j - 1];
+		}
+		rng[i].lba = lba;
+		rng[i].cnt = cnt;
+		rng_cnt++;
+		stats.pend += cnt;
+	}
+	stats.req++;
+	taskEXIT_CRITICAL();
+	xTaskNotifyGive(tsk_hndl);
+	return (0);
+}
+
+/**
+ * sd_erase_cancel
+ */
+void sd_erase_cancel(size_t lba, size_t cnt)
+{
+	size_t end = lba + cnt, r_end;
+	int i, j;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < rng_cnt; ) {
+		r_end = rng[i].lba + rng[i].cnt;
+		if (r_end <= lba || rng[i].lba >= end) {
+			i++;
+			continue;
+		}
+		if (rng[i].lba < lba && r_end > end) {
+			// Split; without a free entry keep the bigger part only.
+			if (rng_cnt < SD_ERASE_RANGES) {
+				for (j = rng_cnt; j > i + 1; j--) {
+					rng[j] = rng[j - 1];
+				}
+				rng_cnt++;
+				rng[i + 1].lba = end;
+				rng[i + 1].cnt = r_end - end;
+				rng[i].cnt = lba - rng[i].lba;
+			} else if (lba - rng[i].lba >= r_end - end) {
+				rng[i].cnt = lba - rng[i].lba;
+				stats.cancel += r_end - end;
+				stats.pend -= r_end - end;
+			} else {
+				stats.cancel += lba - rng[i].lba;
+				stats.pend -= lba - rng[i].lba;
+				rng[i].lba = end;
+				rng[i].cnt = r_end - end;
+			}
+			stats.cancel += cnt;
+			stats.pend -= cnt;
+			break;
+		}
+		if (rng[i].lba >= lba && r_end <= end) {
+			stats.cancel += rng[i].cnt;
+			stats.pend -= rng[i].cnt;
+			del_rng(i);
+		} else if (rng[i].lba < lba) {
+			stats.cancel += r_end - lba;
+			stats.pend -= r_end - lba;
+			rng[i].cnt = lba - rng[i].lba;
+			i++;
+		} else {
+			stats.cancel += end - rng[i].lba;
+			stats.pend -= end - rng[i].lba;
+			rng[i].cnt = r_end - end;
+			rng[i].lba = end;
+			i++;
+		}
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * get_sd_erase_stats
+ */
+void get_sd_erase_stats(struct sd_erase_stats *st)
+{
+	taskENTER_CRITICAL();
+	*st = stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * erase_tsk
+ */
+static void erase_tsk(void *p)
+{
+	TickType_t idle, min_idle = ms_to_os_ticks(SD_ERASE_IDLE_MS), tck;
+	size_t lba, cnt;
+	unsigned int ms;
+	int ret;
+
+	while (TRUE) {
+		if (rng_cnt == 0) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+		idle = xTaskGetTickCount() - hsmci_get_io_tick();
+		if (idle < min_idle) {
+			stats.defer++;
+			vTaskDelay(min_idle - idle);
+			continue;
+		}
+		hsmci_lock();
+		// A transfer may have run while waiting for the lock. The chunk is
+		// taken under the lock, so sd_erase_cancel() of a writer holding
+		// it cannot be missed.
+		if (xTaskGetTickCount() - hsmci_get_io_tick() < min_idle || !take_chunk(&lba, &cnt)) {
+			hsmci_unlock();
+			continue;
+		}
+		tck = xTaskGetTickCount();
+		ret = erase(lba, cnt);
+		ms = (xTaskGetTickCount() - tck) * portTICK_PERIOD_MS;
+		hsmci_unlock();
+		taskENTER_CRITICAL();
+		stats.pend -= cnt;
+		if (ret) {
+			stats.err++;
+		} else {
+			stats.op++;
+			stats.blk += cnt;
+			stats.ms += ms;
+			if (ms > stats.ms_max) {
+				stats.ms_max = ms;
+			}
+		}
+		taskEXIT_CRITICAL();
+	}
+}
+
+/**
+ * take_chunk
+ */
+static boolean_t take_chunk(size_t *lba, size_t *cnt)
+{
+	boolean_t ret = FALSE;
+
+	taskENTER_CRITICAL();
+	if (rng_cnt) {
+		*lba = rng[0].lba;
+		if (rng[0].cnt > SD_ERASE_MAX_BLK) {
+			*cnt = SD_ERASE_MAX_BLK;
+			rng[0].lba += SD_ERASE_MAX_BLK;
+			rng[0].cnt -= SD_ERASE_MAX_BLK;
+		} else {
+			*cnt = rng[0].cnt;
+			del_rng(0);
+		}
+		ret = TRUE;
+	}
+	taskEXIT_CRITICAL();
+	return (ret);
+}
+
+/**
+ * del_rng
+ */
+static void del_rng(int i)
+{
+	for (rng_cnt--; i < rng_cnt; i++) {
+		rng[i] = rng[i + 1];
+	}
+}
+
+/**
+ * erase
+ */
+static int erase(size_t lba, size_t cnt)
+{
+	hsmci_resp_t resp;
+	unsigned int shift = (crd->type == SD_CARD_SDSC) ? 9 : 0;
+	int ret;
+
+	if ((ret = hsmci_send_cmd(SD_CMD32_ERASE_WR_BLK_START, lba << shift, &resp))) {
+		return (ret);
+	}
+	if (resp.r1 & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_ERASE_SEQ_ERROR)) {
+		return (-EERASE);
+	}
+	if ((ret = hsmci_send_cmd(SD_CMD33_ERASE_WR_BLK_END, (lba + cnt - 1) << shift, &resp))) {
+		return (ret);
+	}
+	if (resp.r1 & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_ERASE_SEQ_ERROR)) {
+		return (-EERASE);
+	}
+	hsmci_set_next_r1b_busy_tmo_ms(SD_ERASE_TMO_MS);
+	if ((ret = hsmci_send_cmd(SDMMC_CMD38_ERASE, SD_ERASE_DISCARD, &resp))) {
+		return (ret);
+	}
+	if (resp.r1 & (CARD_STATUS_ERR_RD_WR | CARD_STATUS_ERASE_SEQ_ERROR | CARD_STATUS_ERASE_PARAM)) {
+		return (-EERASE);
+	}
+	return (0);
+}
+
+#if TERMOUT == 1
+/**
+ * log_sd_erase_stats
+ */
+void log_sd_erase_stats(void)
+{
+	struct sd_erase_stats st;
+	UBaseType_t pr;
+
+	get_sd_erase_stats(&st);
+	pr = uxTaskPriorityGet(NULL);
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	msg(INF, "sd_erase.c: req=%u rej=%u cancel=%u pend=%u defer=%u\n", st.req, st.rej, st.cancel,
+	    st.pend, st.defer);
+	msg(INF, "sd_erase.c: op=%u blk=%u (%u MB) ms=%u ms_max=%u err=%u\n", st.op, st.blk, st.blk / 2048,
+	    st.ms, st.ms_max, st.err);
+	vTaskPrioritySet(NULL, pr);
+}
+#endif
+
+#endif
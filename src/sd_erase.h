@@ -0,0 +1,144 @@
+/*
+ * sd_erase.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file sd_erase.h
+ *
+ * @brief Background erase of discarded SD card block ranges.
+ *
+ * Blocks freed by the application (e.g. by a log or filesystem) keep their old
+ * content on the card, so the card has to erase them when they are written
+ * again and write latency grows as the card fills. The scheduler collects
+ * discarded ranges and erases them with CMD32/CMD33/CMD38 in the SDERS task
+ * while the card is idle.
+ *
+ * Key characteristics:
+ * - Discarded ranges are kept in a table of SD_ERASE_RANGES entries sorted by
+ *   LBA; adjacent and overlapping ranges are merged into one erase.
+ * - Idle detection: an erase starts only when no data transfer started for
+ *   SD_ERASE_IDLE_MS (hsmci_get_io_tick()). One erase covers at most
+ *   SD_ERASE_MAX_BLK blocks, so a foreground transfer waits at most for one
+ *   such erase.
+ * - Erases run under hsmci_lock(), like all other users of the card. A range
+ *   which is going to be written must be withdrawn by sd_erase_cancel() before
+ *   the write.
+ * - Erase is an optimization: a failed erase is counted and its range dropped.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when SD_ERASE == 1. Requires
+ *   SD_CARD == 1.
+ * - SD_ERASE_TASK_STACK_SIZE and SD_ERASE_TASK_PRIO must be defined in
+ *   sysconf.h.
+ * - SD_ERASE_DISCARD == 1 issues CMD38 with the DISCARD argument (cards of
+ *   physical spec 5.00 and later): the card may skip the erase of blocks
+ *   whose content is not going to be read.
+ */
+
+#ifndef SD_ERASE_H
+#define SD_ERASE_H
+
+#ifndef SD_ERASE
+ #define SD_ERASE 0
+#endif
+
+#ifndef SD_ERASE_RANGES
+ #define SD_ERASE_RANGES 16
+#endif
+
+#ifndef SD_ERASE_MAX_BLK
+ #define SD_ERASE_MAX_BLK 8192
+#endif
+
+#ifndef SD_ERASE_IDLE_MS
+ #define SD_ERASE_IDLE_MS 100
+#endif
+
+#ifndef SD_ERASE_TMO_MS
+ #define SD_ERASE_TMO_MS 3000
+#endif
+
+#ifndef SD_ERASE_DISCARD
+ #define SD_ERASE_DISCARD 0
+#endif
+
+#if SD_ERASE == 1
+
+/**
+ * @struct sd_erase_stats
+ *
+ * @brief Scheduler counters.
+ */
+struct sd_erase_stats {
+	unsigned int req;	/**< Accepted discard requests. */
+	unsigned int rej;	/**< Discard requests rejected (range table full). */
+	unsigned int cancel;	/**< Pending blocks withdrawn by sd_erase_cancel(). */
+	unsigned int op;	/**< Erase operations (CMD38). */
+	unsigned int blk;	/**< Erased blocks. */
+	unsigned int ms;	/**< Total erase time in ms. */
+	unsigned int ms_max;	/**< Maximal erase time in ms. */
+	unsigned int defer;	/**< Erases postponed due to card I/O. */
+	unsigned int err;	/**< Failed erase operations. */
+	unsigned int pend;	/**< Blocks waiting for erase. */
+};
+
+/**
+ * @brief Create the SDERS task.
+ *
+ * @param card Initialized card (sd_card_init()).
+ */
+void init_sd_erase(struct sd_card *card);
+
+/**
+ * @brief Schedule blocks for background erase.
+ *
+ * @param lba First block.
+ * @param cnt Number of blocks.
+ *
+ * @return 0 - success; -EBFOV if the range table is full (range not merged
+ *         with a pending one).
+ */
+int sd_erase_discard(size_t lba, size_t cnt);
+
+/**
+ * @brief Withdraw blocks from pending erase ranges.
+ *
+ * Call before writing blocks which may have been discarded. If a split range
+ * does not fit into the table, the smaller part is dropped (not erased).
+ *
+ * @param lba First block.
+ * @param cnt Number of blocks.
+ */
+void sd_erase_cancel(size_t lba, size_t cnt);
+
+/**
+ * @brief Get scheduler counters.
+ *
+ * @param st Counters (return).
+ */
+void get_sd_erase_stats(struct sd_erase_stats *st);
+
+#if TERMOUT == 1
+/**
+ * @brief Log scheduler counters (terminal output).
+ */
+void log_sd_erase_stats(void);
+#endif
+
+#endif
+
+#endif
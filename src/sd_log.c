@@ -0,0 +1,491 @@
+/*
+ * sd_log.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "hsmci_sd.h"
+#include "sd_log.h"
+#include <string.h>
+
+#if SD_LOG == 1
+
+#if HSMCI_SD != 1
+ #error "SD_LOG requires HSMCI_SD"
+#endif
+
+#define BLK_MAGIC 0x474C4453
+#define CRC_OFS (SD_LOG_BLK_SIZE - 4)
+#define PAYLOAD_SIZE (CRC_OFS - SD_LOG_HDR_SIZE)
+#define MAX_BATCH_BLK 511
+
+struct blk_hdr {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t tm_first;
+	uint32_t tm_last;
+	uint16_t len;
+	uint16_t rec_cnt;
+};
+
+_Static_assert(sizeof(struct blk_hdr) == SD_LOG_HDR_SIZE, "SD_LOG_HDR_SIZE mismatch");
+
+struct wr_job {
+	int idx;
+	int n;
+	uint32_t seq;
+};
+
+static const uint32_t crc_tbl[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static void log_tsk(void *p);
+static void write_batch(sd_log log, struct wr_job *job);
+static void open_blk(sd_log log, uint32_t tm);
+static void close_blk(sd_log log);
+static void submit_batch(sd_log log);
+static int rd_blk(sd_log log, uint32_t seq, uint32_t *blk, boolean_t *vld);
+static uint32_t crc32(const uint8_t *p, int len);
+
+/**
+ * init_sd_log
+ */
+int init_sd_log(sd_log log)
+{
+	struct blk_hdr *hdr;
+	uint32_t *blk, s0, lo, hi, mid, j;
+	boolean_t vld;
+	int idx, ret;
+
+	if (log->blk_cnt <= (unsigned int) log->batch_blk || log->batch_blk < 1 ||
+	    log->batch_blk > MAX_BATCH_BLK || log->buf[0] == NULL || log->buf[1] == NULL ||
+	    ((unsigned int) log->buf[0] & 3) || ((unsigned int) log->buf[1] & 3)) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (log->tsk != NULL) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	memset(&log->stats, 0, sizeof(struct sd_log_stats));
+	log->err = 0;
+	// Batch buffer 0 is free until the first append, use it for recovery.
+	blk = log->buf[0];
+	hdr = (struct blk_hdr *) blk;
+	// Region block 0 is rewritten at every wrap, a power loss during that
+	// batch may leave it (and the rest of the batch) invalid. Anchor the
+	// pass on the first valid block of the first batch_blk + 1 blocks.
+	for (j = 0; j <= (uint32_t) log->batch_blk; j++) {
+		if ((ret = rd_blk(log, j + 1, blk, &vld))) {
+			return (ret);
+		}
+		if (vld) {
+			break;
+		}
+	}
+	if (!vld) {
+		// Unformatted region: empty log.
+		log->next_seq = log->old_seq = 1;
+	} else {
+		// Sequence number of region block 0 in the anchored pass.
+		s0 = hdr->seq - j;
+		if ((s0 - 1) % log->blk_cnt || hdr->seq < j + 1) {
+			return (-EFMT);
+		}
+		// Region block i holds sequence s0 + i up to the head. Find the first
+		// block breaking this.
+		lo = j + 1;
+		hi = log->blk_cnt;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if ((ret = rd_blk(log, s0 + mid, blk, &vld))) {
+				return (ret);
+			}
+			if (vld && hdr->seq == s0 + mid) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		// Sequence numbers continue after the anchored pass, blocks lost
+		// before the anchor are skipped.
+		log->next_seq = s0 + lo;
+		log->old_seq = s0 + j;
+		if (lo < log->blk_cnt && s0 > log->blk_cnt) {
+			// Block behind the head is from the previous pass.
+			if ((ret = rd_blk(log, s0 + lo, blk, &vld))) {
+				return (ret);
+			}
+			if (vld && hdr->seq == s0 + lo - log->blk_cnt) {
+				log->old_seq = log->next_seq - log->blk_cnt;
+			}
+		}
+	}
+	log->wr_seq = log->next_seq;
+	log->fill = 0;
+	log->fill_blk = 0;
+	log->open = FALSE;
+	if (NULL == (log->wr_que = xQueueCreate(2, sizeof(struct wr_job)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	if (NULL == (log->free_que = xQueueCreate(2, sizeof(int)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	idx = 1;
+	xQueueSend(log->free_que, &idx, 0);
+	if (pdPASS != xTaskCreate(log_tsk, "SDLOG", SD_LOG_TASK_STACK_SIZE, log,
+				  SD_LOG_TASK_PRIO, &log->tsk)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	return (0);
+}
+
+/**
+ * sd_log_append
+ */
+int sd_log_append(sd_log log, uint32_t tm, const void *data, int len)
+{
+	struct blk_hdr *hdr;
+	uint8_t *p;
+	uint16_t l;
+
+	if (len < 1 || len > SD_LOG_REC_MAX) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (log->err) {
+		return (log->err);
+	}
+	if (log->open) {
+		hdr = (struct blk_hdr *) ((uint8_t *) log->buf[log->fill] + log->fill_blk * SD_LOG_BLK_SIZE);
+		if (hdr->len + SD_LOG_REC_HDR_SIZE + len > PAYLOAD_SIZE) {
+			close_blk(log);
+		}
+	}
+	if (!log->open) {
+		open_blk(log, tm);
+	}
+	hdr = (struct blk_hdr *) ((uint8_t *) log->buf[log->fill] + log->fill_blk * SD_LOG_BLK_SIZE);
+	p = (uint8_t *) hdr + SD_LOG_HDR_SIZE + hdr->len;
+	l = len;
+	memcpy(p, &l, 2);
+	memcpy(p + 2, &tm, 4);
+	memcpy(p + SD_LOG_REC_HDR_SIZE, data, len);
+	hdr->len += SD_LOG_REC_HDR_SIZE + len;
+	hdr->rec_cnt++;
+	hdr->tm_last = tm;
+	log->stats.rec++;
+	return (0);
+}
+
+/**
+ * sd_log_sync
+ */
+int sd_log_sync(sd_log log)
+{
+	int idx;
+
+	if (log->open) {
+		close_blk(log);
+	}
+	if (log->fill_blk) {
+		submit_batch(log);
+	}
+	// The batch not held by the producer is returned after its write.
+	xQueueReceive(log->free_que, &idx, portMAX_DELAY);
+	xQueueSend(log->free_que, &idx, 0);
+	return (log->err);
+}
+
+/**
+ * sd_log_find
+ */
+int sd_log_find(sd_log log, uint32_t tm_from, uint32_t tm_to, struct sd_log_iter *it)
+{
+	struct blk_hdr *hdr = (struct blk_hdr *) it->blk;
+	uint32_t lo, hi, mid;
+	boolean_t vld;
+	int ret;
+
+	it->log = log;
+	it->tm_from = tm_from;
+	it->tm_to = tm_to;
+	it->ld = FALSE;
+	taskENTER_CRITICAL();
+	lo = log->old_seq;
+	it->end_seq = log->wr_seq;
+	taskEXIT_CRITICAL();
+	it->seq = it->end_seq;
+	if (lo == it->end_seq || tm_from > tm_to) {
+		return (0);
+	}
+	// Last block with tm_first <= tm_from, or the oldest one.
+	hi = it->end_seq - 1;
+	while (lo < hi) {
+		mid = hi - (hi - lo) / 2;
+		if ((ret = rd_blk(log, mid, it->blk, &vld))) {
+			return (ret);
+		}
+		if (!vld || hdr->seq != mid) {
+			return (-EDATA);
+		}
+		if (hdr->tm_first <= tm_from) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	it->seq = lo;
+	return (0);
+}
+
+/**
+ * sd_log_next
+ */
+int sd_log_next(struct sd_log_iter *it, uint32_t *tm, void *data, int size)
+{
+	struct blk_hdr *hdr = (struct blk_hdr *) it->blk;
+	uint8_t *p;
+	uint32_t t;
+	uint16_t l;
+	boolean_t vld;
+	int ret;
+
+	while (1) {
+		if (!it->ld) {
+			if (it->seq == it->end_seq) {
+				return (0);
+			}
+			if ((ret = rd_blk(it->log, it->seq, it->blk, &vld))) {
+				return (ret);
+			}
+			if (!vld || hdr->seq != it->seq) {
+				return (-EDATA);
+			}
+			if (hdr->tm_first > it->tm_to) {
+				it->seq = it->end_seq;
+				return (0);
+			}
+			it->pos = 0;
+			it->ld = TRUE;
+		}
+		if (it->pos >= hdr->len) {
+			it->seq++;
+			it->ld = FALSE;
+			continue;
+		}
+		p = (uint8_t *) it->blk + SD_LOG_HDR_SIZE + it->pos;
+		memcpy(&l, p, 2);
+		memcpy(&t, p + 2, 4);
+		if (it->pos + SD_LOG_REC_HDR_SIZE + l > hdr->len) {
+			return (-EDATA);
+		}
+		if (t > it->tm_to) {
+			it->seq = it->end_seq;
+			it->ld = FALSE;
+			return (0);
+		}
+		if (t < it->tm_from) {
+			it->pos += SD_LOG_REC_HDR_SIZE + l;
+			continue;
+		}
+		if (l > size) {
+			return (-EBFOV);
+		}
+		memcpy(data, p + SD_LOG_REC_HDR_SIZE, l);
+		it->pos += SD_LOG_REC_HDR_SIZE + l;
+		*tm = t;
+		return (l);
+	}
+}
+
+/**
+ * log_tsk
+ */
+static void log_tsk(void *p)
+{
+	sd_log log = p;
+	struct wr_job job;
+
+	while (TRUE) {
+		xQueueReceive(log->wr_que, &job, portMAX_DELAY);
+		write_batch(log, &job);
+		xQueueSend(log->free_que, &job.idx, portMAX_DELAY);
+	}
+}
+
+/**
+ * write_batch
+ */
+static void write_batch(sd_log log, struct wr_job *job)
+{
+	const uint8_t *b = log->buf[job->idx];
+	uint32_t seq = job->seq;
+	TickType_t tck;
+	unsigned int ms;
+	int n = job->n, pos, cnt, ret;
+
+	taskENTER_CRITICAL();
+	if (seq + n - log->old_seq > log->blk_cnt) {
+		// Oldest blocks are going to be overwritten.
+		log->old_seq = seq + n - log->blk_cnt;
+	}
+	taskEXIT_CRITICAL();
+	tck = xTaskGetTickCount();
+	while (n) {
+		pos = (seq - 1) % log->blk_cnt;
+		cnt = (n < (int) log->blk_cnt - pos) ? n : (int) log->blk_cnt - pos;
+		hsmci_lock();
+		ret = hsmci_write_blocks(log->start_lba + pos, cnt, b);
+		hsmci_unlock();
+		if (ret) {
+			log->err = ret;
+			log->stats.wr_err++;
+			return;
+		}
+		b += cnt * SD_LOG_BLK_SIZE;
+		seq += cnt;
+		n -= cnt;
+	}
+	ms = (xTaskGetTickCount() - tck) * portTICK_PERIOD_MS;
+	if (ms > log->stats.wr_ms_max) {
+		log->stats.wr_ms_max = ms;
+	}
+	log->stats.batch++;
+	taskENTER_CRITICAL();
+	log->wr_seq = seq;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * open_blk
+ */
+static void open_blk(sd_log log, uint32_t tm)
+{
+	struct blk_hdr *hdr;
+
+	hdr = (struct blk_hdr *) ((uint8_t *) log->buf[log->fill] + log->fill_blk * SD_LOG_BLK_SIZE);
+	memset(hdr, 0, SD_LOG_BLK_SIZE);
+	hdr->magic = BLK_MAGIC;
+	hdr->seq = log->next_seq++;
+	hdr->tm_first = hdr->tm_last = tm;
+	log->open = TRUE;
+}
+
+/**
+ * close_blk
+ */
+static void close_blk(sd_log log)
+{
+	uint8_t *b;
+	uint32_t crc;
+
+	b = (uint8_t *) log->buf[log->fill] + log->fill_blk * SD_LOG_BLK_SIZE;
+	crc = crc32(b, CRC_OFS);
+	memcpy(b + CRC_OFS, &crc, 4);
+	log->open = FALSE;
+	log->stats.blk++;
+	if (++log->fill_blk == log->batch_blk) {
+		submit_batch(log);
+	}
+}
+
+/**
+ * submit_batch
+ */
+static void submit_batch(sd_log log)
+{
+	struct wr_job job;
+
+	job.idx = log->fill;
+	job.n = log->fill_blk;
+	job.seq = ((struct blk_hdr *) log->buf[log->fill])->seq;
+	xQueueSend(log->wr_que, &job, portMAX_DELAY);
+	if (pdFALSE == xQueueReceive(log->free_que, &log->fill, 0)) {
+		log->stats.stall++;
+		xQueueReceive(log->free_que, &log->fill, portMAX_DELAY);
+	}
+	log->fill_blk = 0;
+}
+
+/**
+ * rd_blk
+ */
+static int rd_blk(sd_log log, uint32_t seq, uint32_t *blk, boolean_t *vld)
+{
+	struct blk_hdr *hdr = (struct blk_hdr *) blk;
+	uint32_t crc;
+	int ret;
+
+	hsmci_lock();
+	ret = hsmci_read_blocks(log->start_lba + (seq - 1) % log->blk_cnt, 1, blk);
+	hsmci_unlock();
+	if (ret) {
+		return (ret);
+	}
+	memcpy(&crc, (uint8_t *) blk + CRC_OFS, 4);
+	*vld = hdr->magic == BLK_MAGIC && hdr->len <= PAYLOAD_SIZE &&
+	       crc == crc32((uint8_t *) blk, CRC_OFS);
+	return (0);
+}
+
+/**
+ * crc32
+ *
+ * CRC-32 (IEEE 802.3), nibble table.
+ */
+static uint32_t crc32(const uint8_t *p, int len)
+{
+	uint32_t crc = ~0U;
+
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ crc_tbl[crc & 0xF];
+		crc = (crc >> 4) ^ crc_tbl[crc & 0xF];
+	}
+	return (~crc);
+}
+
+#if TERMOUT == 1
+/**
+ * log_sd_log_stats
+ */
+void log_sd_log_stats(sd_log log)
+{
+	UBaseType_t pr;
+
+	pr = uxTaskPriorityGet(NULL);
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	msg(INF, "sd_log.c: old_seq=%u wr_seq=%u next_seq=%u err=%d\n", log->old_seq, log->wr_seq,
+	    log->next_seq, log->err);
+	msg(INF, "sd_log.c: rec=%u blk=%u batch=%u wr_err=%u wr_ms_max=%u stall=%u\n", log->stats.rec,
+	    log->stats.blk, log->stats.batch, log->stats.wr_err, log->stats.wr_ms_max, log->stats.stall);
+	vTaskPrioritySet(NULL, pr);
+}
+#endif
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * sd_log.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file sd_log.h
+ *
+ * @brief Append-only log-structured record store on raw SD card blocks.
+ *
+ * Records (timestamp + up to SD_LOG_REC_MAX bytes) are packed into 512-byte
+ * blocks of a reserved LBA region. Blocks are collected in two RAM batches
+ * of batch_blk blocks; a full batch is written by the SDLOG task with one
+ * multi-block command while the producer fills the other batch, so the
+ * store runs close to the sequential write bandwidth of the card and the
+ * producer blocks only when both batches are waiting for the card.
+ *
+ * Key characteristics:
+ * - Block format: header (magic, sequence number, first/last record time,
+ *   payload length, record count), packed records, CRC-32 in the last 4 bytes.
+ * - Circular region: block with sequence number seq is stored at region
+ *   block (seq - 1) % blk_cnt; the oldest blocks are overwritten on wrap.
+ * - Recovery: init_sd_log() finds the head after power loss by a binary search
+ *   over sequence numbers (O(log blk_cnt) block reads). Records of a batch not
+ *   written before power loss are lost. If that batch damaged region block 0
+ *   (the wrap), the pass is anchored on the first valid of the following
+ *   batch_blk blocks, so history and sequence numbering are kept.
+ * - Time range reading: sd_log_find() locates the first block of a time range
+ *   by a binary search over block times, sd_log_next() iterates records.
+ *   Record timestamps must be non-decreasing.
+ * - One producer task calls sd_log_append()/sd_log_sync(); iterators may run
+ *   in other tasks. HSMCI access of the store is serialized by hsmci_lock()
+ *   with the other users of the card.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when SD_LOG == 1. Requires
+ *   HSMCI_SD == 1.
+ * - SD_LOG_TASK_STACK_SIZE and SD_LOG_TASK_PRIO must be defined in sysconf.h.
+ */
+
+#ifndef SD_LOG_H
+#define SD_LOG_H
+
+#ifndef SD_LOG
+ #define SD_LOG 0
+#endif
+
+#if SD_LOG == 1
+
+#define SD_LOG_BLK_SIZE 512
+#define SD_LOG_HDR_SIZE 20
+#define SD_LOG_REC_HDR_SIZE 6
+/** Maximal record data length. */
+#define SD_LOG_REC_MAX (SD_LOG_BLK_SIZE - SD_LOG_HDR_SIZE - 4 - SD_LOG_REC_HDR_SIZE)
+
+/**
+ * @struct sd_log_stats.
+ *
+ * @brief Store counters.
+ */
+struct sd_log_stats {
+	unsigned int rec;	/**< Appended records. */
+	unsigned int blk;	/**< Closed blocks. */
+	unsigned int batch;	/**< Written batches. */
+	unsigned int wr_err;	/**< Failed batch writes. */
+	unsigned int wr_ms_max;	/**< Maximal batch write time in ms. */
+	unsigned int stall;	/**< Appends which waited for a free batch. */
+};
+
+typedef struct sd_log_dsc *sd_log;
+
+/**
+ * @struct sd_log_dsc.
+ *
+ * @brief Store descriptor.
+ */
+struct sd_log_dsc {
+	size_t start_lba;	/**< Set by caller: First LBA of the region. */
+	unsigned int blk_cnt;	/**< Set by caller: Region size in blocks (> batch_blk). */
+	int batch_blk;		/**< Set by caller: Blocks per batch (1..511). */
+	void *buf[2];		/**< Set by caller: Two batch buffers of batch_blk * 512 B (32-bit aligned). */
+	TaskHandle_t tsk;
+	QueueHandle_t wr_que;
+	QueueHandle_t free_que;
+	int fill;
+	int fill_blk;
+	boolean_t open;
+	uint32_t next_seq;
+	uint32_t wr_seq;
+	uint32_t old_seq;
+	int err;
+	struct sd_log_stats stats;
+};
+
+/**
+ * @struct sd_log_iter.
+ *
+ * @brief Record iterator (see sd_log_find()).
+ */
+struct sd_log_iter {
+	sd_log log;
+	uint32_t seq;
+	uint32_t end_seq;
+	uint32_t tm_from;
+	uint32_t tm_to;
+	int pos;
+	boolean_t ld;
+	uint32_t blk[SD_LOG_BLK_SIZE / 4];
+};
+
+/**
+ * @brief Recover the store state from the card and create the SDLOG task.
+ *
+ * Call after the card is initialized. An unformatted region is an empty log.
+ *
+ * @param log Store descriptor.
+ *
+ * @return 0 - success; -EHW on card error; -EFMT if the region content does
+ *         not match the descriptor (blk_cnt changed).
+ */
+int init_sd_log(sd_log log);
+
+/**
+ * @brief Append a record.
+ *
+ * Blocks while both batches are waiting for the card.
+ *
+ * @param log  Store descriptor.
+ * @param tm   Record timestamp (non-decreasing, caller defined unit).
+ * @param data Record data.
+ * @param len  Data length (1..SD_LOG_REC_MAX).
+ *
+ * @return 0 - success; error of a previous failed batch write (sticky).
+ */
+int sd_log_append(sd_log log, uint32_t tm, const void *data, int len);
+
+/**
+ * @brief Write the current partial block and batch and wait for the card.
+ *
+ * The rest of the current block stays unused.
+ *
+ * @param log Store descriptor.
+ *
+ * @return 0 - success; error of a failed batch write.
+ */
+int sd_log_sync(sd_log log);
+
+/**
+ * @brief Start iteration over records in the time range [tm_from, tm_to].
+ *
+ * Only records written to the card when this function is called are visited.
+ *
+ * @param log     Store descriptor.
+ * @param tm_from First record time.
+ * @param tm_to   Last record time.
+ * @param it      Iterator (return).
+ *
+ * @return 0 - success; -EHW on card error; -EDATA if a block is damaged.
+ */
+int sd_log_find(sd_log log, uint32_t tm_from, uint32_t tm_to, struct sd_log_iter *it);
+
+/**
+ * @brief Read the next record of the iteration.
+ *
+ * @param it   Iterator.
+ * @param tm   Record timestamp (return).
+ * @param data Record data (return).
+ * @param size Size of data.
+ *
+ * @return Record length; 0 at the end of the range; -EBFOV if the record
+ *         does not fit into data; -EDATA if a block is damaged or was
+ *         overwritten meanwhile; -EHW on card error.
+ */
+int sd_log_next(struct sd_log_iter *it, uint32_t *tm, void *data, int size);
+
+#if TERMOUT == 1
+/**
+ * @brief Log store state and counters (terminal output).
+ *
+ * @param log Store descriptor.
+ */
+void log_sd_log_stats(sd_log log);
+#endif
+
+#endif
+
+#endif
@@ -56,9 +56,21 @@ static spibus smi1;
 #endif
 
 static boolean_t trans_poll(spibus bus, void *buf, int size);
-static unsigned int csr_reg(spi_csel csel);
-static enum spi_pcs pcs_fld(enum spi_csel_num csn);
+static boolean_t trans_poll_8(spibus bus, uint8_t *buf, int size);
+static boolean_t trans_poll_16(spibus bus, uint16_t *buf, int size);
+#if SPI_POLL_BENCH == 1
+static boolean_t trans_poll_legacy(spibus bus, void *buf, int size);
+static boolean_t poll_legacy;
+#endif
+static unsigned int csr_reg(spibus bus, spi_csel csel);
+static unsigned int pcs_fld(spibus bus, enum spi_csel_num csn);
 static BaseType_t spi_hndlr(spibus bus);
+#if SPI_CSEL_STATS == 1
+static void upd_csel_stats(spi_csel csel, uint32_t t0, uint32_t t1, int units, enum spi_err_kind ek);
+ #define set_err_kind(k) (ek = (k))
+#else
+ #define set_err_kind(k)
+#endif
 
 /**
  * init_spi
@@ -98,6 +110,10 @@ void init_spi(spibus bus)
  #error "ID_SPI not defined"
 #endif
 	memset(&bus->stats, 0, sizeof(struct spi_stats));
+#if SPI_CSEL_STATS == 1
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
 	if (bus->sig == NULL) {
 		if (NULL == (bus->sig = xSemaphoreCreateBinary())) {
 			crit_err_exit(MALLOC_ERROR);
@@ -111,7 +127,12 @@ void init_spi(spibus bus)
 	((Spi *) bus->mmio)->SPI_PTCR = SPI_PTCR_RXTDIS | SPI_PTCR_TXTDIS;
 	((Spi *) bus->mmio)->SPI_IDR = ~0;
 	NVIC_ClearPendingIRQ(bus->id);
-	((Spi *) bus->mmio)->SPI_MR = SPI_MR_DLYBCS(bus->dlybcs) | SPI_MR_MODFDIS | SPI_MR_MSTR;
+	if (bus->pcsdec) {
+		((Spi *) bus->mmio)->SPI_MR = SPI_MR_DLYBCS((bus->dlybcs > bus->dec_dly) ? bus->dlybcs : bus->dec_dly) |
+					      SPI_MR_PCSDEC | SPI_MR_MODFDIS | SPI_MR_MSTR;
+	} else {
+		((Spi *) bus->mmio)->SPI_MR = SPI_MR_DLYBCS(bus->dlybcs) | SPI_MR_MODFDIS | SPI_MR_MSTR;
+	}
 	NVIC_SetPriority(bus->id, configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY);
 	NVIC_EnableIRQ(bus->id);
 	disable_periph_clk(bus->id);
@@ -124,20 +145,34 @@ int spi_trans(spibus bus, spi_csel csel, void *buf0, int size0, void *buf1, int
               boolean_t dma)
 {
 	int ret = 0;
-	unsigned int ui, sr;
+	unsigned int ui, sr, mr;
+	int csr_idx;
+#if SPI_CSEL_STATS == 1
+	uint32_t t0, t1;
+	enum spi_err_kind ek = SPI_ERR_KIND_NUM;
+#endif
 
 	if (size0 <= 0) {
 		crit_err_exit(BAD_PARAMETER);
 	}
+#if SPI_CSEL_STATS == 1
+	t0 = DWT->CYCCNT;
+#endif
 	if (bus->mtx != NULL && !csel->csel_ext) {
 		xSemaphoreTake(bus->mtx, portMAX_DELAY);
 	}
+#if SPI_CSEL_STATS == 1
+	t1 = DWT->CYCCNT;
+#endif
 #if SPI_CSEL_LINE_ERR == 1
 	if (!csel->csel_ext && !(((Pio *) csel->csel_cont)->PIO_PDSR & csel->csel_pin)) {
 		bus->stats.csel_err = 1;
 		if (bus->mtx != NULL) {
 			xSemaphoreGive(bus->mtx);
 		}
+#if SPI_CSEL_STATS == 1
+		upd_csel_stats(csel, t0, t1, 0, SPI_ERR_CSEL);
+#endif
 		return (-EHW);
 	}
 #endif
@@ -145,24 +180,29 @@ int spi_trans(spibus bus, spi_csel csel, void *buf0, int size0, void *buf1, int
 	enable_periph_clk(bus->id);
 	ui = ((Spi *) bus->mmio)->SPI_MR;
 	ui &= ~SPI_MR_PCS_Msk;
-	if ((ui & (SPI_MR_MODFDIS | SPI_MR_MSTR)) != (SPI_MR_MODFDIS | SPI_MR_MSTR)) {
+	mr = SPI_MR_MODFDIS | SPI_MR_MSTR | ((bus->pcsdec) ? SPI_MR_PCSDEC : 0);
+	if ((ui & (SPI_MR_MODFDIS | SPI_MR_MSTR | SPI_MR_PCSDEC)) != mr) {
 		bus->stats.mr_cfg_err = 1;
+		set_err_kind(SPI_ERR_MR_CFG);
 		ret = -EHW;
 		goto err_exit;
 	}
-	ui |= SPI_MR_PCS(pcs_fld(csel->csn));
+	ui |= SPI_MR_PCS(pcs_fld(bus, csel->csn));
 	((Spi *) bus->mmio)->SPI_MR = ui;
+	// With PCSDEC, SPI_CSRn serves decoder outputs 4n..4n+3 and is reloaded per device.
+	csr_idx = (bus->pcsdec) ? csel->csn >> 2 : csel->csn;
 	if (csel->ini) {
-		((Spi *) bus->mmio)->SPI_CSR[csel->csn] = csel->csr = csr_reg(csel);
+		((Spi *) bus->mmio)->SPI_CSR[csr_idx] = csel->csr = csr_reg(bus, csel);
 		csel->ini = FALSE;
 	} else {
-		((Spi *) bus->mmio)->SPI_CSR[csel->csn] = csel->csr;
+		((Spi *) bus->mmio)->SPI_CSR[csr_idx] = csel->csr;
 	}
 	((Spi *) bus->mmio)->SPI_CR = SPI_CR_SPIEN;
 	sr = ((Spi *) bus->mmio)->SPI_SR;
 	sr &= SPI_SR_TDRE | SPI_SR_TXEMPTY;
 	if (sr != (SPI_SR_TDRE | SPI_SR_TXEMPTY)) {
 		bus->stats.tx_start_err = 1;
+		set_err_kind(SPI_ERR_TX_START);
 		ret = -EHW;
 		goto err_exit;
 	}
@@ -182,6 +222,7 @@ int spi_trans(spibus bus, spi_csel csel, void *buf0, int size0, void *buf1, int
 			((Spi *) bus->mmio)->SPI_IDR = ~0;
                         xSemaphoreTake(bus->sig, 0);
                         bus->stats.dma_err = 1;
+			set_err_kind(SPI_ERR_DMA);
 			ret = -EDMA;
 			goto err_exit;
 		}
@@ -190,6 +231,7 @@ int spi_trans(spibus bus, spi_csel csel, void *buf0, int size0, void *buf1, int
 		    ((Spi *) bus->mmio)->SPI_RCR || ((Spi *) bus->mmio)->SPI_TCR ||
 		    ((Spi *) bus->mmio)->SPI_RNCR || ((Spi *) bus->mmio)->SPI_TNCR) {
 			bus->stats.dma_err = 1;
+			set_err_kind(SPI_ERR_DMA);
 			ret = -EDMA;
 			goto err_exit;
 		}
@@ -213,16 +255,19 @@ int spi_trans(spibus bus, spi_csel csel, void *buf0, int size0, void *buf1, int
 		    csel->size0 || csel->size1) {
 			((Spi *) bus->mmio)->SPI_IDR = ~0;
                         bus->stats.rdrf_err = 1;
+			set_err_kind(SPI_ERR_RDRF);
 			ret = -EHW;
 			goto err_exit;
 		}
 	} else {
 		if (!trans_poll(bus, buf0, size0)) {
+			set_err_kind(SPI_ERR_POLL);
 			ret = -EHW;
 			goto err_exit;
 		}
                 if (size1 > 0) {
 			if (!trans_poll(bus, buf1, size1)) {
+				set_err_kind(SPI_ERR_POLL);
 				ret = -EHW;
 				goto err_exit;
 			}
@@ -236,6 +281,7 @@ int spi_trans(spibus bus, spi_csel csel, void *buf0, int size0, void *buf1, int
 	}
 	if (cnt == HW_RESP_TMOUT) {
 		bus->stats.tx_end_err = 1;
+		set_err_kind(SPI_ERR_TX_END);
 		ret = -EHW;
 		goto err_exit;
 	}
@@ -247,19 +293,167 @@ err_exit:
 #if SPI_CSEL_LINE_ERR == 1
 	if (!csel->csel_ext && !ret && !(((Pio *) csel->csel_cont)->PIO_PDSR & csel->csel_pin)) {
 		bus->stats.csel_err = 1;
+		set_err_kind(SPI_ERR_CSEL);
 		ret = -EHW;
 	}
 #endif
 	if (bus->mtx != NULL && !csel->csel_ext) {
 		xSemaphoreGive(bus->mtx);
 	}
+#if SPI_CSEL_STATS == 1
+	upd_csel_stats(csel, t0, t1, (ret) ? 0 : size0 + size1, ek);
+#endif
 	return (ret);
 }
 
+#if SPI_CSEL_STATS == 1
+/**
+ * upd_csel_stats
+ */
+static void upd_csel_stats(spi_csel csel, uint32_t t0, uint32_t t1, int units, enum spi_err_kind ek)
+{
+	uint32_t t2, wt, xt;
+	int n;
+
+	t2 = DWT->CYCCNT;
+	wt = t1 - t0;
+	xt = t2 - t1;
+	n = 31 - __CLZ((t2 - t0) | 1);
+	if (n >= SPI_LAT_HIST_SZ) {
+		n = SPI_LAT_HIST_SZ - 1;
+	}
+	taskENTER_CRITICAL();
+	csel->stats.trans++;
+	if (ek != SPI_ERR_KIND_NUM) {
+		csel->stats.err[ek]++;
+	} else {
+		csel->stats.bytes += (csel->bits == SPI_8_BIT_TRANS) ? units : 2 * units;
+	}
+	csel->stats.wait_cyc += wt;
+	if (wt > csel->stats.wait_max) {
+		csel->stats.wait_max = wt;
+	}
+	csel->stats.xfer_cyc += xt;
+	if (xt > csel->stats.xfer_max) {
+		csel->stats.xfer_max = xt;
+	}
+	csel->stats.lat_hist[n]++;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * get_spi_csel_stats
+ */
+void get_spi_csel_stats(spi_csel csel, struct spi_csel_stats *st)
+{
+	taskENTER_CRITICAL();
+	*st = csel->stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * clear_spi_csel_stats
+ */
+void clear_spi_csel_stats(spi_csel csel)
+{
+	taskENTER_CRITICAL();
+	memset(&csel->stats, 0, sizeof(struct spi_csel_stats));
+	taskEXIT_CRITICAL();
+}
+#endif
+
 /**
  * trans_poll
  */
 static boolean_t trans_poll(spibus bus, void *buf, int size)
+{
+#if SPI_POLL_BENCH == 1
+	if (poll_legacy) {
+		return (trans_poll_legacy(bus, buf, size));
+	}
+#endif
+	if (bus->act_csel->bits == SPI_8_BIT_TRANS) {
+		return (trans_poll_8(bus, buf, size));
+	} else {
+		return (trans_poll_16(bus, buf, size));
+	}
+}
+
+/**
+ * trans_poll_8
+ *
+ * Pipelined polling loop for 8-bit transfers. The next element is written to
+ * SPI_TDR as soon as TDRE is set while the previous one is still in the shift
+ * register, so at most two elements are in flight and SCK runs back-to-back.
+ */
+static boolean_t trans_poll_8(spibus bus, uint8_t *buf, int size)
+{
+	Spi *spi = bus->mmio;
+	uint8_t *tx = buf, *rx = buf, *end = buf + size;
+	unsigned int sr;
+	int cnt = 0;
+
+	spi->SPI_TDR = *tx++;
+	while (rx < end) {
+		sr = spi->SPI_SR;
+		if (sr & SPI_SR_RDRF) {
+			*rx++ = spi->SPI_RDR;
+			cnt = 0;
+		} else if (++cnt == HW_RESP_TMOUT) {
+			bus->stats.poll_err = 1;
+			return (FALSE);
+		}
+		if (sr & SPI_SR_TDRE && tx < end && tx - rx < 2) {
+			spi->SPI_TDR = *tx++;
+		}
+		if (sr & SPI_SR_OVRES) {
+			bus->stats.poll_err = 1;
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
+/**
+ * trans_poll_16
+ *
+ * Pipelined polling loop for 9..16-bit transfers (see trans_poll_8).
+ */
+static boolean_t trans_poll_16(spibus bus, uint16_t *buf, int size)
+{
+	Spi *spi = bus->mmio;
+	uint16_t *tx = buf, *rx = buf, *end = buf + size;
+	unsigned int sr;
+	int cnt = 0;
+
+	spi->SPI_TDR = *tx++;
+	while (rx < end) {
+		sr = spi->SPI_SR;
+		if (sr & SPI_SR_RDRF) {
+			*rx++ = spi->SPI_RDR;
+			cnt = 0;
+		} else if (++cnt == HW_RESP_TMOUT) {
+			bus->stats.poll_err = 1;
+			return (FALSE);
+		}
+		if (sr & SPI_SR_TDRE && tx < end && tx - rx < 2) {
+			spi->SPI_TDR = *tx++;
+		}
+		if (sr & SPI_SR_OVRES) {
+			bus->stats.poll_err = 1;
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
+#if SPI_POLL_BENCH == 1
+/**
+ * trans_poll_legacy
+ *
+ * Original one-element-at-a-time polling loop, kept as benchmark reference.
+ */
+static boolean_t trans_poll_legacy(spibus bus, void *buf, int size)
 {
 	int cnt;
 
@@ -287,17 +481,76 @@ static boolean_t trans_poll(spibus bus, void *buf, int size)
 	return (TRUE);
 }
 
+/**
+ * spi_poll_bench
+ */
+int spi_poll_bench(spibus bus, spi_csel csel, void *buf, int size,
+		   struct spi_poll_bench_res *res, int num)
+{
+	int scbr, ret;
+	boolean_t intr;
+	uint32_t t0;
+
+	if (size <= 0 || num <= 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	scbr = csel->scbr;
+	intr = csel->no_dma_intr;
+	csel->no_dma_intr = FALSE;
+	ret = 0;
+	for (int i = 0; i < num; i++) {
+		csel->scbr = res[i].scbr;
+		csel->ini = TRUE;
+		poll_legacy = TRUE;
+		t0 = DWT->CYCCNT;
+		if ((ret = spi_trans(bus, csel, buf, size, NULL, 0, DMA_OFF))) {
+			break;
+		}
+		res[i].legacy_cyc = DWT->CYCCNT - t0;
+		poll_legacy = FALSE;
+		t0 = DWT->CYCCNT;
+		if ((ret = spi_trans(bus, csel, buf, size, NULL, 0, DMA_OFF))) {
+			break;
+		}
+		res[i].pipe_cyc = DWT->CYCCNT - t0;
+		res[i].wire_cyc = (unsigned int) size * (csel->bits + 8) * res[i].scbr;
+	}
+	poll_legacy = FALSE;
+	csel->scbr = scbr;
+	csel->no_dma_intr = intr;
+	csel->ini = TRUE;
+	return (ret);
+}
+
+#if TERMOUT == 1
+/**
+ * log_spi_poll_bench
+ */
+void log_spi_poll_bench(spibus bus, struct spi_poll_bench_res *res, int num)
+{
+	for (int i = 0; i < num; i++) {
+		msg(INF, "spi.c: bus=%s bench scbr=%d wire=%u legacy=%u pipe=%u (cycles)\n",
+		    bus->nm, res[i].scbr, res[i].wire_cyc, res[i].legacy_cyc, res[i].pipe_cyc);
+	}
+}
+#endif
+#endif
+
 /**
  * csr_reg
  */
-static unsigned int csr_reg(spi_csel csel)
+static unsigned int csr_reg(spibus bus, spi_csel csel)
 {
 	unsigned int ui;
+	int dlybs;
 
 	ui = (~csel->mode & 1) << 1 | (csel->mode & 2) >> 1;
 	ui |= csel->bits << SPI_CSR_BITS_Pos |
 	      ((csel->csrise) ? SPI_CSR_CSNAAT : SPI_CSR_CSAAT);
-	ui |= SPI_CSR_DLYBCT(csel->dlybct) | SPI_CSR_DLYBS(csel->dlybs) |
+	dlybs = (bus->pcsdec && bus->dec_dly > csel->dlybs) ? bus->dec_dly : csel->dlybs;
+	ui |= SPI_CSR_DLYBCT(csel->dlybct) | SPI_CSR_DLYBS(dlybs) |
 	      SPI_CSR_SCBR(csel->scbr);
 	return (ui);
 }
@@ -305,8 +558,15 @@ static unsigned int csr_reg(spi_csel csel)
 /**
  * pcs_fld
  */
-static enum spi_pcs pcs_fld(enum spi_csel_num csn)
+static unsigned int pcs_fld(spibus bus, enum spi_csel_num csn)
 {
+	if (bus->pcsdec) {
+		// Decoder output number is driven directly on NPCS[3:0]; 15 selects no device.
+		if (csn < SPI_CSEL0 || csn > SPI_CSEL14) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		return (csn);
+	}
 	if (csn == SPI_CSEL0) {
 		return (SPI_PCS0);
 	} else if (csn == SPI_CSEL1) {
@@ -515,6 +775,42 @@ void log_spi_stats(spibus bus)
 	msg(INF, "spi.c: intr=%u\n", bus->stats.intr);
 	vTaskPrioritySet(NULL, pr);
 }
+
+#if SPI_CSEL_STATS == 1
+/**
+ * log_spi_csel_stats
+ */
+void log_spi_csel_stats(spibus bus, spi_csel csel, const char *nm)
+{
+	static const char *const ek_nm[SPI_ERR_KIND_NUM] = {
+		"tx_start", "tx_end", "mr_cfg", "dma", "rdrf", "poll", "csel"
+	};
+	struct spi_csel_stats st;
+	unsigned int cyc_us = F_MCK / 1000000;
+
+	get_spi_csel_stats(csel, &st);
+	msg(INF, "spi.c: bus=%s dev=%s trans=%u bytes=%u\n", bus->nm, nm, st.trans, st.bytes);
+	if (st.trans) {
+		msg(INF, "spi.c: wait avg=%uus max=%uus xfer avg=%uus max=%uus\n",
+		    (unsigned int) (st.wait_cyc / st.trans) / cyc_us, st.wait_max / cyc_us,
+		    (unsigned int) (st.xfer_cyc / st.trans) / cyc_us, st.xfer_max / cyc_us);
+	}
+	msg(INF, "spi.c: errors=");
+	for (int i = 0; i < SPI_ERR_KIND_NUM; i++) {
+		if (st.err[i]) {
+			msg(INF, "%s:%u ", ek_nm[i], st.err[i]);
+		}
+	}
+	msg(INF, "\n");
+	msg(INF, "spi.c: lat_hist(2^n cyc)=");
+	for (int i = 0; i < SPI_LAT_HIST_SZ; i++) {
+		if (st.lat_hist[i]) {
+			msg(INF, "%d:%u ", i, st.lat_hist[i]);
+		}
+	}
+	msg(INF, "\n");
+}
+#endif
 #endif
 
 #endif
@@ -27,6 +27,13 @@
  *
  * Key characteristics:
  * - Master mode only. Fixed peripheral select.
+ * - Chip select decoding: with spi_dsc.pcsdec == TRUE the NPCS[3:0] lines drive an
+ *   external 4-to-16 decoder and up to 15 devices (SPI_CSEL0..SPI_CSEL14) get hardware
+ *   timed chip selects. The SPI has only four SPI_CSRn registers, each one shared by
+ *   decoder outputs 4n..4n+3; spi_trans() reloads it from csel->csr on every
+ *   transaction, so each device still keeps its own mode, SCBR, DLYBS and DLYBCT.
+ *   spi_dsc.dec_dly is applied as the minimal DLYBS and DLYBCS value, so decoder
+ *   outputs settle before SCK starts and between two devices.
  * - Two-segment transaction model: buf0 + buf1 (current + next). In DMA mode this
  *   maps directly to the SPI PDC double-buffer registers.
  * - Transfer width 8..16 bits is supported via enum spi_bits. For 8-bit transfers
@@ -34,6 +41,13 @@
  *   of uint16_t.
  * - Optional PDC (SPI PDC) usage when dma == DMA_ON; otherwise the driver uses either
  *   interrupt-driven pumping or polling, selected by spi_csel_dcs.no_dma_intr.
+ * - Polling mode is pipelined: the next element is preloaded into SPI_TDR while the
+ *   previous one is still shifting, so SCK runs back-to-back. Interrupts stay
+ *   enabled. Limit: if the polling task is preempted (or delayed by interrupts)
+ *   for longer than one element time, the receive register overruns; the
+ *   transaction is then reported as -EHW with the poll_err flag set and may be
+ *   repeated by the caller. Transfers which must not fail this way on a loaded
+ *   system should use PDC or interrupt mode.
  *
  * IMPORTANT behavior:
  * - Full duplex and in-place buffering: transmitted elements are overwritten by received
@@ -42,6 +56,8 @@
  *
  * Recommendations for correct and robust use:
  * - Always set spi_dsc members marked as "Set by caller" before calling init_spi().
+ * - On a decoded bus prefer distinct devices over csel_ext GPIO chip selects: the bus
+ *   mutex then serializes all of them and no GPIO toggling is needed.
  * - For each slave, configure a dedicated spi_csel_dcs. Whenever you change any of its
  *   public configuration fields, set csel->ini = TRUE so that spi_trans() recomputes and
  *   programs SPI_CSR[csn].
@@ -57,6 +73,13 @@
  * - The content of this header is enabled only when SPIBUS == 1.
  * - If SPI_CSEL_LINE_ERR == 1, optional chip select GPIO line checks are enabled and
  *   require spi_csel_dcs.csel_pin/csel_cont to be set when csel_ext is FALSE.
+ * - If SPI_POLL_BENCH == 1, spi_poll_bench() is available. It compares the pipelined
+ *   polling loop with the original one-element-at-a-time loop using the DWT cycle
+ *   counter.
+ * - If SPI_CSEL_STATS == 1, spi_trans() keeps per chip select counters (transactions,
+ *   bytes, mutex wait and transfer time, error kinds, log2 latency histogram) in
+ *   spi_csel_dcs.stats. Timestamps are taken from DWT CYCCNT (enabled by init_spi()).
+ *   Use get_spi_csel_stats() for a consistent snapshot.
  *
  * Timing helpers:
  * - spi_dlybcs_*(), spi_dlybs_*(), spi_dlybct_*() macros compute register field values
@@ -76,18 +99,44 @@
  #define SPI_HAL_IMPL 0
 #endif
 
+#ifndef SPI_POLL_BENCH
+ #define SPI_POLL_BENCH 0
+#endif
+
+#ifndef SPI_CSEL_STATS
+ #define SPI_CSEL_STATS 0
+#endif
+
+#ifndef SPI_LAT_HIST_SZ
+ #define SPI_LAT_HIST_SZ 24
+#endif
+
 #if SPIBUS == 1
 
 /**
  * @enum spi_csel_num.
  *
  * @brief SPI chip select number (maps to SPI_CSR[0..3] and NPCS lines).
+ *
+ * SPI_CSEL4..SPI_CSEL14 are valid only on a bus with spi_dsc.pcsdec set, where
+ * the number is the output of the external 4-to-16 decoder.
  */
 enum spi_csel_num {
 	SPI_CSEL0,
 	SPI_CSEL1,
 	SPI_CSEL2,
-	SPI_CSEL3
+	SPI_CSEL3,
+	SPI_CSEL4,
+	SPI_CSEL5,
+	SPI_CSEL6,
+	SPI_CSEL7,
+	SPI_CSEL8,
+	SPI_CSEL9,
+	SPI_CSEL10,
+	SPI_CSEL11,
+	SPI_CSEL12,
+	SPI_CSEL13,
+	SPI_CSEL14
 };
 
 /**
@@ -127,6 +176,43 @@ struct spi_stats {
 	unsigned int intr;
 };
 
+#if SPI_CSEL_STATS == 1
+/**
+ * @enum spi_err_kind.
+ *
+ * @brief Kind of spi_trans() failure (index to spi_csel_stats.err).
+ */
+enum spi_err_kind {
+	SPI_ERR_TX_START,
+	SPI_ERR_TX_END,
+	SPI_ERR_MR_CFG,
+	SPI_ERR_DMA,
+	SPI_ERR_RDRF,
+	SPI_ERR_POLL,
+	SPI_ERR_CSEL,
+	SPI_ERR_KIND_NUM
+};
+
+/**
+ * @struct spi_csel_stats.
+ *
+ * @brief Per chip select transaction counters (times in core clock cycles).
+ *
+ * Latency of a transaction (mutex wait + transfer) is counted in lat_hist[n] where
+ * 2^n <= latency < 2^(n+1); the last bin also holds all longer transactions.
+ */
+struct spi_csel_stats {
+	unsigned int trans;		/**< Transactions (including failed ones). */
+	unsigned int bytes;		/**< Bytes transferred by successful transactions. */
+	unsigned int err[SPI_ERR_KIND_NUM]; /**< Failed transactions by kind. */
+	unsigned int wait_max;		/**< Longest bus mutex wait. */
+	unsigned int xfer_max;		/**< Longest transfer (mutex held). */
+	uint64_t wait_cyc;		/**< Sum of bus mutex waits. */
+	uint64_t xfer_cyc;		/**< Sum of transfer times. */
+	unsigned int lat_hist[SPI_LAT_HIST_SZ];
+};
+#endif
+
 typedef struct spi_dsc *spibus;
 typedef struct spi_csel_dcs *spi_csel;
 
@@ -143,6 +229,8 @@ struct spi_dsc {
 	int id;			/**< Set by caller: Peripheral ID (e.g., ID_SPI / ID_SPI0 / ID_SPI1). */
 	SemaphoreHandle_t mtx;	/**< Set by caller: Optional mutex protecting the SPI bus, or NULL. */
 	int dlybcs;		/**< Set by caller: SPI_MR.DLYBCS field value (use spi_dlybcs_ns/us helpers). */
+	boolean_t pcsdec;	/**< Set by caller: TRUE -> NPCS[3:0] drive an external 4-to-16 decoder (SPI_MR.PCSDEC). */
+	int dec_dly;		/**< Set by caller: Decoder propagation delay in MCK cycles (use spi_dlybs_ns/us helpers). */
 	const char *nm;
 	void *mmio;
 	SemaphoreHandle_t sig;
@@ -228,6 +316,9 @@ struct spi_csel_dcs {
 	int size1;
 	unsigned int stats_trans;
 	unsigned int csr;
+#if SPI_CSEL_STATS == 1
+	struct spi_csel_stats stats;
+#endif
 };
 
 /**
@@ -235,13 +326,14 @@ struct spi_csel_dcs {
  *
  * This function binds @p bus to the selected SPI instance (SPI/SPI0/SPI1), creates
  * an internal binary semaphore used for transfer completion signaling, configures
- * SPI_MR (master mode, MODFDIS, DLYBCS), and enables the corresponding SPI IRQ in NVIC.
+ * SPI_MR (master mode, MODFDIS, DLYBCS, PCSDEC), and enables the corresponding SPI IRQ
+ * in NVIC.
  *
  * The peripheral clock is enabled only during initialization; spi_trans() enables and
  * disables the peripheral clock around each transaction.
  *
  * Preconditions:
- * - bus->id, bus->mtx, and bus->dlybcs must be set by the caller.
+ * - bus->id, bus->mtx, bus->dlybcs, bus->pcsdec and bus->dec_dly must be set by the caller.
  * - bus->sig must be NULL (it is created by the driver).
  *
  * @param bus SPI master instance descriptor.
@@ -308,6 +400,77 @@ spibus get_spi_by_per_id(int per_id);
  */
 spibus get_spi_by_dev_id(int dev_id);
 
+#if SPI_POLL_BENCH == 1
+/**
+ * @struct spi_poll_bench_res.
+ *
+ * @brief One result row of spi_poll_bench() (all times in core clock cycles).
+ */
+struct spi_poll_bench_res {
+	int scbr;		 /**< Set by caller: SPI_CSR.SCBR value to benchmark. */
+	unsigned int wire_cyc;	 /**< Theoretical time on the wire (size * bits * SCBR). */
+	unsigned int legacy_cyc; /**< Transaction time with the original polling loop. */
+	unsigned int pipe_cyc;	 /**< Transaction time with the pipelined polling loop. */
+};
+
+/**
+ * @brief Benchmark polling transfer loops at several SCBR values.
+ *
+ * For each entry in @p res, csel->scbr is set to res[i].scbr and the buffer is
+ * transferred twice by spi_trans() in polling mode: once with the original
+ * one-element-at-a-time loop and once with the pipelined loop. Elapsed time of
+ * each transaction is measured with DWT CYCCNT (enabled by this function). The
+ * wire time assumes the core clock equals MCK.
+ *
+ * csel->scbr and csel->no_dma_intr are restored on return.
+ *
+ * @param bus  SPI master instance descriptor.
+ * @param csel Chip select descriptor of a device which tolerates dummy data.
+ * @param buf  Transfer buffer (content is overwritten by received data).
+ * @param size Number of transfer units in buf; must be > 0.
+ * @param res  Result array; res[i].scbr set by caller.
+ * @param num  Number of entries in res.
+ *
+ * @return 0 on success; error code of the failing spi_trans() otherwise.
+ */
+int spi_poll_bench(spibus bus, spi_csel csel, void *buf, int size,
+		   struct spi_poll_bench_res *res, int num);
+
+#if TERMOUT == 1
+/**
+ * @brief Log results of spi_poll_bench() (terminal output).
+ *
+ * @param bus SPI master instance descriptor.
+ * @param res Result array filled by spi_poll_bench().
+ * @param num Number of entries in res.
+ */
+void log_spi_poll_bench(spibus bus, struct spi_poll_bench_res *res, int num);
+#endif
+#endif
+
+#if SPI_CSEL_STATS == 1
+/**
+ * @brief Copy per chip select counters.
+ *
+ * The copy is taken inside a critical section, so it is consistent even if another
+ * task is running a transaction on @p csel.
+ *
+ * @param csel Chip select descriptor.
+ * @param st   Snapshot (return).
+ */
+void get_spi_csel_stats(spi_csel csel, struct spi_csel_stats *st);
+
+/**
+ * @brief Reset per chip select counters.
+ *
+ * Counters are not reset by csel->ini; chip select descriptors in static storage
+ * start zeroed, others must be cleared by this function before first use.
+ *
+ * @param csel Chip select descriptor.
+ */
+void clear_spi_csel_stats(spi_csel csel);
+#endif
+
 #if TERMOUT == 1
 /**
  * @brief Log SPI driver statistics for a given bus (terminal output).
@@ -315,6 +478,19 @@ spibus get_spi_by_dev_id(int dev_id);
  * @param bus SPI master instance descriptor.
  */
 void log_spi_stats(spibus bus);
+
+#if SPI_CSEL_STATS == 1
+/**
+ * @brief Log per chip select counters (terminal output).
+ *
+ * Prints from a snapshot taken by get_spi_csel_stats(); task priority is not changed.
+ *
+ * @param bus  SPI master instance descriptor.
+ * @param csel Chip select descriptor.
+ * @param nm   Device name used in the output.
+ */
+void log_spi_csel_stats(spibus bus, spi_csel csel, const char *nm);
+#endif
 #endif
 
 #endif
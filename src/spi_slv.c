@@ -0,0 +1,307 @@
+/*
+ * spi_slv.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "msgconf.h"
+#include "hwerr.h"
+#include "pmc.h"
+#include "spi.h"
+#include "spi_slv.h"
+#include <string.h>
+
+#if SPI_SLV == 1
+
+#if SPIBUS == 1
+ #error "SPI_SLV and SPIBUS share the SPI peripheral"
+#endif
+
+static spi_slv sd;
+
+static int arm_buf(spi_slv dev, int idx);
+static boolean_t send_blk_isr(spi_slv dev, int idx, int cnt, boolean_t frm_end, BaseType_t *tsk_wkn);
+
+/**
+ * init_spi_slv
+ */
+void init_spi_slv(spi_slv dev)
+{
+	if (dev->id != ID_SPI || dev->rx_buf[0] == NULL || dev->rx_buf[1] == NULL ||
+	    dev->rx_size < 1 || dev->rx_size > 0xFFFF || dev->bits < 0 || dev->bits > 8 ||
+	    (dev->tx_buf != NULL && (dev->tx_size < 1 || dev->tx_size > 0xFFFF)) || dev->que_sz < 2) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	NVIC_DisableIRQ(ID_SPI);
+	sd = dev;
+	memset(&dev->stats, 0, sizeof(struct spi_slv_stats));
+	if (dev->que == NULL) {
+		if (NULL == (dev->que = xQueueCreate(dev->que_sz, sizeof(struct spi_slv_blk)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	} else {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->cur = dev->nxt = dev->held = -1;
+	dev->run = FALSE;
+	enable_periph_clk(ID_SPI);
+	SPI->SPI_CR = SPI_CR_SWRST;
+	SPI->SPI_CR = SPI_CR_SPIDIS;
+	SPI->SPI_PTCR = SPI_PTCR_RXTDIS | SPI_PTCR_TXTDIS;
+	SPI->SPI_IDR = ~0;
+	SPI->SPI_MR = 0;
+	SPI->SPI_CSR[0] = (~dev->mode & 1) << 1 | (dev->mode & 2) >> 1 | dev->bits << SPI_CSR_BITS_Pos;
+	SPI->SPI_SR;
+	NVIC_ClearPendingIRQ(ID_SPI);
+	NVIC_SetPriority(ID_SPI, configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(ID_SPI);
+	disable_periph_clk(ID_SPI);
+}
+
+/**
+ * spi_slv_start
+ */
+void spi_slv_start(spi_slv dev)
+{
+	if (dev->run) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	xQueueReset(dev->que);
+	enable_periph_clk(ID_SPI);
+	taskENTER_CRITICAL();
+	SPI->SPI_RPR = (unsigned int) dev->rx_buf[0];
+	SPI->SPI_RCR = dev->rx_size;
+	SPI->SPI_RNPR = (unsigned int) dev->rx_buf[1];
+	SPI->SPI_RNCR = dev->rx_size;
+	dev->cur = 0;
+	dev->nxt = 1;
+	dev->held = -1;
+	if (dev->tx_buf != NULL) {
+		SPI->SPI_TPR = (unsigned int) dev->tx_buf;
+		SPI->SPI_TCR = dev->tx_size;
+	} else {
+		SPI->SPI_TCR = 0;
+		SPI->SPI_TDR = 0;
+	}
+	SPI->SPI_TNCR = 0;
+	SPI->SPI_SR;
+	SPI->SPI_IER = SPI_IER_ENDRX | SPI_IER_OVRES | ((dev->nss_frm) ? SPI_IER_NSSR : 0);
+	SPI->SPI_PTCR = SPI_PTCR_RXTEN | ((dev->tx_buf != NULL) ? SPI_PTCR_TXTEN : 0);
+	SPI->SPI_CR = SPI_CR_SPIEN;
+	dev->run = TRUE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * spi_slv_stop
+ */
+void spi_slv_stop(spi_slv dev)
+{
+	taskENTER_CRITICAL();
+	SPI->SPI_IDR = ~0;
+	SPI->SPI_PTCR = SPI_PTCR_RXTDIS | SPI_PTCR_TXTDIS;
+	SPI->SPI_CR = SPI_CR_SPIDIS;
+	dev->cur = dev->nxt = dev->held = -1;
+	dev->run = FALSE;
+	taskEXIT_CRITICAL();
+	disable_periph_clk(ID_SPI);
+}
+
+/**
+ * spi_slv_read
+ */
+int spi_slv_read(spi_slv dev, struct spi_slv_blk *blk, TickType_t tmo)
+{
+	int idx;
+
+	if (dev->held != -1) {
+		taskENTER_CRITICAL();
+		idx = (dev->run) ? arm_buf(dev, dev->held) : -1;
+		dev->held = idx;
+		if (idx != -1) {
+			// Current buffer completed while the released one was armed.
+			dev->stats.blk++;
+			dev->stats.units += dev->rx_size;
+		}
+		taskEXIT_CRITICAL();
+		if (idx != -1) {
+			blk->buf = dev->rx_buf[idx];
+			blk->cnt = dev->rx_size;
+			blk->frm_end = FALSE;
+			return (0);
+		}
+	}
+	if (pdFALSE == xQueueReceive(dev->que, blk, tmo)) {
+		return (-ETMO);
+	}
+	if (blk->buf != NULL) {
+		dev->held = (blk->buf == dev->rx_buf[0]) ? 0 : 1;
+	}
+	return (0);
+}
+
+/**
+ * arm_buf
+ *
+ * Hand buffer idx back to the PDC (caller masks the SPI interrupt). Returns
+ * index of the buffer completed meanwhile by the PDC, or -1.
+ */
+static int arm_buf(spi_slv dev, int idx)
+{
+	int done;
+
+	if (dev->cur == -1) {
+		SPI->SPI_RPR = (unsigned int) dev->rx_buf[idx];
+		SPI->SPI_RCR = dev->rx_size;
+		dev->cur = idx;
+		SPI->SPI_IER = SPI_IER_RXBUFF;
+		SPI->SPI_PTCR = SPI_PTCR_RXTEN;
+		return (-1);
+	}
+	SPI->SPI_RNPR = (unsigned int) dev->rx_buf[idx];
+	SPI->SPI_RNCR = dev->rx_size;
+	if (SPI->SPI_RNCR == 0) {
+		// Current buffer completed and next one was loaded immediately.
+		done = dev->cur;
+		dev->cur = idx;
+		return (done);
+	}
+	dev->nxt = idx;
+	SPI->SPI_IDR = SPI_IDR_RXBUFF;
+	SPI->SPI_IER = SPI_IER_ENDRX;
+	return (-1);
+}
+
+/**
+ * send_blk_isr
+ */
+static boolean_t send_blk_isr(spi_slv dev, int idx, int cnt, boolean_t frm_end, BaseType_t *tsk_wkn)
+{
+	struct spi_slv_blk blk;
+
+	blk.buf = (idx != -1) ? dev->rx_buf[idx] : NULL;
+	blk.cnt = cnt;
+	blk.frm_end = frm_end;
+	if (errQUEUE_FULL == xQueueSendFromISR(dev->que, &blk, tsk_wkn)) {
+		dev->stats.que_full++;
+		return (FALSE);
+	}
+	if (idx != -1) {
+		dev->stats.blk++;
+		dev->stats.units += cnt;
+	}
+	return (TRUE);
+}
+
+/**
+ * SPI_Handler
+ */
+void SPI_Handler(void)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	unsigned int sr;
+	int idx, cnt;
+
+	sr = SPI->SPI_SR;
+	sr &= SPI->SPI_IMR;
+	sd->stats.intr++;
+	if (sr & SPI_SR_OVRES) {
+		sd->stats.ovre++;
+	}
+	if (sr & (SPI_SR_ENDRX | SPI_SR_RXBUFF)) {
+		idx = sd->cur;
+		if (sr & SPI_SR_ENDRX) {
+			// PDC continues with the next buffer.
+			sd->cur = sd->nxt;
+			sd->nxt = -1;
+			SPI->SPI_IDR = SPI_IDR_ENDRX;
+			SPI->SPI_IER = SPI_IER_RXBUFF;
+		} else {
+			sd->cur = -1;
+			sd->stats.starv++;
+			SPI->SPI_IDR = SPI_IDR_RXBUFF;
+			SPI->SPI_PTCR = SPI_PTCR_RXTDIS;
+		}
+		while (idx != -1 && !send_blk_isr(sd, idx, sd->rx_size, FALSE, &tsk_wkn)) {
+			idx = arm_buf(sd, idx);
+		}
+	}
+	if (sr & SPI_SR_NSSR) {
+		sd->stats.frm++;
+		SPI->SPI_PTCR = SPI_PTCR_RXTDIS;
+		cnt = (sd->cur != -1) ? sd->rx_size - SPI->SPI_RCR : 0;
+		if (cnt > 0) {
+			idx = sd->cur;
+			if (sd->nxt != -1) {
+				SPI->SPI_RPR = (unsigned int) sd->rx_buf[sd->nxt];
+				SPI->SPI_RCR = sd->rx_size;
+				SPI->SPI_RNCR = 0;
+				sd->cur = sd->nxt;
+				sd->nxt = -1;
+				SPI->SPI_IDR = SPI_IDR_ENDRX;
+				SPI->SPI_IER = SPI_IER_RXBUFF;
+			} else {
+				sd->cur = -1;
+				SPI->SPI_IDR = SPI_IDR_ENDRX | SPI_IDR_RXBUFF;
+			}
+			if (!send_blk_isr(sd, idx, cnt, TRUE, &tsk_wkn)) {
+				idx = arm_buf(sd, idx);
+				while (idx != -1 && !send_blk_isr(sd, idx, sd->rx_size, FALSE, &tsk_wkn)) {
+					idx = arm_buf(sd, idx);
+				}
+			}
+		} else {
+			send_blk_isr(sd, -1, 0, TRUE, &tsk_wkn);
+		}
+		if (sd->tx_buf != NULL) {
+			SPI->SPI_TPR = (unsigned int) sd->tx_buf;
+			SPI->SPI_TCR = sd->tx_size;
+			SPI->SPI_PTCR = SPI_PTCR_TXTEN;
+		}
+		if (sd->cur != -1) {
+			SPI->SPI_PTCR = SPI_PTCR_RXTEN;
+		}
+	}
+	portEND_SWITCHING_ISR(tsk_wkn);
+}
+
+#if TERMOUT == 1
+/**
+ * log_spi_slv_stats
+ */
+void log_spi_slv_stats(spi_slv dev)
+{
+	UBaseType_t pr;
+
+	pr = uxTaskPriorityGet(NULL);
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	msg(INF, "spi_slv.c: blk=%u frm=%u units=%u intr=%u\n", dev->stats.blk, dev->stats.frm,
+	    dev->stats.units, dev->stats.intr);
+	msg(INF, "spi_slv.c: ovre=%u starv=%u que_full=%u\n", dev->stats.ovre, dev->stats.starv,
+	    dev->stats.que_full);
+	vTaskPrioritySet(NULL, pr);
+}
+#endif
+
+#endif
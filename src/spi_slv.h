@@ -0,0 +1,169 @@
+/*
+ * spi_slv.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @file spi_slv.h
+ *
+ * @brief SPI slave driver with continuous PDC reception for SAM SPI peripheral.
+ *
+ * The SPI peripheral is configured in slave mode and clocked by an external
+ * master. Received data is stored by the SPI PDC into two caller-provided
+ * buffers used as ping-pong pair (current + next PDC registers), so a high-rate
+ * stream is accepted without per-word interrupts. The driver interrupt is
+ * raised only on a full buffer (ENDRX), on NSS rising edge (end of frame) and
+ * on receive overrun.
+ *
+ * Key characteristics:
+ * - Buffer ownership: a block returned by spi_slv_read() belongs to the caller
+ *   until the next spi_slv_read() call, which hands it back to the PDC. The
+ *   caller must therefore process one block within the time the master needs
+ *   to fill the other one, otherwise incoming data overruns (counted in stats).
+ * - Framing: if spi_slv_dsc.nss_frm is TRUE, NSS rising edge closes the current
+ *   buffer and returns it as a short block with frm_end set. A frame ending
+ *   exactly on a buffer boundary is reported as a block with buf == NULL and
+ *   frm_end set.
+ * - Optional response: if tx_buf is set, tx_size transfer units of it are
+ *   transmitted by the SPI PDC at stream start and again after every NSS rising
+ *   edge (nss_frm == TRUE), otherwise the slave shifts out zeros.
+ * - Transfer width 8..16 bits as for the master driver (SPI_CSR.BITS field
+ *   value, 0 -> 8 bits .. 8 -> 16 bits). For 9..16-bit transfers buffers are
+ *   sequences of uint16_t and sizes are counts of 16-bit transfer units.
+ *
+ * Build-time notes:
+ * - The content of this header is enabled only when SPI_SLV == 1.
+ * - SAM3N/SAM3S/SAM4N/SAM4S have one SPI instance, therefore SPI_SLV == 1 and
+ *   SPIBUS == 1 are mutually exclusive.
+ */
+
+#ifndef SPI_SLV_H
+#define SPI_SLV_H
+
+#ifndef SPI_SLV
+ #define SPI_SLV 0
+#endif
+
+#if SPI_SLV == 1
+
+/**
+ * @struct spi_slv_stats.
+ *
+ * @brief Runtime counters collected by the SPI slave driver.
+ */
+struct spi_slv_stats {
+	unsigned int blk;	/**< Full buffers delivered. */
+	unsigned int frm;	/**< NSS rising edges (frames). */
+	unsigned int units;	/**< Received transfer units. */
+	unsigned int ovre;	/**< SPI receive overruns (OVRES). */
+	unsigned int starv;	/**< PDC ran out of buffers (caller too slow). */
+	unsigned int que_full;	/**< Blocks dropped because the event queue was full. */
+	unsigned int intr;	/**< Interrupts. */
+};
+
+/**
+ * @struct spi_slv_blk.
+ *
+ * @brief Block of received data returned by spi_slv_read().
+ */
+struct spi_slv_blk {
+	void *buf;		/**< Received data (one of rx_buf[]), or NULL for a frame end marker. */
+	int cnt;		/**< Number of received transfer units in buf. */
+	boolean_t frm_end;	/**< TRUE if NSS rose after the last unit of buf. */
+};
+
+typedef struct spi_slv_dsc *spi_slv;
+
+/**
+ * @struct spi_slv_dsc.
+ *
+ * @brief SPI slave instance descriptor.
+ *
+ * Only members documented as "Set by caller" are public configuration inputs.
+ * All other members are maintained by the driver at runtime.
+ */
+struct spi_slv_dsc {
+	int id;			/**< Set by caller: Peripheral ID (ID_SPI). */
+	int mode;		/**< Set by caller: SPI mode 0..3. */
+	int bits;		/**< Set by caller: SPI_CSR.BITS field value (0 -> 8 bits .. 8 -> 16 bits). */
+	void *rx_buf[2];	/**< Set by caller: Two receive buffers. */
+	int rx_size;		/**< Set by caller: Size of each receive buffer in transfer units (1..65535). */
+	const void *tx_buf;	/**< Set by caller: Optional response buffer, or NULL. */
+	int tx_size;		/**< Set by caller: Response size in transfer units (1..65535 if tx_buf). */
+	boolean_t nss_frm;	/**< Set by caller: TRUE -> NSS rising edge closes the current block. */
+	int que_sz;		/**< Set by caller: Block event queue depth (>= 2). */
+	QueueHandle_t que;
+	int cur;
+	int nxt;
+	int held;
+	boolean_t run;
+	struct spi_slv_stats stats;
+};
+
+/**
+ * @brief Configure the SPI peripheral for slave mode reception.
+ *
+ * Creates the block event queue, resets the SPI, programs slave mode, SPI_CSR[0]
+ * (mode, bits) and enables the SPI IRQ in NVIC. The peripheral clock stays
+ * disabled until spi_slv_start().
+ *
+ * @param dev SPI slave instance descriptor.
+ */
+void init_spi_slv(spi_slv dev);
+
+/**
+ * @brief Start continuous reception.
+ *
+ * Arms the PDC with both receive buffers (and the optional response buffer),
+ * enables the peripheral clock and the SPI. Pending blocks from a previous run
+ * are discarded.
+ *
+ * @param dev SPI slave instance descriptor.
+ */
+void spi_slv_start(spi_slv dev);
+
+/**
+ * @brief Stop reception and disable the peripheral clock.
+ *
+ * @param dev SPI slave instance descriptor.
+ */
+void spi_slv_stop(spi_slv dev);
+
+/**
+ * @brief Wait for the next received block.
+ *
+ * The block returned by the previous call is handed back to the PDC first.
+ *
+ * @param dev SPI slave instance descriptor.
+ * @param blk Received block (return).
+ * @param tmo Timeout in OS ticks (portMAX_DELAY waits forever).
+ *
+ * @return 0 on success; -ETMO if no block was received within @p tmo.
+ */
+int spi_slv_read(spi_slv dev, struct spi_slv_blk *blk, TickType_t tmo);
+
+#if TERMOUT == 1
+/**
+ * @brief Log SPI slave driver statistics (terminal output).
+ *
+ * @param dev SPI slave instance descriptor.
+ */
+void log_spi_slv_stats(spi_slv dev);
+#endif
+
+#endif
+
+#endif
@@ -27,6 +27,84 @@
 #include "criterr.h"
 #include "tc.h"
 
+/**
+ * tc_chnl
+ */
+int tc_chnl(int chnl_id)
+{
+	switch (chnl_id) {
+#ifdef ID_TC0
+	case ID_TC0 :
+		return (0);
+#endif
+#ifdef ID_TC3
+	case ID_TC3 :
+		return (0);
+#endif
+#ifdef ID_TC1
+        case ID_TC1 :
+		return (1);
+#endif
+#ifdef ID_TC4
+        case ID_TC4 :
+		return (1);
+#endif
+#ifdef ID_TC2
+        case ID_TC2 :
+		return (2);
+#endif
+#ifdef ID_TC5
+        case ID_TC5 :
+		return (2);
+#endif
+	default :
+		crit_err_exit(BAD_PARAMETER);
+                return (0);
+	}
+}
+
+/**
+ * tc_set_wave_rate
+ */
+unsigned int tc_set_wave_rate(int chnl_id, unsigned int hz, boolean_t run)
+{
+	static const unsigned int div[] = {2, 8, 32, 128};
+	Tc *tc = TC0;
+	unsigned int rc;
+	int i, ch;
+
+	if (hz == 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	ch = tc_chnl(chnl_id);
+#if defined(ID_TC3)
+	if (chnl_id >= ID_TC3) {
+		tc = TC1;
+	}
+#endif
+	for (i = 0; i < 3; i++) {
+		if (F_MCK / div[i] / hz <= 0x10000) {
+			break;
+		}
+	}
+	rc = F_MCK / div[i] / hz;
+	if (rc < 2) {
+		rc = 2;
+	} else if (rc > 0x10000) {
+		rc = 0x10000;
+	}
+	taskENTER_CRITICAL();
+	tc->TC_CHANNEL[ch].TC_CMR = TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_ACPA_CLEAR | TC_CMR_ACPC_SET |
+				    i << TC_CMR_TCCLKS_Pos;
+	tc->TC_CHANNEL[ch].TC_RA = rc / 2;
+	tc->TC_CHANNEL[ch].TC_RC = rc - 1;
+	if (run) {
+		tc->TC_CHANNEL[ch].TC_CCR = TC_CCR_SWTRG;
+	}
+	taskEXIT_CRITICAL();
+	return (F_MCK / div[i] / rc);
+}
+
 #if TMC_TC0 == 1 || TMC_TC1 == 1 || TMC_TC2 == 1 ||\
     TMC_TC3 == 1 || TMC_TC4 == 1 || TMC_TC5 == 1
 
@@ -91,42 +169,6 @@ void set_tc_intr_clbk(int chnl_id, BaseType_t (*clbk)(void))
 	}
 }
 
-/**
- * tc_chnl
- */
-int tc_chnl(int chnl_id)
-{
-	switch (chnl_id) {
-#if TMC_TC0 == 1 && defined(ID_TC0)
-	case ID_TC0 :
-		return (0);
-#endif
-#if TMC_TC3 == 1 && defined(ID_TC3)
-	case ID_TC3 :
-		return (0);
-#endif
-#if TMC_TC1 == 1 && defined(ID_TC1)
-        case ID_TC1 :
-		return (1);
-#endif
-#if TMC_TC4 == 1 && defined(ID_TC4)
-        case ID_TC4 :
-		return (1);
-#endif
-#if TMC_TC2 == 1 && defined(ID_TC2)
-        case ID_TC2 :
-		return (2);
-#endif
-#if TMC_TC5 == 1 && defined(ID_TC5)
-        case ID_TC5 :
-		return (2);
-#endif
-	default :
-		crit_err_exit(BAD_PARAMETER);
-                return (0);
-	}
-}
-
 #if TMC_TC0 == 1 && defined(ID_TC0)
 /**
  * TC0_Handler
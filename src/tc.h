@@ -19,17 +19,28 @@
 #ifndef TC_H
 #define TC_H
 
+// tc_chnl() and tc_set_wave_rate() need no TMC_TCx option (no interrupt).
+
+/**
+ * tc_chnl
+ */
+int tc_chnl(int chnl_id);
+
+/**
+ * tc_set_wave_rate
+ *
+ * Set channel chnl_id to waveform mode with period 1 / hz (TIOA rises on RC
+ * compare, falls at half period) and return the rate set. Counter is
+ * restarted if run is TRUE.
+ */
+unsigned int tc_set_wave_rate(int chnl_id, unsigned int hz, boolean_t run);
+
 #if TMC_TC0 == 1 || TMC_TC1 == 1 || TMC_TC2 == 1 ||\
     TMC_TC3 == 1 || TMC_TC4 == 1 || TMC_TC5 == 1
 /**
  * set_tc_intr_clbk
  */
 void set_tc_intr_clbk(int chnl_id, BaseType_t (*clbk)(void));
-
-/**
- * tc_chnl
- */
-int tc_chnl(int chnl_id);
 #endif
 
 #endif
@@ -0,0 +1,156 @@
+/*
+ * adc_cal_test.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Host test of adc_cal.c, built by test/Makefile once with the portable
+ * kernel (SAM3S) and once with the SIMD kernel (SAM4S, DSP intrinsics
+ * emulated in stub/core_cm4.h). On target use log_adc_cal_bench().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/adc_cal.c"
+
+#define CODE_CNT (CODE_MAX + 1)
+
+static int fail;
+
+void crit_err_exit(enum crit_err err)
+{
+	printf("crit_err_exit(%d)\n", err);
+	exit(1);
+}
+
+/**
+ * check
+ */
+static void check(int ok, const char *what, int a, int b)
+{
+	if (!ok) {
+		printf("FAIL %s: %d %d\n", what, a, b);
+		fail++;
+	}
+}
+
+/**
+ * test_run16
+ *
+ * run16 must equal run32 rounded to nearest and saturated within one unit,
+ * for aligned, misaligned and in-place buffers.
+ */
+static void test_run16(int32_t gain, int32_t offs)
+{
+	static uint16_t in[CODE_CNT + 2] __attribute__((aligned(4)));
+	static int16_t out[CODE_CNT + 2] __attribute__((aligned(4)));
+	static int32_t out32[CODE_CNT];
+	int32_t ref;
+	int err, err_max = 0;
+
+	check(!adc_cal_set(0, gain, offs), "adc_cal_set", gain, offs);
+	for (int i = 0; i < CODE_CNT; i++) {
+		in[i] = in[i + 1] = 0;
+	}
+	for (int i = 0; i < CODE_CNT; i++) {
+		in[i] = i;
+	}
+	adc_cal_run32(0, in, CODE_CNT, out32);
+	for (int a = 0; a < 3; a++) {
+		for (int i = 0; i < CODE_CNT; i++) {
+			in[i + (a & 1)] = i;
+		}
+		if (a == 2) {
+			adc_cal_run16(0, in, CODE_CNT, (int16_t *) in);
+		} else {
+			adc_cal_run16(0, in + a, CODE_CNT, out + a);
+		}
+		for (int i = 0; i < CODE_CNT; i++) {
+			ref = __SSAT(((int64_t) out32[i] + 0x8000) >> 16, 16);
+			err = abs(((a == 2) ? (int16_t) in[i] : out[i + a]) - ref);
+			if (err > err_max) {
+				err_max = err;
+			}
+		}
+	}
+	check(err_max <= 1, "run16 vs run32", gain, err_max);
+}
+
+/**
+ * test_ideal
+ */
+static void test_ideal(void)
+{
+	uint16_t in[] = {0, 1024, 2048, 4095};
+	int32_t out32[4];
+	int16_t out[4];
+
+	check(!adc_cal_ideal(1, 3300), "adc_cal_ideal", 3300, 0);
+	adc_cal_run32(1, in, 4, out32);
+	adc_cal_run16(1, in, 4, out);
+	check(out32[0] == 0 && out[0] == 0, "ideal code 0", out32[0], out[0]);
+	check(out32[1] == 825 << 16 && out[1] == 825, "ideal code 1024", out32[1], out[1]);
+	check(out32[2] == 1650 << 16 && out[2] == 1650, "ideal code 2048", out32[2], out[2]);
+	check(out[3] == 3299, "ideal code 4095", out[3], 3299);
+}
+
+/**
+ * test_two_point
+ *
+ * Both reference codes must convert back to their values (run16 within one
+ * unit); the calibration returned by adc_cal_get() must convert the same.
+ */
+static void test_two_point(unsigned int c1, int v1, unsigned int c2, int v2)
+{
+	uint16_t in[2] = {c1, c2};
+	int32_t out32[2], gain, offs;
+	int16_t out[2], out3[2];
+
+	check(!adc_cal_two_point(2, c1, v1, c2, v2), "adc_cal_two_point", c1, c2);
+	adc_cal_run32(2, in, 2, out32);
+	adc_cal_run16(2, in, 2, out);
+	check((out32[0] + 0x8000) >> 16 == v1 && abs(out[0] - v1) <= 1, "two-point ref 1", out[0], v1);
+	check((out32[1] + 0x8000) >> 16 == v2 && abs(out[1] - v2) <= 1, "two-point ref 2", out[1], v2);
+	adc_cal_get(2, &gain, &offs);
+	check(!adc_cal_set(3, gain, offs), "adc_cal_set restored", gain, offs);
+	adc_cal_run16(3, in, 2, out3);
+	check(out3[0] == out[0] && out3[1] == out[1], "restored calibration", out3[0], out3[1]);
+}
+
+int main(void)
+{
+	static const int32_t set[][2] = {
+		{(3300 << 16) / 4096, 0},
+		{0x12000, -(100 << 16)},
+		{-(5 << 16), 20000 << 16},
+		{7 << 16, -(1000 << 16)},
+		{3, 0x8000},
+		{-(5 << 16) / 3, 1000 << 16},
+		{8 << 16, -(30000 << 16)},
+		{(32767 << 16) / 4095, 0x7FFF}
+	};
+
+	for (unsigned int s = 0; s < sizeof(set) / sizeof(set[0]); s++) {
+		test_run16(set[s][0], set[s][1]);
+	}
+	test_ideal();
+	test_two_point(100, 50, 4000, 2000);
+	test_two_point(3900, -273, 200, 1200);
+	test_two_point(0, 0, 4095, 32767);
+	check(adc_cal_set(0, 1 << 30, 0) == -EDATA, "overflow rejected", 1 << 30, 0);
+	printf("adc_cal_test (simd=%d): %s\n", CAL_SIMD, (fail) ? "FAILED" : "passed");
+	return (fail != 0);
+}
@@ -0,0 +1,159 @@
+/*
+ * host_rtos.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sysconf.h"
+#include "host_rtos.h"
+
+struct que {
+	UBaseType_t len;
+	UBaseType_t size;
+	UBaseType_t cnt;
+	UBaseType_t rd;
+	uint8_t *buf;
+};
+
+struct mtx {
+	boolean_t taken;
+};
+
+void (*host_wait_hook)(TickType_t tmo);
+TickType_t host_tick;
+unsigned int host_mtx_err;
+DWT_Type host_dwt;
+CoreDebug_Type host_core_debug;
+uint32_t SystemCoreClock = F_MCK;
+
+/**
+ * xTaskGetTickCount
+ */
+TickType_t xTaskGetTickCount(void)
+{
+	return (host_tick);
+}
+
+/**
+ * xQueueCreate
+ */
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+	struct que *q;
+
+	if (NULL == (q = calloc(1, sizeof(struct que)))) {
+		return (NULL);
+	}
+	if (NULL == (q->buf = malloc(len * item_size))) {
+		free(q);
+		return (NULL);
+	}
+	q->len = len;
+	q->size = item_size;
+	return (q);
+}
+
+/**
+ * xQueueReceive
+ */
+BaseType_t xQueueReceive(QueueHandle_t que, void *item, TickType_t tmo)
+{
+	struct que *q = que;
+
+	if (!q->cnt && tmo && host_wait_hook) {
+		(*host_wait_hook)(tmo);
+	}
+	if (!q->cnt) {
+		return (pdFALSE);
+	}
+	memcpy(item, q->buf + q->rd * q->size, q->size);
+	q->rd = (q->rd + 1) % q->len;
+	q->cnt--;
+	return (pdTRUE);
+}
+
+/**
+ * xQueueSendFromISR
+ */
+BaseType_t xQueueSendFromISR(QueueHandle_t que, const void *item, BaseType_t *wkn)
+{
+	struct que *q = que;
+
+	if (q->cnt == q->len) {
+		return (errQUEUE_FULL);
+	}
+	memcpy(q->buf + (q->rd + q->cnt) % q->len * q->size, item, q->size);
+	q->cnt++;
+	*wkn = pdTRUE;
+	return (pdPASS);
+}
+
+/**
+ * xQueueReset
+ */
+BaseType_t xQueueReset(QueueHandle_t que)
+{
+	struct que *q = que;
+
+	q->cnt = q->rd = 0;
+	return (pdPASS);
+}
+
+/**
+ * xSemaphoreCreateMutex
+ */
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	return (calloc(1, sizeof(struct mtx)));
+}
+
+/**
+ * xSemaphoreTake
+ */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mtx, TickType_t tmo)
+{
+	struct mtx *m = mtx;
+
+	(void) tmo;
+	if (m->taken) {
+		// Only one task: nobody else can give it.
+		host_mtx_err++;
+		return (pdFALSE);
+	}
+	m->taken = TRUE;
+	return (pdTRUE);
+}
+
+/**
+ * xSemaphoreGive
+ */
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mtx)
+{
+	struct mtx *m = mtx;
+
+	if (!m->taken) {
+		host_mtx_err++;
+		return (pdFALSE);
+	}
+	m->taken = FALSE;
+	return (pdTRUE);
+}
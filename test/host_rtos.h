@@ -0,0 +1,45 @@
+/*
+ * host_rtos.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Host test emulation of the FreeRTOS calls used by the drivers, for one
+ * task. A peripheral model raises its interrupts from host_wait_hook, which
+ * is called when the task would block in xQueueReceive().
+ */
+
+#ifndef HOST_RTOS_H
+#define HOST_RTOS_H
+
+/**
+ * Run the peripheral model until an interrupt handler posted to a queue, or
+ * at most tmo ticks. Does nothing by default.
+ */
+extern void (*host_wait_hook)(TickType_t tmo);
+
+/**
+ * Current tick count (returned by xTaskGetTickCount()), set by the model.
+ */
+extern TickType_t host_tick;
+
+/**
+ * Number of failed mutex operations (take of a taken or give of a free
+ * mutex), a deadlock or a bug on target.
+ */
+extern unsigned int host_mtx_err;
+
+#endif
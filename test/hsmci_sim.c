@@ -0,0 +1,610 @@
+/*
+ * hsmci_sim.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sysconf.h"
+#include "hsmci_cmd.h"
+#include "hsmci_sd.h"
+#include "host_rtos.h"
+#include "hsmci_sim.h"
+
+#define REG(r) hsmci_sim_regs[offsetof(Hsmci, r) / 4]
+#define BLK_SIZE 512
+#define CMDR_IDLE 0xFFFFFFFF
+#define PS_MS 1000000000ULL
+#define CMD_CLK (48 + 8 + 48)
+#define RD_BLK_CLK (1 + 16 + 1)
+#define WR_BLK_CLK (1 + 16 + 1 + 2 + 5 + 1)
+#define MAX_STEPS 100000000
+
+enum card_st {
+	ST_TRAN,
+	ST_DATA,
+	ST_RCV,
+	ST_PRG
+};
+
+uint32_t hsmci_sim_regs[sizeof(Hsmci) / 4];
+struct hsmci_sim_stat hsmci_sim_stat;
+
+static struct hsmci_sim_cfg cfg;
+static uint8_t *mem;
+static uint64_t now;
+static uint32_t imr;
+static uint32_t latch;
+static boolean_t rx_en, tx_en;
+static uint32_t rcr, rncr, tcr, tncr;
+
+static struct {
+	enum card_st st;
+	uint64_t busy_end;
+	boolean_t app;
+	uint32_t err;
+	unsigned int inj_cmd;
+	uint32_t inj_err;
+	int set_blk;
+	int pre_cnt;
+} card;
+
+static struct {
+	boolean_t on;
+	boolean_t wr;
+	size_t lba;
+	int blk_left;
+	int card_left;
+	int wr_cnt;
+	unsigned int pos;
+	uint64_t ready;
+	uint32_t blk[BLK_SIZE / 4];
+} xf;
+
+static void wait_hook(TickType_t tmo);
+static void sync_regs(void);
+static uint32_t status(void);
+static boolean_t step(uint64_t end);
+static void exec_cmd(void);
+static void start_xfer(boolean_t wr, uint32_t cmdr, uint32_t arg, int card_left);
+static boolean_t rd_word(void);
+static boolean_t wr_word(void);
+static void blk_end(void);
+static uint32_t r1(enum card_st st);
+static enum card_st card_state(void);
+static uint64_t clk_ps(unsigned int clk);
+static boolean_t advance(uint64_t t, uint64_t end);
+static void set_time(void);
+
+/**
+ * hsmci_sim_init
+ */
+void hsmci_sim_init(const struct hsmci_sim_cfg *c)
+{
+	cfg = *c;
+	free(mem);
+	if (NULL == (mem = calloc(cfg.blk_cnt, BLK_SIZE))) {
+		abort();
+	}
+	memset(hsmci_sim_regs, 0, sizeof(hsmci_sim_regs));
+	memset(&hsmci_sim_stat, 0, sizeof(hsmci_sim_stat));
+	memset(&card, 0, sizeof(card));
+	memset(&xf, 0, sizeof(xf));
+	REG(HSMCI_CMDR) = CMDR_IDLE;
+	REG(HSMCI_SR) = HSMCI_SR_CMDRDY | HSMCI_SR_NOTBUSY | HSMCI_SR_XFRDONE;
+	imr = latch = 0;
+	rx_en = tx_en = FALSE;
+	rcr = rncr = tcr = tncr = 0;
+	now = 0;
+	set_time();
+	host_wait_hook = wait_hook;
+}
+
+/**
+ * hsmci_sim_mem
+ */
+uint8_t *hsmci_sim_mem(size_t lba)
+{
+	return (mem + lba * BLK_SIZE);
+}
+
+/**
+ * hsmci_sim_err
+ */
+void hsmci_sim_err(unsigned int cmd, uint32_t err)
+{
+	card.inj_cmd = cmd;
+	card.inj_err = err;
+}
+
+/**
+ * hsmci_sim_cyc
+ */
+uint32_t hsmci_sim_cyc(void)
+{
+	return ((now / 1000) * (SystemCoreClock / 1000) / 1000000);
+}
+
+/**
+ * hsmci_sim_us
+ */
+uint64_t hsmci_sim_us(void)
+{
+	return (now / 1000000);
+}
+
+/**
+ * wait_hook
+ *
+ * Run the model until an enabled status flag is set (HSMCI_Handler() posts
+ * it) or the timeout elapses.
+ */
+static void wait_hook(TickType_t tmo)
+{
+	uint64_t end = now + (uint64_t) tmo * portTICK_PERIOD_MS * PS_MS;
+	uint32_t sr;
+
+	sync_regs();
+	for (int i = 0; i < MAX_STEPS; i++) {
+		sr = status();
+		if (sr & imr) {
+			REG(HSMCI_SR) = sr;
+			REG(HSMCI_IMR) = imr;
+			HSMCI_Handler();
+			// Reading SR clears BLKE and the error flags.
+			latch &= ~(HSMCI_SR_BLKE | HSMCI_SR_UNRE | HSMCI_SR_OVRE | HSMCI_SR_DTOE | HSMCI_SR_DCRCE);
+			sync_regs();
+			set_time();
+			return;
+		}
+		if (!step(end)) {
+			break;
+		}
+	}
+	if (now < end) {
+		now = end;
+	}
+	set_time();
+	REG(HSMCI_SR) = status();
+}
+
+/**
+ * sync_regs
+ *
+ * Apply the register writes of the driver since the last call. Write-only
+ * registers (CR, IER, IDR, PTCR) are cleared after use, CMDR is set to
+ * CMDR_IDLE once the command was started.
+ */
+static void sync_regs(void)
+{
+	if (REG(HSMCI_CR)) {
+		// Software reset (init_hsmci(), reset_hsmci()).
+		xf.on = FALSE;
+		latch = 0;
+		REG(HSMCI_CR) = 0;
+	}
+	imr &= ~REG(HSMCI_IDR);
+	imr |= REG(HSMCI_IER);
+	REG(HSMCI_IDR) = REG(HSMCI_IER) = 0;
+	if (REG(HSMCI_PTCR) & HSMCI_PTCR_RXTDIS) {
+		rx_en = FALSE;
+	} else if (REG(HSMCI_PTCR) & HSMCI_PTCR_RXTEN) {
+		rx_en = TRUE;
+	}
+	if (REG(HSMCI_PTCR) & HSMCI_PTCR_TXTDIS) {
+		tx_en = FALSE;
+	} else if (REG(HSMCI_PTCR) & HSMCI_PTCR_TXTEN) {
+		tx_en = TRUE;
+	}
+	REG(HSMCI_PTCR) = 0;
+	// Counter writes clear ENDRX/ENDTX, the next buffer is loaded at once
+	// if the current one is done.
+	if (REG(HSMCI_RCR) != rcr || REG(HSMCI_RNCR) != rncr) {
+		latch &= ~HSMCI_SR_ENDRX;
+		if (!REG(HSMCI_RCR) && REG(HSMCI_RNCR)) {
+			REG(HSMCI_RPR) = REG(HSMCI_RNPR);
+			REG(HSMCI_RCR) = REG(HSMCI_RNCR);
+			REG(HSMCI_RNCR) = 0;
+			latch |= HSMCI_SR_ENDRX;
+		}
+		rcr = REG(HSMCI_RCR);
+		rncr = REG(HSMCI_RNCR);
+	}
+	if (REG(HSMCI_TCR) != tcr || REG(HSMCI_TNCR) != tncr) {
+		latch &= ~HSMCI_SR_ENDTX;
+		if (!REG(HSMCI_TCR) && REG(HSMCI_TNCR)) {
+			REG(HSMCI_TPR) = REG(HSMCI_TNPR);
+			REG(HSMCI_TCR) = REG(HSMCI_TNCR);
+			REG(HSMCI_TNCR) = 0;
+			latch |= HSMCI_SR_ENDTX;
+		}
+		tcr = REG(HSMCI_TCR);
+		tncr = REG(HSMCI_TNCR);
+	}
+}
+
+/**
+ * status
+ */
+static uint32_t status(void)
+{
+	uint32_t sr = latch;
+	boolean_t cmd, dat;
+
+	cmd = REG(HSMCI_CMDR) != CMDR_IDLE;
+	if (!cmd) {
+		sr |= HSMCI_SR_CMDRDY;
+	}
+	// Data line idle: no block in progress (an open ended write waiting for
+	// data at a block boundary counts as idle) and no card busy.
+	dat = xf.on;
+	if (dat && xf.wr && !xf.pos && !REG(HSMCI_TCR) && !REG(HSMCI_TNCR)) {
+		dat = FALSE;
+	}
+	if (!dat && now >= card.busy_end) {
+		sr |= HSMCI_SR_NOTBUSY;
+		if (!cmd) {
+			sr |= HSMCI_SR_XFRDONE;
+		}
+	}
+	if (!REG(HSMCI_RCR) && !REG(HSMCI_RNCR)) {
+		sr |= HSMCI_SR_RXBUFF;
+	}
+	if (!REG(HSMCI_TCR) && !REG(HSMCI_TNCR)) {
+		sr |= HSMCI_SR_TXBUFE;
+	}
+	return (sr);
+}
+
+/**
+ * step
+ *
+ * Make one step of progress not past end. Returns FALSE if nothing can
+ * happen until the driver acts.
+ */
+static boolean_t step(uint64_t end)
+{
+	if (REG(HSMCI_CMDR) != CMDR_IDLE) {
+		exec_cmd();
+		return (TRUE);
+	}
+	if (xf.on) {
+		if (xf.wr) {
+			if (!xf.pos && now < card.busy_end) {
+				// Next block after the card released busy.
+				return (advance(card.busy_end, end));
+			}
+			return (wr_word());
+		} else {
+			if (!xf.pos && now < xf.ready) {
+				return (advance(xf.ready, end));
+			}
+			return (rd_word());
+		}
+	}
+	if (now < card.busy_end) {
+		return (advance(card.busy_end, end));
+	}
+	return (FALSE);
+}
+
+/**
+ * advance
+ */
+static boolean_t advance(uint64_t t, uint64_t end)
+{
+	if (t > end) {
+		return (FALSE);
+	}
+	now = t;
+	return (TRUE);
+}
+
+/**
+ * exec_cmd
+ */
+static void exec_cmd(void)
+{
+	uint32_t cmdr = REG(HSMCI_CMDR);
+	uint32_t arg = REG(HSMCI_ARGR);
+	unsigned int idx = cmdr & HSMCI_CMDR_CMDNB_Msk;
+	enum card_st st = card_state();
+	boolean_t app = card.app;
+	int set_blk = card.set_blk;
+	uint32_t resp;
+
+	REG(HSMCI_CMDR) = CMDR_IDLE;
+	now += CMD_CLK * clk_ps(1);
+	card.app = FALSE;
+	card.set_blk = 0;
+	if ((cmdr & HSMCI_CMDR_SPCMD_Msk) != HSMCI_CMDR_SPCMD_STD) {
+		return;
+	}
+	if (xf.on && idx != 12 && idx != 13) {
+		// Command during a data transfer.
+		hsmci_sim_stat.proto_err++;
+	}
+	resp = r1(st);
+	if (card.inj_err && card.inj_cmd == idx + ((app) ? HSMCI_SIM_ACMD : 0)) {
+		resp |= card.inj_err;
+		card.inj_err = 0;
+	}
+	if (app) {
+		hsmci_sim_stat.acmd[idx]++;
+		resp |= CARD_STATUS_APP_CMD;
+		switch (idx) {
+		case 6 :
+		case 23 :
+			if (st != ST_TRAN) {
+				resp |= CARD_STATUS_ILLEGAL_COMMAND;
+				hsmci_sim_stat.proto_err++;
+			} else if (idx == 23) {
+				card.pre_cnt = arg & 0x7FFFFF;
+			}
+			break;
+		default :
+			resp |= CARD_STATUS_ILLEGAL_COMMAND;
+			break;
+		}
+		REG(HSMCI_RSPR[0]) = resp;
+		return;
+	}
+	hsmci_sim_stat.cmd[idx]++;
+	switch (idx) {
+	case 12 :
+		if ((cmdr & HSMCI_CMDR_TRCMD_Msk) == HSMCI_CMDR_TRCMD_STOP_DATA) {
+			xf.on = FALSE;
+		}
+		if (st == ST_DATA) {
+			card.st = ST_TRAN;
+		} else if (st == ST_RCV) {
+			card.st = ST_PRG;
+			card.busy_end = now + (uint64_t) ((xf.wr_cnt && card.pre_cnt >= xf.wr_cnt) ?
+				       cfg.wr_end_pre_us : cfg.wr_end_us) * 1000000;
+			card.pre_cnt = 0;
+		} else {
+			// Nothing to stop (CMD23 ended the transfer).
+			resp |= CARD_STATUS_ILLEGAL_COMMAND;
+			hsmci_sim_stat.proto_err++;
+		}
+		break;
+	case 13 :
+		break;
+	case 23 :
+		card.set_blk = arg & 0xFFFF;
+		break;
+	case 17 :
+	case 18 :
+	case 24 :
+	case 25 :
+		if (st != ST_TRAN) {
+			resp |= CARD_STATUS_ILLEGAL_COMMAND;
+			hsmci_sim_stat.proto_err++;
+		} else if ((cmdr & HSMCI_CMDR_TRCMD_Msk) != HSMCI_CMDR_TRCMD_START_DATA ||
+			   (REG(HSMCI_BLKR) >> HSMCI_BLKR_BLKLEN_Pos) != BLK_SIZE ||
+			   !!(cmdr & HSMCI_CMDR_TRDIR) != (idx < 24)) {
+			hsmci_sim_stat.proto_err++;
+		} else if (arg >= cfg.blk_cnt) {
+			resp |= CARD_STATUS_ADDR_OUT_OF_RANGE;
+		} else {
+			start_xfer(idx >= 24, cmdr, arg, (idx == 17 || idx == 24) ? 1 : (idx == 25) ? set_blk : 0);
+		}
+		break;
+	case 55 :
+		card.app = TRUE;
+		resp |= CARD_STATUS_APP_CMD;
+		break;
+	default :
+		break;
+	}
+	REG(HSMCI_RSPR[0]) = resp;
+}
+
+/**
+ * start_xfer
+ */
+static void start_xfer(boolean_t wr, uint32_t cmdr, uint32_t arg, int card_left)
+{
+	unsigned int bcnt = REG(HSMCI_BLKR) & HSMCI_BLKR_BCNT_Msk;
+
+	xf.on = TRUE;
+	xf.wr = wr;
+	xf.lba = arg;
+	xf.pos = 0;
+	xf.wr_cnt = 0;
+	if ((cmdr & HSMCI_CMDR_TRTYP_Msk) == HSMCI_CMDR_TRTYP_SINGLE) {
+		xf.blk_left = 1;
+	} else {
+		xf.blk_left = (bcnt) ? (int) bcnt : -1;
+	}
+	xf.card_left = (card_left) ? card_left : -1;
+	if (wr) {
+		card.st = ST_RCV;
+	} else {
+		card.st = ST_DATA;
+		xf.ready = now + (uint64_t) cfg.rd_acc_us * 1000000;
+	}
+}
+
+/**
+ * rd_word
+ */
+static boolean_t rd_word(void)
+{
+	uint32_t w;
+
+	if (!rx_en || !REG(HSMCI_RCR)) {
+		// RDPROOF: the card clock stops while the PDC is full.
+		return (FALSE);
+	}
+	if (xf.lba >= cfg.blk_cnt) {
+		card.err |= CARD_STATUS_ADDR_OUT_OF_RANGE;
+		xf.on = FALSE;
+		return (TRUE);
+	}
+	memcpy(&w, mem + xf.lba * BLK_SIZE + xf.pos * 4, 4);
+	*(uint32_t *) (uintptr_t) REG(HSMCI_RPR) = w;
+	REG(HSMCI_RPR) += 4;
+	if (!--REG(HSMCI_RCR)) {
+		latch |= HSMCI_SR_ENDRX;
+		if (REG(HSMCI_RNCR)) {
+			REG(HSMCI_RPR) = REG(HSMCI_RNPR);
+			REG(HSMCI_RCR) = REG(HSMCI_RNCR);
+			REG(HSMCI_RNCR) = 0;
+		}
+	}
+	rcr = REG(HSMCI_RCR);
+	rncr = REG(HSMCI_RNCR);
+	now += clk_ps(32);
+	if (++xf.pos == BLK_SIZE / 4) {
+		now += RD_BLK_CLK * clk_ps(1);
+		xf.ready = now + (uint64_t) cfg.rd_acc_us * 1000000;
+		hsmci_sim_stat.rd_blk++;
+		blk_end();
+	}
+	return (TRUE);
+}
+
+/**
+ * wr_word
+ */
+static boolean_t wr_word(void)
+{
+	if (!tx_en || !REG(HSMCI_TCR)) {
+		// WRPROOF: the card clock stops while the PDC is empty.
+		return (FALSE);
+	}
+	xf.blk[xf.pos] = *(uint32_t *) (uintptr_t) REG(HSMCI_TPR);
+	REG(HSMCI_TPR) += 4;
+	if (!--REG(HSMCI_TCR)) {
+		latch |= HSMCI_SR_ENDTX;
+		if (REG(HSMCI_TNCR)) {
+			REG(HSMCI_TPR) = REG(HSMCI_TNPR);
+			REG(HSMCI_TCR) = REG(HSMCI_TNCR);
+			REG(HSMCI_TNCR) = 0;
+		}
+	}
+	tcr = REG(HSMCI_TCR);
+	tncr = REG(HSMCI_TNCR);
+	now += clk_ps(32);
+	if (++xf.pos == BLK_SIZE / 4) {
+		now += WR_BLK_CLK * clk_ps(1);
+		if (xf.lba < cfg.blk_cnt) {
+			memcpy(mem + xf.lba * BLK_SIZE, xf.blk, BLK_SIZE);
+			hsmci_sim_stat.wr_blk++;
+		} else {
+			card.err |= CARD_STATUS_ADDR_OUT_OF_RANGE;
+		}
+		xf.wr_cnt++;
+		// CRC status received.
+		latch |= HSMCI_SR_BLKE;
+		card.busy_end = now + (uint64_t) cfg.wr_blk_us * 1000000;
+		blk_end();
+	}
+	return (TRUE);
+}
+
+/**
+ * blk_end
+ */
+static void blk_end(void)
+{
+	xf.pos = 0;
+	xf.lba++;
+	if (xf.blk_left > 0 && !--xf.blk_left) {
+		xf.on = FALSE;
+	}
+	if (xf.card_left > 0 && !--xf.card_left) {
+		// Single block command or CMD23 count reached.
+		xf.on = FALSE;
+		if (xf.wr) {
+			card.st = ST_PRG;
+			card.busy_end = now + (uint64_t) ((card.pre_cnt >= xf.wr_cnt) ?
+				       cfg.wr_end_pre_us : cfg.wr_end_us) * 1000000;
+			card.pre_cnt = 0;
+		} else {
+			card.st = ST_TRAN;
+		}
+	}
+}
+
+/**
+ * r1
+ *
+ * R1 of a command received in state st. Error bits are cleared once
+ * reported.
+ */
+static uint32_t r1(enum card_st st)
+{
+	uint32_t r = card.err | ((uint32_t) (st + 4) << 9);
+
+	if (st == ST_TRAN || (st == ST_RCV && now >= card.busy_end)) {
+		r |= CARD_STATUS_READY_FOR_DATA;
+	}
+	card.err = 0;
+	return (r);
+}
+
+/**
+ * card_state
+ */
+static enum card_st card_state(void)
+{
+	if (card.st == ST_PRG && now >= card.busy_end) {
+		card.st = ST_TRAN;
+	}
+	return (card.st);
+}
+
+/**
+ * clk_ps
+ *
+ * Duration of clk bus clocks, data clocks divided by the bus width (callers
+ * pass 32 per data word).
+ */
+static uint64_t clk_ps(unsigned int clk)
+{
+	uint64_t hz = F_MCK / (2 * ((REG(HSMCI_MR) & HSMCI_MR_CLKDIV_Msk) + 1));
+	unsigned int w = 1;
+
+	if (clk > 1) {
+		switch (REG(HSMCI_SDCR) & HSMCI_SDCR_SDCBUS_Msk) {
+		case HSMCI_SDCR_SDCBUS_4 :
+			w = 4;
+			break;
+		case HSMCI_SDCR_SDCBUS_8 :
+			w = 8;
+			break;
+		default :
+			break;
+		}
+	}
+	return (clk * 1000000000000ULL / w / hz);
+}
+
+/**
+ * set_time
+ */
+static void set_time(void)
+{
+	host_tick = now / (portTICK_PERIOD_MS * PS_MS);
+	DWT->CYCCNT = hsmci_sim_cyc();
+}
@@ -0,0 +1,98 @@
+/*
+ * hsmci_sim.h
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Simulated SD card behind the HSMCI registers, for host tests of
+ * hsmci_sd.c and its users (build with -DHSMCI_SIM=1, see stub/sysconf.h).
+ *
+ * The model runs when the driver waits for its interrupt (host_wait_hook)
+ * and advances a simulated time: command and data transfers take bus time
+ * from the programmed clock and bus width, the card adds the configured read
+ * access and write busy times. The PDC moves data between caller buffers and
+ * the card memory. Status flags follow the datasheet: BLKE per written block
+ * (cleared by reading HSMCI_SR), NOTBUSY and XFRDONE when the data line is
+ * idle, ENDRX/ENDTX until the next counter write, RXBUFF/TXBUFE when both
+ * counters are zero. The card is block addressed (SDHC) and starts in the
+ * transfer state.
+ *
+ * PDC pointers hold 32-bit addresses: link the test with -no-pie and pass
+ * static buffers.
+ */
+
+#ifndef HSMCI_SIM_H
+#define HSMCI_SIM_H
+
+struct hsmci_sim_cfg {
+	size_t blk_cnt;			// Card capacity in blocks.
+	unsigned int rd_acc_us;		// Read access time before each block.
+	unsigned int wr_blk_us;		// Busy after each written block.
+	unsigned int wr_end_us;		// Busy after the last block of a write.
+	unsigned int wr_end_pre_us;	// Busy after the last block if pre-erased by ACMD23.
+};
+
+struct hsmci_sim_stat {
+	unsigned int cmd[64];		// Commands by index.
+	unsigned int acmd[64];		// Application commands by index.
+	unsigned int rd_blk;		// Blocks sent by the card.
+	unsigned int wr_blk;		// Blocks programmed by the card.
+	unsigned int proto_err;		// Driver protocol violations (see hsmci_sim.c).
+};
+
+extern struct hsmci_sim_stat hsmci_sim_stat;
+
+/**
+ * hsmci_sim_init
+ *
+ * Set up the card (memory cleared) and install the model into the RTOS
+ * emulation. Call before init_hsmci().
+ */
+void hsmci_sim_init(const struct hsmci_sim_cfg *cfg);
+
+/**
+ * hsmci_sim_mem
+ *
+ * Card memory of block lba.
+ */
+uint8_t *hsmci_sim_mem(size_t lba);
+
+#define HSMCI_SIM_ACMD 64
+
+/**
+ * hsmci_sim_err
+ *
+ * Report R1 error bits err in the next response to command cmd (index, plus
+ * HSMCI_SIM_ACMD for an application command).
+ */
+void hsmci_sim_err(unsigned int cmd, uint32_t err);
+
+/**
+ * hsmci_sim_cyc
+ *
+ * Simulated time in SystemCoreClock cycles (timestamp source of
+ * sd_bench_run_io()). The DWT cycle counter follows it as well.
+ */
+uint32_t hsmci_sim_cyc(void);
+
+/**
+ * hsmci_sim_us
+ *
+ * Simulated time in us.
+ */
+uint64_t hsmci_sim_us(void);
+
+#endif
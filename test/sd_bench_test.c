@@ -0,0 +1,369 @@
+/*
+ * sd_bench_test.c
+ *
+ * Copyright (c) 2025 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Host test of hsmci_sd.c and sd_bench.c against the simulated card of
+ * hsmci_sim.c, built by test/Makefile. Checks the data of the block and
+ * stream transfers, the command sequences of the write options, write error
+ * reporting, the driver lock and the benchmark timing against the configured
+ * card times.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <gentyp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sysconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pmc.h"
+#include "hsmci_sd.h"
+#include "hsmci_cmd.h"
+#include "sd_card.h"
+#include "sd_bench.h"
+#include "host_rtos.h"
+#include "hsmci_sim.h"
+
+#define BUF_BLK 64
+#define RANGE_BLK 4096
+#define CLK_HZ 25000000
+#define RCA 0x1234
+
+static const struct hsmci_sim_cfg sim_cfg = {
+	.blk_cnt = 8192,
+	.rd_acc_us = 100,
+	.wr_blk_us = 20,
+	.wr_end_us = 800,
+	.wr_end_pre_us = 200
+};
+
+static struct sd_card card;
+static uint32_t buf[BUF_BLK * 128];
+static uint32_t buf2[BUF_BLK * 128];
+static unsigned int clk;
+static int fail;
+
+void crit_err_exit(enum crit_err err)
+{
+	printf("crit_err_exit(%d)\n", err);
+	exit(1);
+}
+
+void enable_periph_clk(int id)
+{
+	(void) id;
+}
+
+/**
+ * check
+ */
+static void check(int ok, const char *what, long a, long b)
+{
+	if (!ok) {
+		printf("FAIL %s: %ld %ld\n", what, a, b);
+		fail++;
+	}
+}
+
+/**
+ * fill
+ */
+static void fill(uint32_t *p, int blk, uint32_t seed)
+{
+	for (int i = 0; i < blk * 128; i++) {
+		p[i] = seed * 0x9E3779B9 + i;
+	}
+}
+
+/**
+ * test_blocks
+ *
+ * Block writes with every write option, read back by the card memory and by
+ * block reads.
+ */
+static void test_blocks(void)
+{
+	static const int cnt[] = {1, 2, 8, 64};
+	struct hsmci_sim_stat s0;
+	size_t lba = 100;
+	int ret;
+
+	for (unsigned int opt = 0; opt < 4; opt++) {
+		hsmci_set_write_opt(RCA, opt);
+		for (unsigned int i = 0; i < sizeof(cnt) / sizeof(cnt[0]); i++) {
+			s0 = hsmci_sim_stat;
+			fill(buf, cnt[i], lba);
+			hsmci_lock();
+			ret = hsmci_write_blocks(lba, cnt[i], buf);
+			hsmci_unlock();
+			check(ret == 0, "write_blocks", opt, cnt[i]);
+			check(!memcmp(hsmci_sim_mem(lba), buf, cnt[i] * 512), "write data", opt, cnt[i]);
+			if (cnt[i] > 1) {
+				check(hsmci_sim_stat.cmd[12] - s0.cmd[12] == !(opt & HSMCI_WR_OPT_BLK_CNT),
+				      "write CMD12", opt, cnt[i]);
+				check(hsmci_sim_stat.cmd[23] - s0.cmd[23] == !!(opt & HSMCI_WR_OPT_BLK_CNT),
+				      "write CMD23", opt, cnt[i]);
+				check(hsmci_sim_stat.acmd[23] - s0.acmd[23] ==
+				      ((opt & HSMCI_WR_OPT_PRE_ERASE) && cnt[i] >= HSMCI_PRE_ERASE_MIN_BLK),
+				      "write ACMD23", opt, cnt[i]);
+			}
+			// Card status read after writes ended without CMD12.
+			check(hsmci_sim_stat.cmd[13] - s0.cmd[13] == (cnt[i] == 1 || (opt & HSMCI_WR_OPT_BLK_CNT)),
+			      "write CMD13", opt, cnt[i]);
+			memset(buf2, 0, sizeof(buf2));
+			hsmci_lock();
+			ret = hsmci_read_blocks(lba, cnt[i], buf2);
+			hsmci_unlock();
+			check(ret == 0, "read_blocks", opt, cnt[i]);
+			check(!memcmp(buf2, buf, cnt[i] * 512), "read data", opt, cnt[i]);
+			lba += cnt[i];
+		}
+	}
+	hsmci_set_write_opt(RCA, HSMCI_WR_OPT_PRE_ERASE | HSMCI_WR_OPT_BLK_CNT);
+}
+
+/**
+ * test_stream
+ *
+ * Streams through two alternating halves of buf, the next buffer queued
+ * while the current one is in transfer.
+ */
+static void test_stream(void)
+{
+	uint32_t *half[2] = {buf, buf + BUF_BLK / 2 * 128};
+	const void *wr_done;
+	void *rd_done;
+	size_t lba = 1000;
+	int n = 6, h = BUF_BLK / 2, ret;
+
+	hsmci_lock();
+	fill(half[0], h, 0);
+	ret = hsmci_stream_write_begin(lba, half[0], h);
+	for (int i = 1; !ret && i < n; i++) {
+		fill(half[i & 1], h, i);
+		ret = hsmci_stream_write_next(half[i & 1], h, &wr_done);
+		check(wr_done == half[~i & 1], "stream write done", i, 0);
+		// Card takes the queued buffer next, the done one may be refilled.
+	}
+	if (!ret) {
+		ret = hsmci_stream_write_end();
+	}
+	check(ret == 0, "stream write", ret, 0);
+	for (int i = 0; i < n; i++) {
+		fill(buf2, h, i);
+		check(!memcmp(hsmci_sim_mem(lba + i * h), buf2, h * 512), "stream write data", i, 0);
+	}
+	ret = hsmci_stream_read_begin(lba, half[0], h);
+	for (int i = 1; !ret && i <= n; i++) {
+		if (i < n) {
+			ret = hsmci_stream_read_next(half[i & 1], h, &rd_done);
+		} else {
+			ret = hsmci_stream_read_end(&rd_done);
+		}
+		fill(buf2, h, i - 1);
+		check(!ret && !memcmp(rd_done, buf2, h * 512), "stream read data", i, ret);
+	}
+	hsmci_unlock();
+	check(ret == 0, "stream read", ret, 0);
+}
+
+/**
+ * test_wr_err
+ *
+ * Write errors reported in R1 of ACMD23, CMD23, CMD12 or CMD13 fail the
+ * write, the next write succeeds.
+ */
+static void test_wr_err(void)
+{
+	static const struct {
+		unsigned int opt;
+		int cnt;
+		unsigned int cmd;
+	} t[] = {
+		{0, 1, 13},
+		{0, 8, 12},
+		{HSMCI_WR_OPT_BLK_CNT, 8, 23},
+		{HSMCI_WR_OPT_BLK_CNT, 8, 13},
+		{HSMCI_WR_OPT_PRE_ERASE, 8, 23 + HSMCI_SIM_ACMD},
+		{HSMCI_WR_OPT_PRE_ERASE | HSMCI_WR_OPT_BLK_CNT, 8, 13}
+	};
+	int ret;
+
+	fill(buf, 8, 3);
+	hsmci_lock();
+	for (unsigned int i = 0; i < sizeof(t) / sizeof(t[0]); i++) {
+		hsmci_set_write_opt(RCA, t[i].opt);
+		hsmci_sim_err(t[i].cmd, CARD_STATUS_ERROR);
+		ret = hsmci_write_blocks(2000, t[i].cnt, buf);
+		check(ret == -EHW, "write error", i, ret);
+		ret = hsmci_write_blocks(2000, t[i].cnt, buf);
+		check(ret == 0, "write after error", i, ret);
+	}
+	hsmci_unlock();
+	hsmci_set_write_opt(RCA, HSMCI_WR_OPT_PRE_ERASE | HSMCI_WR_OPT_BLK_CNT);
+}
+
+/**
+ * rd_us
+ *
+ * Expected latency of a block_cnt read: command, access time and data per
+ * block, CMD12 after a multi-block read.
+ */
+static double rd_us(int block_cnt)
+{
+	double cmd = 104.0 / clk * 1e6;
+	double blk = sim_cfg.rd_acc_us + (512 * 8 / 4 + 18.0) / clk * 1e6;
+
+	return (cmd + block_cnt * blk + ((block_cnt > 1) ? cmd : 0));
+}
+
+/**
+ * sim_io
+ *
+ * Block transfer of sd_bench_run_io() by the driver block functions.
+ */
+static int sim_io(boolean_t wr, size_t lba, int block_cnt, void *b, int buf_blk)
+{
+	int ret;
+
+	(void) buf_blk;
+	hsmci_lock();
+	if (wr) {
+		ret = hsmci_write_blocks(lba, block_cnt, b);
+	} else {
+		ret = hsmci_read_blocks(lba, block_cnt, b);
+	}
+	hsmci_unlock();
+	return (ret);
+}
+
+/**
+ * test_bench
+ */
+static void test_bench(void)
+{
+	static const int cnt[] = {1, 8, 64, 256};
+	struct sd_bench_lat res, prev;
+	double exp;
+
+	for (int pat = 0; pat < SD_BENCH_PAT_NUM; pat++) {
+		memset(&prev, 0, sizeof(prev));
+		for (unsigned int i = 0; i < sizeof(cnt) / sizeof(cnt[0]); i++) {
+			sd_bench_run(pat, 0, RANGE_BLK, cnt[i], buf, BUF_BLK, &res);
+			check(res.ret == 0 && res.cmd == SD_BENCH_LAT_N, "sd_bench_run", pat, cnt[i]);
+			// Stream writes are not pre-erased (no ACMD23), so they need
+			// not beat a pre-erased write of BUF_BLK blocks.
+			if (cnt[i] <= BUF_BLK || pat == SD_BENCH_SEQ_RD || pat == SD_BENCH_RND_RD) {
+				check(res.kbps > prev.kbps, "kbps by block count", pat, cnt[i]);
+			}
+			check(res.p50_us <= res.p90_us && res.p90_us <= res.p99_us && res.p99_us <= res.max_us,
+			      "percentiles", pat, cnt[i]);
+			if (pat == SD_BENCH_SEQ_RD || pat == SD_BENCH_RND_RD) {
+				// Streams (cnt > BUF_BLK) cost a little more than one command.
+				exp = rd_us(cnt[i]);
+				check(res.p50_us >= exp * 0.98 && res.p50_us <= exp * 1.02, "read latency", res.p50_us,
+				      (long) exp);
+			}
+			prev = res;
+		}
+	}
+	// The caller supplied timestamp source gives the same result for the
+	// same transfers.
+	sd_bench_run(SD_BENCH_RND_RD, 0, RANGE_BLK, 8, buf, BUF_BLK, &prev);
+	sd_bench_run_io(sim_io, hsmci_sim_cyc, SystemCoreClock, SD_BENCH_RND_RD, 0, RANGE_BLK, 8, buf, BUF_BLK,
+			&res);
+	check(res.ret == 0 && res.p50_us == prev.p50_us && res.kbps == prev.kbps, "sd_bench_run_io", res.p50_us,
+	      prev.p50_us);
+	// sd_bench_run() takes the driver lock for each command.
+	hsmci_lock();
+	sd_bench_run(SD_BENCH_SEQ_RD, 0, RANGE_BLK, 1, buf, BUF_BLK, &res);
+	hsmci_unlock();
+	check(host_mtx_err != 0, "sd_bench_run lock", host_mtx_err, 0);
+	host_mtx_err = 0;
+}
+
+/**
+ * test_wr_opt
+ */
+static void test_wr_opt(void)
+{
+	struct sd_bench_res res[SD_BENCH_WR_CFG_NUM];
+	struct hsmci_sim_stat s0 = hsmci_sim_stat;
+	unsigned int n = 256 / 16;
+
+	fill(buf, 16, 7);
+	sd_bench_wr_opt(&card, 0, buf, 16, 256, res);
+	for (int i = 0; i < SD_BENCH_WR_CFG_NUM; i++) {
+		check(res[i].ret == 0 && res[i].blk == 256, "sd_bench_wr_opt", i, res[i].ret);
+	}
+	check(hsmci_sim_stat.cmd[12] - s0.cmd[12] == 2 * n, "wr_opt CMD12", hsmci_sim_stat.cmd[12] - s0.cmd[12], 0);
+	check(hsmci_sim_stat.cmd[23] - s0.cmd[23] == 2 * n, "wr_opt CMD23", hsmci_sim_stat.cmd[23] - s0.cmd[23], 0);
+	check(hsmci_sim_stat.acmd[23] - s0.acmd[23] == 2 * n, "wr_opt ACMD23",
+	      hsmci_sim_stat.acmd[23] - s0.acmd[23], 0);
+	check(res[SD_BENCH_WR_PRE_ERASE].kbps > res[SD_BENCH_WR_PLAIN].kbps, "pre-erase kbps",
+	      res[SD_BENCH_WR_PRE_ERASE].kbps, res[SD_BENCH_WR_PLAIN].kbps);
+	check(res[SD_BENCH_WR_BOTH].kbps > res[SD_BENCH_WR_BLK_CNT].kbps, "pre-erase kbps (CMD23)",
+	      res[SD_BENCH_WR_BOTH].kbps, res[SD_BENCH_WR_BLK_CNT].kbps);
+	check(!memcmp(hsmci_sim_mem(240), buf, 16 * 512), "wr_opt data", 0, 0);
+}
+
+/**
+ * test_set_bus
+ */
+static void test_set_bus(void)
+{
+	struct sd_bench_lat res1, res4;
+	unsigned int c;
+	int ret;
+
+	ret = sd_bench_set_bus(&card, 1, CLK_HZ, &c);
+	check(ret == 0 && hsmci_sim_stat.acmd[6] == 1, "set_bus 1", ret, hsmci_sim_stat.acmd[6]);
+	sd_bench_run(SD_BENCH_SEQ_RD, 0, RANGE_BLK, 64, buf, BUF_BLK, &res1);
+	ret = sd_bench_set_bus(&card, 4, CLK_HZ, &c);
+	check(ret == 0 && hsmci_sim_stat.acmd[6] == 2, "set_bus 4", ret, hsmci_sim_stat.acmd[6]);
+	sd_bench_run(SD_BENCH_SEQ_RD, 0, RANGE_BLK, 64, buf, BUF_BLK, &res4);
+	check(res1.ret == 0 && res4.ret == 0 && res4.kbps > res1.kbps, "bus width kbps", res4.kbps, res1.kbps);
+}
+
+int main(void)
+{
+	hsmci_sim_init(&sim_cfg);
+	init_hsmci();
+	hsmci_set_bus_width(HSMCI_BUS_WIDTH_4);
+	hsmci_set_clock(CLK_HZ, &clk, FALSE);
+	hsmci_set_write_opt(RCA, HSMCI_WR_OPT_PRE_ERASE | HSMCI_WR_OPT_BLK_CNT);
+	card.rca = RCA;
+	card.blk_cnt = sim_cfg.blk_cnt;
+	card.bus_width = 4;
+	card.cmd23 = TRUE;
+	card.clk_hz = CLK_HZ;
+	test_blocks();
+	test_stream();
+	test_wr_err();
+	test_bench();
+	test_wr_opt();
+	test_set_bus();
+	check(hsmci_sim_stat.proto_err == 0, "protocol errors", hsmci_sim_stat.proto_err, 0);
+	check(host_mtx_err == 0, "mutex errors", host_mtx_err, 0);
+	printf("sd_bench: %s (%llu ms simulated)\n", (fail) ? "FAIL" : "ok",
+	       (unsigned long long) hsmci_sim_us() / 1000);
+	return (fail != 0);
+}
@@ -0,0 +1,28 @@
+/* Host test stand-in for FreeRTOS.h (single thread, no scheduler). */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define errQUEUE_FULL 0
+#define portMAX_DELAY 0xFFFFFFFFU
+#define portTICK_PERIOD_MS 1
+#define configLIBRARY_MAX_API_CALL_INTERRUPT_PRIORITY 5
+#define portEND_SWITCHING_ISR(wkn) (void) (wkn)
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif
@@ -0,0 +1,2 @@
+/* Host test stand-in for atom.h. */
+#define ms_to_os_ticks(ms) ((TickType_t) (ms) / portTICK_PERIOD_MS)
@@ -0,0 +1 @@
+/* Host test stand-in for the application board.h. */
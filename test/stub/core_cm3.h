@@ -0,0 +1,49 @@
+/*
+ * Host test stand-in for CMSIS core_cm3.h: register qualifiers and the
+ * intrinsics used by the drivers, computed bit-exactly in C.
+ */
+#ifndef CORE_CM3_H
+#define CORE_CM3_H
+
+#include <stdint.h>
+
+#define __I volatile const
+#define __O volatile
+#define __IO volatile
+#define __NVIC_PRIO_BITS 4
+
+typedef struct {
+	uint32_t CTRL;
+	uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type host_dwt;
+extern CoreDebug_Type host_core_debug;
+
+#define DWT (&host_dwt)
+#define CoreDebug (&host_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk 1U
+#define CoreDebug_DEMCR_TRCENA_Msk (1U << 24)
+
+#define NVIC_EnableIRQ(irq) ((void) (irq))
+#define NVIC_DisableIRQ(irq) ((void) (irq))
+#define NVIC_ClearPendingIRQ(irq) ((void) (irq))
+#define NVIC_SetPriority(irq, prio) ((void) (irq), (void) (prio))
+
+static inline uint32_t __CLZ(uint32_t v)
+{
+	return (v) ? __builtin_clz(v) : 32;
+}
+
+static inline int32_t __SSAT(int32_t v, int n)
+{
+	int32_t max = (1 << (n - 1)) - 1;
+
+	return (v > max) ? max : (v < -max - 1) ? -max - 1 : v;
+}
+
+#endif
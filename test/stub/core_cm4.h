@@ -0,0 +1,17 @@
+/* Host test stand-in for CMSIS core_cm4.h: adds the DSP intrinsics. */
+#ifndef CORE_CM4_H
+#define CORE_CM4_H
+
+#include "core_cm3.h"
+
+static inline uint32_t __SMLAD(uint32_t a, uint32_t b, uint32_t acc)
+{
+	return ((uint32_t) ((int16_t) a * (int16_t) b) + (uint32_t) ((int16_t) (a >> 16) * (int16_t) (b >> 16)) + acc);
+}
+
+static inline uint32_t __PKHBT(uint32_t a, uint32_t b, int sh)
+{
+	return ((a & 0xFFFF) | (b << sh & 0xFFFF0000));
+}
+
+#endif
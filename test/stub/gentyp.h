@@ -0,0 +1,10 @@
+/* Host test stand-in for gentyp.h. */
+#ifndef GENTYP_H
+#define GENTYP_H
+
+typedef int boolean_t;
+
+#define TRUE 1
+#define FALSE 0
+
+#endif
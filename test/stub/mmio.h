@@ -0,0 +1,2 @@
+/* Host test stand-in for mmio.h. */
+#define barrier() __asm__ volatile ("" ::: "memory")
@@ -0,0 +1,4 @@
+/* Host test stand-in for the application msgconf.h. */
+#define INF 0
+
+void msg(int lev, const char *fmt, ...);
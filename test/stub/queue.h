@@ -0,0 +1,12 @@
+/* Host test stand-in for queue.h (see test/host_rtos.c). */
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size);
+BaseType_t xQueueReceive(QueueHandle_t que, void *item, TickType_t tmo);
+BaseType_t xQueueSendFromISR(QueueHandle_t que, const void *item, BaseType_t *wkn);
+BaseType_t xQueueReset(QueueHandle_t que);
+
+#endif
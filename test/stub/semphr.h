@@ -0,0 +1,11 @@
+/* Host test stand-in for semphr.h (see test/host_rtos.c). */
+#ifndef SEMPHR_H
+#define SEMPHR_H
+
+#include "queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mtx, TickType_t tmo);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mtx);
+
+#endif
@@ -0,0 +1,17 @@
+/* Host test stand-in for the application sysconf.h. */
+#include <sam.h>
+
+#ifndef F_MCK
+ #define F_MCK 120000000U
+#endif
+
+#ifndef TERMOUT
+ #define TERMOUT 0
+#endif
+
+#if HSMCI_SIM == 1
+// HSMCI registers backed by the simulated card of test/hsmci_sim.c.
+extern uint32_t hsmci_sim_regs[];
+ #undef HSMCI
+ #define HSMCI ((Hsmci *) hsmci_sim_regs)
+#endif
@@ -0,0 +1,2 @@
+/* Host test stand-in for system_sam4s.h. */
+extern uint32_t SystemCoreClock;
@@ -0,0 +1,11 @@
+/* Host test stand-in for task.h (see test/host_rtos.c). */
+#ifndef TASK_H
+#define TASK_H
+
+#include "FreeRTOS.h"
+
+#define taskYIELD()
+
+TickType_t xTaskGetTickCount(void);
+
+#endif